@@ -0,0 +1,153 @@
+#ifndef GAME_HPP_
+#define GAME_HPP_
+
+#include "ggpe.hpp"
+
+namespace ggpe {
+
+struct GameData;
+enum class Analysis;
+
+namespace propnet {
+class Propnet;
+}
+
+namespace datalog {
+class Evaluator;
+}
+
+/**
+ * A game with its analyses and engine backends.
+ *
+ * Every per-game datum (atoms, roles, facts, actions, analyses) and the
+ * compiled GDLCC library are owned by a Game, and states keep what they need
+ * alive, so a Game and its states stay valid after another Game is created.
+ * The free functions in ggpe.hpp are wrappers around the default Game.
+ *
+ * Note: YAP Prolog is shared by the whole process and holds the rules of one
+ * game at a time, i.e. the Game created last. Creating another Game replaces
+ * only the rules, without initializing YAP again. States of GDLCC engine do not
+ * depend on YAP, thus games using GDLCC engine can be played concurrently.
+ * The same holds for propnet and datalog engines.
+ * YAP-dependent operations on states of other games throw
+ * std::runtime_error.
+ */
+class Game {
+public:
+  /**
+   * Parse a given KIF string, analyze it and initialize engine backends
+   * If tabling is enabled, YAP tables the static relations taking a large
+   * share of calls in profiled playouts if that makes playouts faster, which is
+   * chosen once and saved in tmp/<name>.tabling
+   * The results of analyses are saved in tmp/<name>.bundle and the compiled
+   * YAP program in tmp/<name>.yap, which are reused while the rewritten rules
+   * are unchanged (the latter only by the first Game of a process)
+   * The KIF is taken by value, so that a moved string is kept without a copy
+   */
+  Game(
+      std::string kif,
+      const std::string& name="tmp",
+      const EngineBackend backend=EngineBackend::YAP,
+      const bool enables_tabling=false);
+  /**
+   * Use a game library linked at build time as GDLCC engine
+   */
+  Game(
+      const std::string& kif,
+      const std::string& name,
+      const gdlcc_abi::StaticSymbols& symbols);
+  Game(const Game&) = delete;
+  Game& operator=(const Game&) = delete;
+  ~Game();
+
+  const std::string& GetName() const;
+  const std::string& GetKif() const;
+  /**
+   * @return KIF of the rewritten rules every backend compiles, from which
+   * GDLCC libraries are built
+   */
+  std::string GetCompiledKif() const;
+  bool EnablesTabling() const;
+  int GetRoleCount() const;
+  const std::vector<int>& GetRoleIndices() const;
+  bool IsValidRoleIndex(const int role_idx) const;
+  std::string RoleIndexToString(const int role_index) const;
+  int StringToRoleIndex(const std::string& role_str) const;
+  Tuple StringToTuple(const std::string& str) const;
+  std::string TupleToString(const Tuple& tuple) const;
+  Atom StringToAtom(const std::string& str) const;
+  const std::string& AtomToString(const Atom atom) const;
+  const FactSet& GetPossibleFacts() const;
+  const std::vector<ActionSet>& GetPossibleActions() const;
+  std::string JointActionToString(const JointAction& joint_action) const;
+  void AppendTupleString(const Tuple& tuple, std::string& buffer) const;
+  ServerMessage ParseServerMessage(const std::string& message) const;
+  /**
+   * Analyses of the game are run by YAP on the first call of their getters,
+   * which return copies of the results. If a deadline passes first, the
+   * result is empty and the analysis is run again on the next call. The
+   * result is also empty if the analysis has not completed while YAP held the
+   * rules of this game and YAP now holds another game.
+   */
+  std::unordered_set<Atom> GetStepCounters(const boost::optional<Deadline>& deadline=boost::none) const;
+  std::unordered_map<AtomPair, std::vector<std::pair<Atom, std::pair<int, int>>>, boost::hash<AtomPair>> GetFactActionConnections(const boost::optional<Deadline>& deadline=boost::none) const;
+  std::unordered_map<Atom, std::unordered_map<Atom, int>> GetOrderedDomains(const boost::optional<Deadline>& deadline=boost::none) const;
+  StateSp CreateInitialState() const;
+  /**
+   * GDLCC libraries without the binary interface cannot restore states, thus
+   * std::runtime_error is thrown for them
+   */
+  StateSp CreateState(const FactSet& facts) const;
+  EngineBackend GetEngineBackend() const;
+  std::vector<int> GetPartialGoals(const StateSp& state) const;
+  std::vector<NextCondition> DetectNextConditions(const Fact& fact) const;
+  std::vector<std::vector<FactSet>> GetWinConditions(const boost::optional<Deadline>& deadline=boost::none) const;
+  /**
+   * Run the analyses which have not completed concurrently in forked
+   * processes, e.g. within the start clock
+   */
+  void RunAnalyses(const boost::optional<Deadline>& deadline=boost::none) const;
+  /**
+   * @return wall time and memory of each phase of initialization, followed
+   * by lazy analyses run so far
+   */
+  const InitializationReport& GetInitializationReport() const;
+  /**
+   * @return true iif YAP Prolog holds the rules of this game
+   */
+  bool IsBoundToYap() const;
+
+private:
+  /**
+   * Run a given analysis unless it has completed
+   * @return true iif it has completed
+   */
+  bool Analyze(const Analysis analysis, const boost::optional<Deadline>& deadline) const;
+  /**
+   * @return true iif the engine backend plays the same as yap engine
+   */
+  bool IsEngineValid() const;
+  /**
+   * Validate the engine backend as a phase of initialization
+   */
+  bool IsEngineValidWithReport(const std::string& phase_name) const;
+  std::shared_ptr<GameData> data_;
+  std::shared_ptr<const propnet::Propnet> propnet_;
+  std::shared_ptr<const datalog::Evaluator> datalog_;
+};
+
+using GameSp = std::shared_ptr<Game>;
+
+/**
+ * @return the game used by the free functions, or null before Initialize
+ */
+const GameSp& GetDefaultGame();
+
+/**
+ * Make a given game the one used by the free functions
+ */
+void SetDefaultGame(const GameSp& game);
+
+}
+
+#endif /* GAME_HPP_ */
@@ -0,0 +1,63 @@
+#ifndef GDLCC_ABI_HPP_
+#define GDLCC_ABI_HPP_
+
+#include "ggpe.hpp"
+
+namespace ggpe {
+namespace gdlcc_abi {
+
+/**
+ * Version of the binary interface between ggpe and GDLCC libraries.
+ * Libraries built for this version export GetABIVersion returning it.
+ */
+constexpr int kVersion = 1;
+
+/**
+ * Version of the headers GDLCC libraries are compiled with, e.g. the virtual
+ * functions of State. Increment it whenever they change, so that libraries
+ * built for older headers are not reused.
+ */
+constexpr int kHeaderVersion = 2;
+
+/**
+ * Pairs of ggpe atom and its string representation
+ */
+using AtomTable = std::vector<std::pair<Atom, std::string>>;
+
+/*
+ * Symbols exported by a GDLCC library (extern "C").
+ *
+ * Binary interface (version 1):
+ *   GetABIVersion: returns kVersion
+ *   SetAtomTable: called once at load time with ggpe's atom table; after that
+ *     every Tuple passed to or returned from the library uses ggpe atoms.
+ *     Returns false if some atom of the game is missing in the table.
+ *   CreateInitialState: creates the initial state
+ *   CreateState: creates a state from a set of facts
+ *
+ * String interface (libraries without GetABIVersion):
+ *   StrToTuple, TupleToStr, StrToLiteral, LiteralToStr, CreateInitialState
+ */
+using GetABIVersionFunc = int();
+using SetAtomTableFunc = bool(const AtomTable& atom_table);
+using CreateStateFunc = StateSp(const FactSet& facts);
+using StrToTupleFunc = Tuple(const std::string& str);
+using TupleToStrFunc = std::string(const Tuple& tuple);
+using StrToLiteralFunc = int(const std::string& str);
+using LiteralToStrFunc = std::string(const int literal);
+
+/**
+ * Functions of a game library linked at build time by "make static_game".
+ * Those of the binary interface are null if the library does not export them.
+ */
+struct StaticSymbols {
+  CreateInitialStateFunc* create_initial_state;
+  GetABIVersionFunc* get_abi_version;
+  SetAtomTableFunc* set_atom_table;
+  CreateStateFunc* create_state;
+};
+
+}
+}
+
+#endif /* GDLCC_ABI_HPP_ */
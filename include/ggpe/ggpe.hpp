@@ -5,6 +5,7 @@
 #include <string>
 #include <vector>
 #include <array>
+#include <chrono>
 #include <unordered_map>
 #include <unordered_set>
 #include <boost/functional/hash.hpp>
@@ -74,7 +75,7 @@ using StateSp = std::shared_ptr<State>;
 using StateAction = std::pair<StateSp, JointAction>;
 
 enum class EngineBackend {
-  YAP, GDLCC
+  YAP, GDLCC, PROPNET, DATALOG
 };
 
 /**
@@ -97,6 +98,34 @@ void InitializeFromFile(
  */
 void InitializeTicTacToe(const EngineBackend backend=EngineBackend::YAP);
 
+/**
+ * Signature of CreateInitialState exported by compiled game libraries
+ */
+using CreateInitialStateFunc = StateSp();
+
+namespace gdlcc_abi {
+struct StaticSymbols;
+}
+
+/**
+ * Initialize GGP Engine with a game library linked at build time.
+ * Usually called via InitializeStaticGame<Game>() (see static_game.hpp).
+ */
+void InitializeWithStaticGame(
+    const std::string& kif,
+    const std::string& name,
+    const gdlcc_abi::StaticSymbols& symbols);
+
+/**
+ * Write a C++ header of compile-time constants of the current game, used by
+ * "make static_game".
+ * @param header_filename output filename
+ * @param struct_name name of the generated traits struct
+ */
+void GenerateStaticGameHeader(
+    const std::string& header_filename,
+    const std::string& struct_name);
+
 const std::string& GetGameName();
 
 /**
@@ -164,23 +193,109 @@ const std::vector<ActionSet>& GetPossibleActions();
 std::string JointActionToString(const JointAction& joint_action);
 
 /**
- * @return atoms which are used as step counters
+ * Append the string representation of a tuple to a buffer, which can be
+ * reused across turns to avoid allocation
+ */
+void AppendTupleString(const Tuple& tuple, std::string& buffer);
+
+/**
+ * Message sent by a GGP server
+ */
+struct ServerMessage {
+  enum class Type {
+    START, PLAY, STOP, ABORT, INFO
+  };
+  Type type;
+  std::string match_id;
+  /**
+   * Role of this player (START only)
+   */
+  std::string role;
+  /**
+   * Rules of the game in KIF (START only)
+   */
+  std::string kif;
+  int start_clock = 0;
+  int play_clock = 0;
+  /**
+   * Moves of the last step (PLAY and STOP), which is empty for the first PLAY
+   */
+  JointAction joint_action;
+};
+
+/**
+ * Wall time and memory of a phase of initialization, e.g. parsing or a
+ * detection pass
  */
-const std::unordered_set<Atom>& GetStepCounters();
+struct InitializationPhase {
+  std::string name;
+  /**
+   * Wall time in seconds
+   */
+  double wall_time = 0;
+  /**
+   * Resident memory of the process at the start and the end of the phase in
+   * bytes (0 if unknown)
+   */
+  std::size_t start_memory = 0;
+  std::size_t end_memory = 0;
+  /**
+   * Whether the phase ran alongside other phases, whose time and memory are
+   * included in its measurement
+   */
+  bool is_concurrent = false;
+};
+
+using InitializationReport = std::vector<InitializationPhase>;
 
 /**
- * @return detected fact-action connections per atom pair
+ * @return phases of initialization of the current game in order, including
+ * lazy analyses run so far
+ */
+const InitializationReport& GetInitializationReport();
+
+/**
+ * Parse a message of GGP protocol. Moves are converted into a joint action
+ * of the current game, thus START, ABORT, INFO and the first PLAY can be
+ * parsed before Initialize.
+ * Throws std::runtime_error on malformed messages.
+ */
+ServerMessage ParseServerMessage(const std::string& message);
+
+/**
+ * Time by which a lazy analysis must finish
+ */
+using Deadline = std::chrono::steady_clock::time_point;
+
+/**
+ * @return atoms which are used as step counters, detected on the first call
+ * or empty if a given deadline passes first
+ */
+std::unordered_set<Atom> GetStepCounters(const boost::optional<Deadline>& deadline=boost::none);
+
+/**
+ * @return detected fact-action connections per atom pair, detected on the
+ * first call or empty if a given deadline passes first
  */
 using AtomPair = std::pair<Atom, Atom>;
-const std::unordered_map<AtomPair, std::vector<std::pair<Atom, std::pair<int, int>>>, boost::hash<AtomPair>>& GetFactActionConnections();
+std::unordered_map<AtomPair, std::vector<std::pair<Atom, std::pair<int, int>>>, boost::hash<AtomPair>> GetFactActionConnections(const boost::optional<Deadline>& deadline=boost::none);
 
 /**
- * @return detected ordered domains per atom
+ * @return detected ordered domains per atom, detected on the first call or
+ * empty if a given deadline passes first
  */
-const std::unordered_map<Atom, std::unordered_map<Atom, int>>& GetOrderedDomains();
+std::unordered_map<Atom, std::unordered_map<Atom, int>> GetOrderedDomains(const boost::optional<Deadline>& deadline=boost::none);
 
 StateSp CreateInitialState();
 
+/**
+ * Create a state with a given set of facts, e.g. restored from a fact list
+ * sent by a GGP server. Its joint action history is empty.
+ * GDLCC engine can restore states only from libraries of the binary
+ * interface (see gdlcc_abi.hpp), otherwise std::runtime_error is thrown.
+ */
+StateSp CreateState(const FactSet& facts);
+
 /**
  * Get the path where GGPE was compiled
  * @return
@@ -195,11 +310,23 @@ using ActionCondition = std::vector<boost::optional<Action>>;
 using NextCondition = std::pair<ActionCondition, FactSet>;
 std::vector<NextCondition> DetectNextConditions(const Fact& fact);
 
-const std::vector<std::vector<FactSet>>& GetWinConditions();
+/**
+ * @return conditions to win per role, detected on the first call or empty if
+ * a given deadline passes first
+ */
+std::vector<std::vector<FactSet>> GetWinConditions(const boost::optional<Deadline>& deadline=boost::none);
+
+/**
+ * Run the analyses which have not completed concurrently in forked processes,
+ * instead of one by one on the first calls of their getters. They are run
+ * one by one in this process if it has other threads.
+ */
+void RunAnalyses(const boost::optional<Deadline>& deadline=boost::none);
 
 }
 
 #include "state.hpp"
+#include "game.hpp"
 
 //namespace std {
 //
@@ -0,0 +1,66 @@
+#ifndef JOIN_ORDER_HPP_
+#define JOIN_ORDER_HPP_
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "sexpr_parser.hpp"
+#include "rule_graph.hpp"
+
+namespace sexpr_parser {
+
+/**
+ * Estimator of the numbers of answers of literals, which reorders the bodies
+ * of rules so that selective literals come first.
+ *
+ * Statistics are computed from facts in KIF: static relations from their
+ * facts, 'true' from 'base' facts (or 'init' facts if there is no 'base'
+ * fact) and 'does' from 'role' facts. Each argument bound before a literal
+ * divides its estimate by the number of distinct values of the argument.
+ */
+class SelectivityEstimator {
+public:
+  explicit SelectivityEstimator(const std::vector<TreeNode>& nodes);
+
+  /**
+   * @return estimated number of answers of a positive literal
+   */
+  double Estimate(
+      const TreeNode& literal,
+      const std::unordered_set<std::string>& bound_variables) const;
+
+  /**
+   * Reorder the body of a rule greedily: 'not' and 'distinct' are placed as
+   * soon as all their variables are bound, and the other literals are placed
+   * in ascending order of their estimates. A literal recursive with the head
+   * is never moved before positive literals which preceded it.
+   * @return the reordered rule
+   */
+  TreeNode ReorderBody(const TreeNode& rule) const;
+
+private:
+  struct Statistics {
+    double size;
+    std::vector<std::unordered_set<std::string>> domains;
+  };
+  static void AddFact(
+      const std::string& key,
+      const TreeNode& tuple,
+      std::unordered_map<std::string, Statistics>& statistics);
+  bool IsRecursive(const TreeNode& literal, const int component_idx) const;
+
+  std::unordered_map<std::string, Statistics> statistics_;
+  std::unordered_set<std::string> derived_relations_;
+  RuleGraph graph_;
+};
+
+/**
+ * @return given nodes whose rules are reordered by SelectivityEstimator
+ */
+std::vector<TreeNode> ReorderBodiesBySelectivity(const std::vector<TreeNode>& nodes);
+
+}
+
+#endif /* JOIN_ORDER_HPP_ */
@@ -0,0 +1,58 @@
+#ifndef OPTIMIZER_HPP_
+#define OPTIMIZER_HPP_
+
+#include <string>
+#include <vector>
+
+#include "sexpr_parser.hpp"
+
+namespace sexpr_parser {
+
+/**
+ * Evaluate literals of static relations, which are defined only by ground
+ * facts, as far as it does not increase rules. A literal which matches no
+ * fact removes its rule, and a literal which matches exactly one fact is
+ * removed after its variables are replaced by the constants of the fact.
+ * Ground 'distinct' and ground negations of static relations are also
+ * evaluated.
+ */
+std::vector<TreeNode> EvaluateStaticLiterals(const std::vector<TreeNode>& nodes);
+
+/**
+ * Inline relations defined by a single non-recursive rule into the rules
+ * using them. Relations used inside 'not' or 'or' are not inlined.
+ */
+std::vector<TreeNode> InlineRules(const std::vector<TreeNode>& nodes);
+
+/**
+ * Remove rules using empty relations by RemoveRulesOfEmptyRelations, and then
+ * rules unreachable from 'legal', 'next', 'goal', 'terminal' and the other
+ * reserved relations. Facts are kept because analyses (e.g. ordered domains)
+ * may look them up.
+ */
+std::vector<TreeNode> RemoveUnreachableRules(const std::vector<TreeNode>& nodes);
+
+/**
+ * Remove rules with a positive literal of an empty relation, which has
+ * neither facts nor rules, until no more relation becomes empty, so that no
+ * rule refers to an undefined relation. Negations of empty relations always
+ * hold and are removed, and so are their disjunctions.
+ */
+std::vector<TreeNode> RemoveRulesOfEmptyRelations(const std::vector<TreeNode>& nodes);
+
+/**
+ * Apply EvaluateStaticLiterals, InlineRules and RemoveUnreachableRules in
+ * order. The result is equivalent to given nodes for reserved relations, and
+ * every relation it uses is defined even if the first two remove its last
+ * rule.
+ */
+std::vector<TreeNode> Optimize(const std::vector<TreeNode>& nodes);
+
+/**
+ * @return KIF with a node per line
+ */
+std::string ToKIF(const std::vector<TreeNode>& nodes);
+
+}
+
+#endif /* OPTIMIZER_HPP_ */
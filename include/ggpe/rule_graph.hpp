@@ -0,0 +1,100 @@
+#ifndef RULE_GRAPH_HPP_
+#define RULE_GRAPH_HPP_
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "sexpr_parser.hpp"
+
+namespace sexpr_parser {
+
+/**
+ * Dependency graph among the relations of rules.
+ *
+ * Each relation is a node, and each literal in the body of a rule adds an
+ * edge from the relation of its head to that of the literal, which is
+ * negative if the literal is inside 'not'. Strongly connected components
+ * and strata are computed once on construction.
+ */
+class RuleGraph {
+public:
+  struct Edge {
+    int relation_idx;
+    bool is_negative;
+  };
+
+  explicit RuleGraph(const std::vector<TreeNode>& nodes);
+
+  int GetRelationCount() const;
+  const std::string& GetRelation(const int relation_idx) const;
+  /**
+   * @return the index of a relation, or -1 if it does not appear
+   */
+  int GetRelationIndex(const std::string& relation) const;
+  /**
+   * @return edges to the relations which a relation depends on
+   */
+  const std::vector<Edge>& GetDependencies(const int relation_idx) const;
+  /**
+   * @return edges to the relations which depend on a relation
+   */
+  const std::vector<Edge>& GetDependents(const int relation_idx) const;
+
+  /**
+   * @return strongly connected components, each of which only depends on
+   * itself and the preceding ones
+   */
+  const std::vector<std::vector<int>>& GetComponents() const;
+  int GetComponentIndex(const int relation_idx) const;
+  /**
+   * @return true iif a relation depends on itself directly or indirectly
+   */
+  bool IsRecursive(const int relation_idx) const;
+  /**
+   * @return false if some relation depends on itself through negation
+   */
+  bool IsStratified() const;
+  /**
+   * @return the stratum of a relation, which is higher than those of the
+   * relations it negates and not lower than those it depends on
+   */
+  int GetStratum(const int relation_idx) const;
+
+  /**
+   * @return given relations and the relations which depend on them directly
+   * or indirectly
+   */
+  std::unordered_set<std::string> CollectDependents(
+      const std::unordered_set<std::string>& relations) const;
+  /**
+   * @return given relations and the relations which they depend on directly
+   * or indirectly
+   */
+  std::unordered_set<std::string> CollectDependencies(
+      const std::unordered_set<std::string>& relations) const;
+
+private:
+  int AddRelation(const std::string& relation);
+  void AddEdges(const int head_idx, const TreeNode& literal, const bool is_negative);
+  void ComputeComponents();
+  void ComputeStrata();
+  std::unordered_set<std::string> CollectReachableRelations(
+      const std::unordered_set<std::string>& relations,
+      const std::vector<std::vector<Edge>>& edges) const;
+
+  std::vector<std::string> relations_;
+  std::unordered_map<std::string, int> relation_indices_;
+  std::vector<std::vector<Edge>> dependencies_;
+  std::vector<std::vector<Edge>> dependents_;
+  std::vector<std::vector<int>> components_;
+  std::vector<int> component_indices_;
+  std::vector<bool> is_recursive_;
+  bool is_stratified_;
+  std::vector<int> strata_;
+};
+
+}
+
+#endif /* RULE_GRAPH_HPP_ */
@@ -1,6 +1,8 @@
 #ifndef SEXPR_PARSER_HPP_
 #define SEXPR_PARSER_HPP_
 
+#include <functional>
+#include <memory>
 #include <string>
 #include <unordered_set>
 #include <unordered_map>
@@ -16,7 +18,9 @@ using ArgPos = std::pair<std::string, int>;
 using ArgPosPair = std::pair<ArgPos, ArgPos>;
 
 /**
- * A node in KIF trees
+ * A node in KIF trees. Nodes are immutable and hash-consed: identical
+ * subtrees share their data, thus copies are cheap and equality is a pointer
+ * comparison.
  */
 class TreeNode {
 public:
@@ -32,6 +36,16 @@ public:
    */
   TreeNode(const std::vector<TreeNode>& children);
 
+  /**
+   * Leaf node which takes over a given value
+   */
+  TreeNode(std::string&& value);
+
+  /**
+   * Non-leaf node which takes over given children without copying them
+   */
+  TreeNode(std::vector<TreeNode>&& children);
+
   /**
    * @return whether this node is a leaf
    */
@@ -117,6 +131,7 @@ public:
    * @return
    */
   std::unordered_set<std::string> CollectAtoms() const;
+  void CollectAtoms(std::unordered_set<std::string>& output) const;
 
   /**
    * Collect non-functor atoms from this node and its children.
@@ -156,7 +171,6 @@ public:
   std::unordered_set<ArgPosPair> CollectSameDomainArgsInBody() const;
   std::unordered_set<ArgPosPair> CollectSameDomainArgsBetweenHeadAndBody() const;
   TreeNode ReplaceAtoms(const std::string& before, const std::string& after) const;
-  bool CollectDynamicRelations(std::unordered_set<std::string>& local_relation_functors) const;
   const std::string& GetFunctor() const;
   std::string ToPrologRequirementTerm(
       const bool quotes_atoms,
@@ -178,22 +192,59 @@ public:
    */
   bool ContainsFunctors(const std::unordered_set<std::string>& functors) const;
   bool operator==(const TreeNode& another) const;
+
+  /**
+   * @return the hash cached in this node
+   */
+  std::size_t GetHash() const;
 private:
-  bool is_leaf_;
-  std::string value_;
-  std::vector<TreeNode> children_;
+  struct Data;
+
+  /**
+   * Share data with an existing node if their structures are identical
+   */
+  static std::shared_ptr<const Data> Intern(Data&& data);
+
+  std::shared_ptr<const Data> data_;
 };
 
 std::string RemoveComments(const std::string& sexpr);
 std::vector<TreeNode> Parse(const std::string& sexpr, const bool flatten_tuple_with_one_child = false);
+/**
+ * Parse S-expressions in [begin, end) in a single pass, skipping comments
+ * without copying the source. Throws std::runtime_error on unbalanced parens.
+ */
+std::vector<TreeNode> Parse(const char* begin, const char* end, const bool flatten_tuple_with_one_child = false);
 std::vector<TreeNode> ParseKIF(const std::string& kif);
+
+/**
+ * Visitor of top-level forms
+ */
+using FormVisitor = std::function<void(const TreeNode&)>;
+
+/**
+ * Parse S-expressions in [begin, end) and pass each top-level form to a
+ * visitor as soon as it is closed, e.g. a file mapped by
+ * file_utils::MappedFile. Throws std::runtime_error on unbalanced parens.
+ */
+void ParseForms(
+    const char* begin,
+    const char* end,
+    const FormVisitor& visitor,
+    const bool flatten_tuple_with_one_child = false);
+
+/**
+ * Convert KIF nodes into a Prolog program.
+ * @param tabled_relations static relations declared as tabled, which are
+ * ignored if they are not static
+ */
 std::string ToProlog(
     const std::vector<TreeNode>& nodes,
     const bool quotes_atoms,
     const std::string& functor_prefix = "",
     const std::string& atom_prefix = "",
     const bool adds_helper_clauses = false,
-    const bool enables_tabling = false);
+    const std::unordered_set<std::string>& tabled_relations = std::unordered_set<std::string>());
 std::unordered_set<std::string> CollectAtoms(const std::vector<TreeNode>& nodes);
 std::unordered_set<std::string> CollectNonFunctorAtoms(const std::vector<TreeNode>& nodes);
 std::unordered_map<std::string, int> CollectFunctorAtoms(const std::vector<TreeNode>& nodes);
@@ -220,4 +271,15 @@ std::unordered_map<std::string, int> CollectStaticRelations(
 
 }
 
+namespace std {
+
+template <>
+struct hash<sexpr_parser::TreeNode> {
+  size_t operator()(const sexpr_parser::TreeNode& node) const {
+    return node.GetHash();
+  }
+};
+
+}
+
 #endif /* SEXPR_PARSER_HPP_ */
@@ -50,6 +50,22 @@ public:
   }
 
   virtual ~State() {}
+  /*
+   * Virtual functions added later are declared below, so that the vtable of
+   * libraries compiled for older headers stays compatible.
+   */
+  /**
+   * @return resulting goals of a given number of random simulations from
+   * this state
+   */
+  virtual std::vector<std::vector<int>> SimulateBatch(const int count) const {
+    std::vector<std::vector<int>> goals_list;
+    goals_list.reserve(count);
+    for (auto i = 0; i < count; ++i) {
+      goals_list.push_back(Simulate());
+    }
+    return goals_list;
+  }
 };
 
 }
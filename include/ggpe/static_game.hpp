@@ -0,0 +1,32 @@
+#ifndef STATIC_GAME_HPP_
+#define STATIC_GAME_HPP_
+
+#include "ggpe.hpp"
+#include "gdlcc_abi.hpp"
+
+namespace ggpe {
+
+/**
+ * Initialize GGP Engine with a game compiled ahead of time by
+ * "make static_game KIF=<kif filename>".
+ *
+ * Game is the traits struct in the generated lib/<name>_game.hpp. Its
+ * functions are statically linked from lib/libggpe_<name>.a, thus neither
+ * dlopen nor symbol lookup is needed, and the constants of the struct can
+ * size buffers at compile time. If the library supports the binary
+ * interface, it shares ggpe atoms and creates states from facts as a library
+ * loaded at runtime does.
+ *
+ * The scope is link-time binding and compile-time constants only. States are
+ * those GDLCC generates, which are used through the virtual State interface:
+ * GDLCC is an external converter and generates no non-virtual state type, so
+ * game logic is not inlined into search code.
+ */
+template <class Game>
+void InitializeStaticGame() {
+  InitializeWithStaticGame(Game::Kif(), Game::kName, Game::Symbols());
+}
+
+}
+
+#endif /* STATIC_GAME_HPP_ */
@@ -1,5 +1,6 @@
 :- use_module(library(lists)).
 :- use_module(library(maplist)).
+:- use_module(library(timeout)).
 :- use_module(find_unique_n).
 :- use_module(subseq).
 :- use_module(list_to_conj).
@@ -872,3 +873,46 @@ state_partial_goal_without_assertion(_role_goal_pairs) :-
 %   X = [[white,'100'],[black,'0']]
 state_partial_goal(_facts, _role_goal_pairs) :-
     run_with_facts(_facts, state_partial_goal_without_assertion(_role_goal_pairs)).
+
+memo_relation(memo_state_base).
+memo_relation(memo_state_input).
+memo_relation(memo_state_input_only_actions).
+memo_relation(memo_state_ordered_domain).
+memo_relation(memo_directly_connected_args_all).
+memo_relation(memo_indirectly_connected_args_all).
+memo_relation(memo_fact_arg_values_triplets).
+memo_relation(memo_action_values_triplets).
+memo_relation(memo_fact_relations).
+memo_relation(memo_action_relations).
+memo_relation(memo_state_win_conditions).
+
+% Remove the predicates defined in a compiled game file and the results
+% memoized for the game, so that another game can be compiled on this engine
+% Usage:
+%   ?- unload_game('/path/to/tmp/tictactoe.pl').
+unload_game(_file) :-
+    catch(abolish_all_tables, _, true),
+    findall(_name/_arity, (source_file(_head, _file), functor(_head, _name, _arity)), _indicators),
+    forall(member(_indicator, _indicators), abolish(_indicator)),
+    forall(memo_relation(_memo_name), (functor(_memo, _memo_name, 1), retractall(_memo))).
+
+% Run playouts from the initial state and count the calls and retries of given
+% predicates and of all predicates. Only predicates compiled while
+% yap_flag(profiling, on) are counted.
+% Usage:
+%   ?- profile_playouts(20, [gdl_row/2, gdl_line/1], _counts, _total_count).
+%   _counts = [1200, 340], _total_count = 52000
+profile_playouts(_n, _indicators, _counts, _total_count) :-
+    profile_reset,
+    forall(between(1, _n, _), (state_init(_facts), state_simulate(_facts, _))),
+    findall(_count, (member(_indicator, _indicators), profile_count_or_zero(_indicator, _count)), _counts),
+    findall(_count, profile_count(_, _count), _all_counts),
+    sum_list(_all_counts, _total_count).
+
+profile_count(_indicator, _count) :-
+    profile_data(_indicator, calls, _calls),
+    profile_data(_indicator, retries, _retries),
+    _count is _calls + _retries.
+
+profile_count_or_zero(_indicator, _count) :-
+    profile_count(_indicator, _count) -> true; _count = 0.
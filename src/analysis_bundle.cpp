@@ -0,0 +1,340 @@
+#include "analysis_bundle.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file_utils.hpp"
+#include "optimizer.hpp"
+
+namespace ggpe {
+namespace bundle {
+
+namespace {
+
+const auto kMagic = std::string("GGPEBNDL");
+
+/**
+ * Serializer of the values of GameData into a byte buffer
+ */
+class Writer {
+public:
+  void Write(const std::int32_t value) {
+    WriteBytes(&value, sizeof(value));
+  }
+
+  void Write(const std::uint64_t value) {
+    WriteBytes(&value, sizeof(value));
+  }
+
+  void Write(const std::string& value) {
+    Write(static_cast<std::uint64_t>(value.size()));
+    buffer_.append(value);
+  }
+
+  template <class T, class U>
+  void Write(const std::pair<T, U>& value) {
+    Write(value.first);
+    Write(value.second);
+  }
+
+  template <class T>
+  void Write(const std::vector<T>& values) {
+    Write(static_cast<std::uint64_t>(values.size()));
+    for (const auto& value : values) {
+      Write(value);
+    }
+  }
+
+  template <class K, class H>
+  void Write(const std::unordered_set<K, H>& values) {
+    Write(static_cast<std::uint64_t>(values.size()));
+    for (const auto& value : values) {
+      Write(value);
+    }
+  }
+
+  template <class K, class V, class H>
+  void Write(const std::unordered_map<K, V, H>& values) {
+    Write(static_cast<std::uint64_t>(values.size()));
+    for (const auto& pair : values) {
+      Write(pair.first);
+      Write(pair.second);
+    }
+  }
+
+  const std::string& GetBuffer() const {
+    return buffer_;
+  }
+
+private:
+  void WriteBytes(const void* data, const std::size_t size) {
+    buffer_.append(static_cast<const char*>(data), size);
+  }
+
+  std::string buffer_;
+};
+
+/**
+ * Deserializer of values written by Writer, which throws std::runtime_error
+ * on a truncated buffer
+ */
+class Reader {
+public:
+  Reader(const char* begin, const char* end) : pos_(begin), end_(end) {
+  }
+
+  void Read(std::int32_t& value) {
+    ReadBytes(&value, sizeof(value));
+  }
+
+  void Read(std::uint64_t& value) {
+    ReadBytes(&value, sizeof(value));
+  }
+
+  void Read(std::string& value) {
+    const auto size = ReadSize();
+    CheckRemaining(size);
+    value.assign(pos_, size);
+    pos_ += size;
+  }
+
+  template <class T, class U>
+  void Read(std::pair<T, U>& value) {
+    Read(value.first);
+    Read(value.second);
+  }
+
+  template <class T>
+  void Read(std::vector<T>& values) {
+    values.resize(ReadSize());
+    for (auto& value : values) {
+      Read(value);
+    }
+  }
+
+  template <class K, class H>
+  void Read(std::unordered_set<K, H>& values) {
+    const auto size = ReadSize();
+    values.clear();
+    for (auto i = 0ull; i < size; ++i) {
+      K value;
+      Read(value);
+      values.insert(std::move(value));
+    }
+  }
+
+  template <class K, class V, class H>
+  void Read(std::unordered_map<K, V, H>& values) {
+    const auto size = ReadSize();
+    values.clear();
+    for (auto i = 0ull; i < size; ++i) {
+      K key;
+      V value;
+      Read(key);
+      Read(value);
+      values.emplace(std::move(key), std::move(value));
+    }
+  }
+
+  bool AtEnd() const {
+    return pos_ == end_;
+  }
+
+private:
+  std::uint64_t ReadSize() {
+    std::uint64_t size;
+    Read(size);
+    // Each element takes at least one byte, which rejects corrupt sizes
+    CheckRemaining(size);
+    return size;
+  }
+
+  void CheckRemaining(const std::uint64_t size) const {
+    if (size > static_cast<std::uint64_t>(end_ - pos_)) {
+      throw std::runtime_error("Analysis bundle is truncated.");
+    }
+  }
+
+  void ReadBytes(void* data, const std::size_t size) {
+    CheckRemaining(size);
+    std::memcpy(data, pos_, size);
+    pos_ += size;
+  }
+
+  const char* pos_;
+  const char* end_;
+};
+
+/**
+ * The atom dictionary is built from the rewritten rules, thus bundles are
+ * keyed on them instead of the KIF, so that a change of the rewrites does not
+ * reuse a stale dictionary
+ */
+std::uint64_t HashRules(const GameData& game) {
+  return std::hash<std::string>()(sexpr_parser::ToKIF(game.nodes));
+}
+
+std::vector<std::pair<Atom, std::string>> AtomTableToVector(const GameData& game) {
+  std::vector<std::pair<Atom, std::string>> atom_table;
+  atom_table.reserve(game.atom_to_string.size());
+  for (const auto& entry : game.atom_to_string.left) {
+    atom_table.emplace_back(entry.first, entry.second);
+  }
+  return atom_table;
+}
+
+}
+
+void Save(const GameData& game, const std::string& filename) {
+  Writer writer;
+  writer.Write(kMagic);
+  writer.Write(static_cast<std::int32_t>(kVersion));
+  writer.Write(HashRules(game));
+  writer.Write(AtomTableToVector(game));
+  writer.Write(game.roles);
+  writer.Write(game.atom_to_goal_values);
+  writer.Write(game.initial_facts);
+  writer.Write(game.possible_facts);
+  writer.Write(game.possible_actions);
+  writer.Write(game.atom_to_ordered_domain);
+  writer.Write(game.step_counter_atoms);
+  writer.Write(game.fact_action_connections);
+  writer.Write(game.win_conditions);
+  writer.Write(static_cast<std::uint64_t>(game.completed_analyses.to_ullong()));
+  // Written to a temporary file first, so that a bundle is never partial.
+  // Its name is unique, since other processes can save the same bundle.
+  auto tmp_filename = filename + ".XXXXXX";
+  const auto fd = mkstemp(&tmp_filename[0]);
+  if (fd < 0) {
+    std::cout << "Note: analysis bundle cannot be written: " << tmp_filename << std::endl;
+    return;
+  }
+  close(fd);
+  {
+    std::ofstream ofs(tmp_filename, std::ios::binary);
+    ofs.write(writer.GetBuffer().data(), writer.GetBuffer().size());
+    if (!ofs) {
+      std::cout << "Note: analysis bundle cannot be written: " << tmp_filename << std::endl;
+      std::remove(tmp_filename.c_str());
+      return;
+    }
+  }
+  std::rename(tmp_filename.c_str(), filename.c_str());
+}
+
+std::string SaveAnalysis(const GameData& game, const Analysis analysis) {
+  Writer writer;
+  switch (analysis) {
+  case Analysis::ORDERED_DOMAINS:
+    writer.Write(game.atom_to_ordered_domain);
+    break;
+  case Analysis::STEP_COUNTERS:
+    writer.Write(game.step_counter_atoms);
+    break;
+  case Analysis::FACT_ACTION_CONNECTIONS:
+    writer.Write(game.fact_action_connections);
+    break;
+  case Analysis::WIN_CONDITIONS:
+    writer.Write(game.win_conditions);
+    break;
+  default:
+    assert(false);
+  }
+  return writer.GetBuffer();
+}
+
+void LoadAnalysis(const char* begin, const char* end, const Analysis analysis, GameData& game) {
+  Reader reader(begin, end);
+  switch (analysis) {
+  case Analysis::ORDERED_DOMAINS:
+    reader.Read(game.atom_to_ordered_domain);
+    break;
+  case Analysis::STEP_COUNTERS:
+    reader.Read(game.step_counter_atoms);
+    break;
+  case Analysis::FACT_ACTION_CONNECTIONS:
+    reader.Read(game.fact_action_connections);
+    break;
+  case Analysis::WIN_CONDITIONS:
+    reader.Read(game.win_conditions);
+    break;
+  default:
+    assert(false);
+  }
+  if (!reader.AtEnd()) {
+    throw std::runtime_error("Analysis result has trailing bytes.");
+  }
+}
+
+bool Load(const std::string& filename, GameData& game) {
+  struct stat st;
+  if (stat(filename.c_str(), &st) != 0) {
+    return false;
+  }
+  try {
+    const file_utils::MappedFile file(filename);
+    Reader reader(file.begin(), file.end());
+    std::string magic;
+    std::int32_t version;
+    std::uint64_t rules_hash;
+    reader.Read(magic);
+    reader.Read(version);
+    reader.Read(rules_hash);
+    if (magic != kMagic || version != kVersion || rules_hash != HashRules(game)) {
+      return false;
+    }
+    std::vector<std::pair<Atom, std::string>> atom_table;
+    GameData loaded;
+    reader.Read(atom_table);
+    reader.Read(loaded.roles);
+    reader.Read(loaded.atom_to_goal_values);
+    reader.Read(loaded.initial_facts);
+    reader.Read(loaded.possible_facts);
+    reader.Read(loaded.possible_actions);
+    reader.Read(loaded.atom_to_ordered_domain);
+    reader.Read(loaded.step_counter_atoms);
+    reader.Read(loaded.fact_action_connections);
+    reader.Read(loaded.win_conditions);
+    std::uint64_t completed_analyses;
+    reader.Read(completed_analyses);
+    if (!reader.AtEnd()) {
+      throw std::runtime_error("Analysis bundle has trailing bytes.");
+    }
+    game.atom_to_string.clear();
+    for (const auto& entry : atom_table) {
+      game.atom_to_string.insert(AtomAndString(entry.first, entry.second));
+    }
+    game.roles = std::move(loaded.roles);
+    game.role_indices.clear();
+    game.atom_to_role_index.clear();
+    for (auto role_idx = 0; role_idx < static_cast<int>(game.roles.size()); ++role_idx) {
+      game.role_indices.push_back(role_idx);
+      game.atom_to_role_index.emplace(game.roles[role_idx], role_idx);
+    }
+    game.atom_to_goal_values = std::move(loaded.atom_to_goal_values);
+    game.initial_facts = std::move(loaded.initial_facts);
+    game.possible_facts = std::move(loaded.possible_facts);
+    game.possible_actions = std::move(loaded.possible_actions);
+    game.atom_to_ordered_domain = std::move(loaded.atom_to_ordered_domain);
+    game.step_counter_atoms = std::move(loaded.step_counter_atoms);
+    game.fact_action_connections = std::move(loaded.fact_action_connections);
+    game.win_conditions = std::move(loaded.win_conditions);
+    game.completed_analyses = decltype(game.completed_analyses)(completed_analyses);
+    return true;
+  } catch (const std::runtime_error& e) {
+    std::cout << "Note: analysis bundle is ignored: " << e.what() << std::endl;
+    return false;
+  }
+}
+
+}
+}
@@ -0,0 +1,47 @@
+#ifndef ANALYSIS_BUNDLE_HPP_
+#define ANALYSIS_BUNDLE_HPP_
+
+#include <string>
+
+#include "game_data.hpp"
+
+namespace ggpe {
+namespace bundle {
+
+/**
+ * Version of the bundle format, which must be increased whenever GameData or
+ * the analyses change so that stale bundles are ignored
+ */
+constexpr auto kVersion = 3;
+
+/**
+ * Save the analysis results of a game (atoms, roles, goal values, initial,
+ * possible facts and actions, ordered domains, step counters, fact-action
+ * connections, win conditions and which of the lazy analyses have completed)
+ * into a binary bundle keyed by the hash of its rewritten rules
+ * (GameData::nodes). The bundle is in native byte order.
+ */
+void Save(const GameData& game, const std::string& filename);
+
+/**
+ * Restore the analysis results saved by Save into a game
+ * @return false if the bundle does not exist, or was saved for other rules
+ * or by another version, in which case the game is not modified
+ */
+bool Load(const std::string& filename, GameData& game);
+
+/**
+ * Serialize the result of an analysis, e.g. to pass it between processes
+ */
+std::string SaveAnalysis(const GameData& game, const Analysis analysis);
+
+/**
+ * Restore the result of an analysis serialized by SaveAnalysis into a game
+ * Throws std::runtime_error on a malformed buffer.
+ */
+void LoadAnalysis(const char* begin, const char* end, const Analysis analysis, GameData& game);
+
+}
+}
+
+#endif /* ANALYSIS_BUNDLE_HPP_ */
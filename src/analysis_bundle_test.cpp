@@ -0,0 +1,88 @@
+#include "gtest/gtest.h"
+#include "analysis_bundle.hpp"
+
+#include <cstdio>
+
+namespace ggpe {
+namespace bundle {
+
+namespace {
+
+const auto kBundleFilename = "tmp/analysis_bundle_test.bundle";
+
+GameData CreateGameData() {
+  GameData game;
+  game.kif = "(role white) (role black)";
+  game.nodes = sexpr_parser::Parse(game.kif);
+  game.atom_to_string.insert(AtomAndString(512, "white"));
+  game.atom_to_string.insert(AtomAndString(513, "black"));
+  game.atom_to_string.insert(AtomAndString(514, "cell"));
+  game.atom_to_string.insert(AtomAndString(atoms::kLeftParen, "("));
+  game.roles = {512, 513};
+  game.atom_to_goal_values = {{515, 100}};
+  game.initial_facts = {{514, 512}};
+  game.possible_facts = {{514, 512}, {514, 513}};
+  game.possible_actions = {{{513}}, {{512}}};
+  game.atom_to_ordered_domain = {{514, {{512, 0}, {513, 1}}}};
+  game.step_counter_atoms = {514};
+  game.fact_action_connections = {{AtomPair(514, 512), {{513, {1, 2}}}}};
+  game.win_conditions = {{{{514, 512}}}, {}};
+  game.completed_analyses.set(static_cast<std::size_t>(Analysis::WIN_CONDITIONS));
+  return game;
+}
+
+}
+
+TEST(AnalysisBundle, SaveAndLoad) {
+  const auto game = CreateGameData();
+  Save(game, kBundleFilename);
+  GameData loaded;
+  loaded.nodes = game.nodes;
+  ASSERT_TRUE(Load(kBundleFilename, loaded));
+  ASSERT_EQ(loaded.atom_to_string.size(), game.atom_to_string.size());
+  ASSERT_EQ(loaded.StringToAtom("cell"), 514);
+  ASSERT_EQ(loaded.AtomToString(atoms::kLeftParen), "(");
+  ASSERT_EQ(loaded.roles, game.roles);
+  ASSERT_EQ(loaded.role_indices, std::vector<int>({0, 1}));
+  ASSERT_EQ(loaded.atom_to_role_index.at(513), 1);
+  ASSERT_EQ(loaded.atom_to_goal_values, game.atom_to_goal_values);
+  ASSERT_EQ(loaded.initial_facts, game.initial_facts);
+  ASSERT_EQ(loaded.possible_facts, game.possible_facts);
+  ASSERT_EQ(loaded.possible_actions, game.possible_actions);
+  ASSERT_EQ(loaded.atom_to_ordered_domain, game.atom_to_ordered_domain);
+  ASSERT_EQ(loaded.step_counter_atoms, game.step_counter_atoms);
+  ASSERT_EQ(loaded.fact_action_connections, game.fact_action_connections);
+  ASSERT_EQ(loaded.win_conditions, game.win_conditions);
+  ASSERT_TRUE(loaded.IsAnalyzed(Analysis::WIN_CONDITIONS));
+  ASSERT_FALSE(loaded.IsAnalyzed(Analysis::STEP_COUNTERS));
+  std::remove(kBundleFilename);
+}
+
+TEST(AnalysisBundle, Analysis) {
+  const auto game = CreateGameData();
+  const auto buffer = SaveAnalysis(game, Analysis::FACT_ACTION_CONNECTIONS);
+  GameData loaded;
+  LoadAnalysis(buffer.data(), buffer.data() + buffer.size(), Analysis::FACT_ACTION_CONNECTIONS, loaded);
+  ASSERT_EQ(loaded.fact_action_connections, game.fact_action_connections);
+  ASSERT_TRUE(loaded.win_conditions.empty());
+  ASSERT_THROW(
+      LoadAnalysis(buffer.data(), buffer.data() + buffer.size() - 1, Analysis::FACT_ACTION_CONNECTIONS, loaded),
+      std::runtime_error);
+}
+
+TEST(AnalysisBundle, OtherRules) {
+  const auto game = CreateGameData();
+  Save(game, kBundleFilename);
+  GameData loaded;
+  loaded.kif = game.kif;
+  loaded.nodes = sexpr_parser::Parse("(role white)");
+  // A bundle of other rules is ignored even if the KIF is the same, since
+  // the rules are rewritten from the KIF
+  ASSERT_FALSE(Load(kBundleFilename, loaded));
+  ASSERT_TRUE(loaded.roles.empty());
+  std::remove(kBundleFilename);
+  ASSERT_FALSE(Load(kBundleFilename, loaded));
+}
+
+}
+}
@@ -0,0 +1,450 @@
+#include "datalog.hpp"
+
+#include <iostream>
+#include <stdexcept>
+
+namespace ggpe {
+namespace datalog {
+
+namespace {
+
+using sexpr_parser::TreeNode;
+using Conjunction = std::vector<TreeNode>;
+
+void CollectSubterms(
+    Tuple::const_iterator begin,
+    Tuple::const_iterator end,
+    Tuple& path,
+    std::vector<Subterm>& output) {
+  auto arg_idx = 0;
+  for (auto it = begin; it != end; ++arg_idx) {
+    const auto term_end = FindTermEnd(it);
+    path.push_back(arg_idx);
+    output.push_back(Subterm{path, Tuple(it, term_end)});
+    if (*it == atoms::kLeftParen) {
+      CollectSubterms(it + 1, term_end - 1, path, output);
+    }
+    path.pop_back();
+    it = term_end;
+  }
+}
+
+/**
+ * @return the key of an index for a subterm at a path
+ */
+Tuple ToIndexKey(const Tuple& path, const Tuple& term) {
+  Tuple key(path);
+  key.push_back(kFirstVariable);
+  key.insert(key.end(), term.begin(), term.end());
+  return key;
+}
+
+/**
+ * @return alternatives, each of which is a conjunction of literals
+ */
+std::vector<Conjunction> ExpandLiteral(const TreeNode& literal) {
+  if (!literal.IsLeaf() && literal.GetFunctor() == "or") {
+    std::vector<Conjunction> alternatives;
+    const auto& children = literal.GetChildren();
+    for (auto i = children.begin() + 1; i != children.end(); ++i) {
+      const auto sub_alternatives = ExpandLiteral(*i);
+      alternatives.insert(alternatives.end(), sub_alternatives.begin(), sub_alternatives.end());
+    }
+    return alternatives;
+  }
+  if (!literal.IsLeaf() &&
+      literal.GetFunctor() == "not" &&
+      !literal.GetChildren().back().IsLeaf() &&
+      literal.GetChildren().back().GetFunctor() == "or") {
+    // (not (or a b)) -> (not a) (not b)
+    Conjunction conjunction;
+    const auto& children = literal.GetChildren().back().GetChildren();
+    for (auto i = children.begin() + 1; i != children.end(); ++i) {
+      conjunction.push_back(TreeNode(std::vector<TreeNode>({TreeNode("not"), *i})));
+    }
+    return std::vector<Conjunction>(1, conjunction);
+  }
+  return std::vector<Conjunction>(1, Conjunction(1, literal));
+}
+
+}
+
+Tuple::const_iterator FindTermEnd(Tuple::const_iterator it) {
+  if (*it != atoms::kLeftParen) {
+    return it + 1;
+  }
+  auto depth = 0;
+  do {
+    if (*it == atoms::kLeftParen) {
+      ++depth;
+    } else if (*it == atoms::kRightParen) {
+      --depth;
+    }
+    ++it;
+  } while (depth > 0);
+  return it;
+}
+
+bool Match(
+    const Tuple& pattern,
+    const Tuple& ground,
+    Bindings& bindings,
+    std::vector<int>& newly_bound) {
+  auto g = ground.begin();
+  for (auto p = pattern.begin(); p != pattern.end(); ++p) {
+    if (g == ground.end()) {
+      return false;
+    }
+    if (IsVariable(*p)) {
+      const auto end = FindTermEnd(g);
+      const auto variable_idx = ToVariableIndex(*p);
+      auto& binding = bindings[variable_idx];
+      if (binding.empty()) {
+        binding.assign(g, end);
+        newly_bound.push_back(variable_idx);
+      } else if (static_cast<int>(binding.size()) != end - g ||
+          !std::equal(binding.begin(), binding.end(), g)) {
+        return false;
+      }
+      g = end;
+    } else {
+      if (*p != *g) {
+        return false;
+      }
+      ++g;
+    }
+  }
+  return g == ground.end();
+}
+
+bool Substitute(const Tuple& pattern, const Bindings& bindings, Tuple& output) {
+  output.clear();
+  output.reserve(pattern.size());
+  for (const auto atom : pattern) {
+    if (IsVariable(atom)) {
+      const auto& binding = bindings[ToVariableIndex(atom)];
+      if (binding.empty()) {
+        return false;
+      }
+      output.insert(output.end(), binding.begin(), binding.end());
+    } else {
+      output.push_back(atom);
+    }
+  }
+  return true;
+}
+
+int CountBoundVariables(const Tuple& pattern, const Bindings& bindings) {
+  return std::count_if(pattern.begin(), pattern.end(), [&](const Atom atom) {
+    return IsVariable(atom) && !bindings[ToVariableIndex(atom)].empty();
+  });
+}
+
+int CountVariables(const Tuple& pattern) {
+  return std::count_if(pattern.begin(), pattern.end(), IsVariable);
+}
+
+bool ContainsVariable(const Tuple& pattern) {
+  return std::any_of(pattern.begin(), pattern.end(), IsVariable);
+}
+
+Atom FindAtom(const GameData& game, const std::string& str) {
+  const auto it = game.atom_to_string.right.find(str);
+  return it == game.atom_to_string.right.end() ? kNoAtom : it->second;
+}
+
+std::vector<Subterm> CollectSubterms(const Tuple& literal) {
+  std::vector<Subterm> subterms;
+  Tuple path;
+  CollectSubterms(literal.begin() + 1, literal.end(), path, subterms);
+  return subterms;
+}
+
+bool Table::Insert(const Tuple& tuple) {
+  if (!tuple_ids.emplace(tuple, tuples.size()).second) {
+    return false;
+  }
+  for (const auto& subterm : CollectSubterms(tuple)) {
+    auto& bucket = index[ToIndexKey(subterm.path, subterm.term)];
+    if (bucket.empty()) {
+      ++domain_sizes[subterm.path];
+    }
+    bucket.push_back(tuples.size());
+  }
+  tuples.push_back(tuple);
+  return true;
+}
+
+bool Table::Contains(const Tuple& tuple) const {
+  return tuple_ids.count(tuple);
+}
+
+int Table::FindId(const Tuple& tuple) const {
+  const auto it = tuple_ids.find(tuple);
+  return it == tuple_ids.end() ? -1 : it->second;
+}
+
+const std::vector<int>& Table::Find(const Tuple& path, const Tuple& term) const {
+  static const std::vector<int> kEmptyBucket;
+  const auto it = index.find(ToIndexKey(path, term));
+  return it == index.end() ? kEmptyBucket : it->second;
+}
+
+int Table::GetDomainSize(const Tuple& path) const {
+  const auto it = domain_sizes.find(path);
+  return it == domain_sizes.end() ? 0 : it->second;
+}
+
+Database::Database(const DatabaseCsp& base) : base_(base), tables_() {
+}
+
+const Table* Database::Find(const Atom relation) const {
+  const auto it = tables_.find(relation);
+  if (it != tables_.end()) {
+    return &it->second;
+  }
+  return base_ ? base_->Find(relation) : nullptr;
+}
+
+Table& Database::GetTable(const Atom relation) {
+  return tables_[relation];
+}
+
+bool Database::Contains(const Tuple& tuple) const {
+  const auto table = Find(tuple.front());
+  return table && table->Contains(tuple);
+}
+
+int Database::GetSize(const Atom relation) const {
+  const auto table = Find(relation);
+  return table ? table->tuples.size() : 0;
+}
+
+Budget::Budget(const long long max_step_count) :
+    max_step_count_(max_step_count), step_count_(0) {
+}
+
+void Budget::Throw() const {
+  throw std::runtime_error("Evaluation took more than " + std::to_string(max_step_count_) + " steps.");
+}
+
+RuleBuilder::RuleBuilder(const GameData& game) : game_(game), variables_() {
+}
+
+Rule RuleBuilder::Build(const TreeNode& head, const Conjunction& body) {
+  variables_.clear();
+  Rule rule;
+  rule.head = ToLiteral(head);
+  for (const auto& literal : body) {
+    if (literal.IsLeaf()) {
+      rule.positives.push_back(ToLiteral(literal));
+    } else if (literal.GetFunctor() == "not") {
+      assert(literal.GetChildren().size() == 2);
+      rule.negatives.push_back(ToLiteral(literal.GetChildren().back()));
+    } else if (literal.GetFunctor() == "distinct") {
+      assert(literal.GetChildren().size() == 3);
+      Tuple lhs;
+      Tuple rhs;
+      AppendTerm(literal.GetChildren().at(1), lhs);
+      AppendTerm(literal.GetChildren().at(2), rhs);
+      rule.distincts.emplace_back(lhs, rhs);
+    } else {
+      rule.positives.push_back(ToLiteral(literal));
+    }
+  }
+  rule.variable_count = variables_.size();
+  for (const auto& pattern : rule.positives) {
+    rule.positive_subterms.push_back(CollectSubterms(pattern));
+  }
+  return rule;
+}
+
+Tuple RuleBuilder::ToLiteral(const TreeNode& node) {
+  Tuple literal;
+  if (node.IsLeaf()) {
+    AppendTerm(node, literal);
+  } else {
+    const auto& children = node.GetChildren();
+    literal.push_back(game_.StringToAtom(children.front().GetValue()));
+    for (auto i = children.begin() + 1; i != children.end(); ++i) {
+      AppendTerm(*i, literal);
+    }
+  }
+  return literal;
+}
+
+void RuleBuilder::AppendTerm(const TreeNode& node, Tuple& output) {
+  if (node.IsVariable()) {
+    const auto it = variables_.emplace(node.GetValue(), variables_.size()).first;
+    output.push_back(kFirstVariable - it->second);
+  } else if (node.IsLeaf()) {
+    output.push_back(game_.StringToAtom(node.GetValue()));
+  } else {
+    output.push_back(atoms::kLeftParen);
+    for (const auto& child : node.GetChildren()) {
+      AppendTerm(child, output);
+    }
+    output.push_back(atoms::kRightParen);
+  }
+}
+
+std::vector<Conjunction> ExpandBody(
+    std::vector<TreeNode>::const_iterator begin,
+    std::vector<TreeNode>::const_iterator end) {
+  std::vector<Conjunction> conjunctions(1);
+  for (auto i = begin; i != end; ++i) {
+    const auto alternatives = ExpandLiteral(*i);
+    std::vector<Conjunction> expanded;
+    expanded.reserve(conjunctions.size() * alternatives.size());
+    for (const auto& conjunction : conjunctions) {
+      for (const auto& alternative : alternatives) {
+        expanded.push_back(conjunction);
+        expanded.back().insert(expanded.back().end(), alternative.begin(), alternative.end());
+      }
+    }
+    conjunctions.swap(expanded);
+  }
+  return conjunctions;
+}
+
+std::vector<Rule> BuildRules(const std::vector<TreeNode>& nodes, const GameData& game) {
+  RuleBuilder builder(game);
+  std::vector<Rule> rules;
+  for (const auto& node : nodes) {
+    if (!node.IsImplication()) {
+      auto fact = builder.Build(node, Conjunction());
+      if (ContainsVariable(fact.head)) {
+        std::cout << "Note: non-ground fact is ignored: " << node.ToSexpr() << std::endl;
+        continue;
+      }
+      rules.push_back(fact);
+      continue;
+    }
+    const auto& children = node.GetChildren();
+    for (const auto& conjunction : ExpandBody(children.begin() + 2, children.end())) {
+      rules.push_back(builder.Build(children.at(1), conjunction));
+    }
+  }
+  return rules;
+}
+
+std::vector<std::vector<const Rule*>> Stratify(
+    const std::vector<const Rule*>& rules,
+    const sexpr_parser::RuleGraph& graph,
+    const GameData& game) {
+  if (!graph.IsStratified()) {
+    throw std::runtime_error("Relations cannot be stratified.");
+  }
+  std::vector<std::vector<const Rule*>> stratified;
+  for (const auto rule : rules) {
+    const auto relation_idx = graph.GetRelationIndex(game.AtomToString(rule->head.front()));
+    assert(relation_idx >= 0);
+    const auto stratum = graph.GetStratum(relation_idx);
+    if (stratum >= static_cast<int>(stratified.size())) {
+      stratified.resize(stratum + 1);
+    }
+    stratified[stratum].push_back(rule);
+  }
+  // Strata of relations without given rules are skipped
+  stratified.erase(
+      std::remove_if(stratified.begin(), stratified.end(), [](const std::vector<const Rule*>& stratum_rules) {
+        return stratum_rules.empty();
+      }),
+      stratified.end());
+  return stratified;
+}
+
+Enumerator::Enumerator(
+    const Rule& rule,
+    const Database& database,
+    const std::unordered_set<Atom>& exact_relations,
+    Budget& budget,
+    const std::vector<TupleRange>& ranges) :
+        rule_(rule),
+        database_(database),
+        exact_relations_(exact_relations),
+        budget_(budget),
+        ranges_(ranges),
+        bindings_(rule.variable_count),
+        used_(rule.positives.size(), false) {
+  ranges_.resize(rule.positives.size(), kAllTuples);
+}
+
+std::pair<int, const std::vector<int>*> Enumerator::SelectLiteral() const {
+  static const std::vector<int> kEmptyBucket;
+  auto best_idx = -1;
+  const std::vector<int>* best_bucket = nullptr;
+  auto best_size = 0;
+  Tuple term;
+  for (auto i = 0; i < static_cast<int>(rule_.positives.size()); ++i) {
+    if (used_[i]) {
+      continue;
+    }
+    const auto& pattern = rule_.positives[i];
+    const auto table = database_.Find(pattern.front());
+    if (!table) {
+      // No tuple can match
+      return std::make_pair(i, &kEmptyBucket);
+    }
+    const auto& range = ranges_[i];
+    const std::vector<int>* bucket = nullptr;
+    auto size = static_cast<int>(table->tuples.size());
+    if (CountVariables(pattern) == CountBoundVariables(pattern, bindings_)) {
+      size = 0;
+    } else {
+      for (const auto& subterm : rule_.positive_subterms[i]) {
+        if (!Substitute(subterm.term, bindings_, term)) {
+          continue;
+        }
+        const auto& candidates = table->Find(subterm.path, term);
+        if (!bucket || static_cast<int>(candidates.size()) < size) {
+          bucket = &candidates;
+          size = candidates.size();
+        }
+      }
+    }
+    size = std::min(size, std::min(range.second, static_cast<int>(table->tuples.size())) - range.first);
+    if (best_idx < 0 || size < best_size) {
+      best_idx = i;
+      best_bucket = bucket;
+      best_size = size;
+    }
+  }
+  assert(best_idx >= 0);
+  return std::make_pair(best_idx, best_bucket);
+}
+
+bool Enumerator::CheckDistincts(const bool requires_ground) const {
+  Tuple lhs;
+  Tuple rhs;
+  for (const auto& distinct : rule_.distincts) {
+    if (!Substitute(distinct.first, bindings_, lhs) ||
+        !Substitute(distinct.second, bindings_, rhs)) {
+      if (requires_ground) {
+        return false;
+      }
+      continue;
+    }
+    if (lhs == rhs) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool Enumerator::CheckNegatives() const {
+  Tuple literal;
+  for (const auto& pattern : rule_.negatives) {
+    if (!exact_relations_.count(pattern.front()) ||
+        !Substitute(pattern, bindings_, literal)) {
+      continue;
+    }
+    if (database_.Contains(literal)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}
+}
@@ -0,0 +1,404 @@
+#ifndef DATALOG_HPP_
+#define DATALOG_HPP_
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+
+#include "ggpe.hpp"
+#include "sexpr_parser.hpp"
+#include "rule_graph.hpp"
+#include "game_data.hpp"
+
+namespace ggpe {
+namespace datalog {
+
+/**
+ * Bound term for each variable (empty if unbound)
+ */
+using Bindings = std::vector<Tuple>;
+
+/**
+ * Variables in patterns are encoded as atoms below this value
+ */
+constexpr Atom kFirstVariable = -1024;
+
+/**
+ * Used for reserved relations which do not appear in a game
+ */
+constexpr Atom kNoAtom = kFirstVariable + 1;
+
+inline bool IsVariable(const Atom atom) {
+  return atom <= kFirstVariable;
+}
+
+inline int ToVariableIndex(const Atom atom) {
+  return kFirstVariable - atom;
+}
+
+/**
+ * @return the end of a term that begins at a given position
+ */
+Tuple::const_iterator FindTermEnd(Tuple::const_iterator it);
+
+/**
+ * Match a pattern against a ground tuple. Variables bound by this call are
+ * appended to newly_bound so that the caller can unbind them.
+ */
+bool Match(
+    const Tuple& pattern,
+    const Tuple& ground,
+    Bindings& bindings,
+    std::vector<int>& newly_bound);
+
+/**
+ * @return false if a pattern contains an unbound variable
+ */
+bool Substitute(const Tuple& pattern, const Bindings& bindings, Tuple& output);
+
+int CountBoundVariables(const Tuple& pattern, const Bindings& bindings);
+int CountVariables(const Tuple& pattern);
+bool ContainsVariable(const Tuple& pattern);
+
+/**
+ * @return the atom of a given string, or kNoAtom if it does not appear
+ */
+Atom FindAtom(const GameData& game, const std::string& str);
+
+/**
+ * Subterm of a literal with its path, i.e. the sequence of argument positions
+ * from the literal (e.g. 'b' in (true (cell 1 1 b)) is at [0, 3])
+ */
+struct Subterm {
+  Tuple path;
+  Tuple term;
+};
+
+/**
+ * @return every subterm of the arguments of a literal
+ */
+std::vector<Subterm> CollectSubterms(const Tuple& literal);
+
+/**
+ * Rule whose literals are patterns, i.e. tuples which may contain variables
+ */
+struct Rule {
+  Tuple head;
+  std::vector<Tuple> positives;
+  std::vector<Tuple> negatives;
+  std::vector<std::pair<Tuple, Tuple>> distincts;
+  int variable_count;
+  // Subterms of each positive literal
+  std::vector<std::vector<Subterm>> positive_subterms;
+};
+
+/**
+ * Tuples of a relation, indexed by each subterm
+ */
+struct Table {
+  std::vector<Tuple> tuples;
+  std::unordered_map<Tuple, int, boost::hash<Tuple>> tuple_ids;
+  // Path and subterm -> indices of tuples
+  std::unordered_map<Tuple, std::vector<int>, boost::hash<Tuple>> index;
+  // Path -> the number of distinct subterms
+  std::unordered_map<Tuple, int, boost::hash<Tuple>> domain_sizes;
+  bool Insert(const Tuple& tuple);
+  bool Contains(const Tuple& tuple) const;
+  /**
+   * @return the index of a tuple, or -1 if not found
+   */
+  int FindId(const Tuple& tuple) const;
+  /**
+   * @return tuples which have a given subterm at a given path
+   */
+  const std::vector<int>& Find(const Tuple& path, const Tuple& term) const;
+  /**
+   * @return the number of distinct subterms at a path
+   */
+  int GetDomainSize(const Tuple& path) const;
+};
+
+class Database;
+using DatabaseCsp = std::shared_ptr<const Database>;
+
+/**
+ * Tables of relations, which may be layered on a base database.
+ * Tables of a layer hide those of its base, thus a relation should be derived
+ * in only one layer.
+ */
+class Database {
+public:
+  explicit Database(const DatabaseCsp& base=nullptr);
+  /**
+   * @return the table of a relation in this layer or its bases, or null
+   */
+  const Table* Find(const Atom relation) const;
+  /**
+   * @return the table of a relation in this layer
+   */
+  Table& GetTable(const Atom relation);
+  bool Contains(const Tuple& tuple) const;
+  /**
+   * @return the number of tuples of a relation
+   */
+  int GetSize(const Atom relation) const;
+private:
+  DatabaseCsp base_;
+  std::unordered_map<Atom, Table> tables_;
+};
+
+/**
+ * Counts enumeration steps and bails out when they exceed a limit
+ */
+class Budget {
+public:
+  explicit Budget(const long long max_step_count=std::numeric_limits<long long>::max());
+  void Consume() {
+    if (++step_count_ > max_step_count_) {
+      Throw();
+    }
+  }
+private:
+  void Throw() const;
+  const long long max_step_count_;
+  long long step_count_;
+};
+
+/**
+ * Converts nodes of a rule into patterns
+ */
+class RuleBuilder {
+public:
+  explicit RuleBuilder(const GameData& game);
+  Rule Build(const sexpr_parser::TreeNode& head, const std::vector<sexpr_parser::TreeNode>& body);
+  Tuple ToLiteral(const sexpr_parser::TreeNode& node);
+private:
+  void AppendTerm(const sexpr_parser::TreeNode& node, Tuple& output);
+  const GameData& game_;
+  std::unordered_map<std::string, int> variables_;
+};
+
+/**
+ * Expand disjunctions in a body
+ * @return alternatives, each of which is a conjunction of literals
+ */
+std::vector<std::vector<sexpr_parser::TreeNode>> ExpandBody(
+    std::vector<sexpr_parser::TreeNode>::const_iterator begin,
+    std::vector<sexpr_parser::TreeNode>::const_iterator end);
+
+/**
+ * Convert the facts and rules of a game into rules, where facts are rules
+ * without body
+ */
+std::vector<Rule> BuildRules(const std::vector<sexpr_parser::TreeNode>& nodes, const GameData& game);
+
+/**
+ * Split rules into strata by the strata of their relations in the rule graph
+ * of the nodes they are built from, so that each rule only negates relations
+ * derived by lower strata or not derived by given rules
+ * @throw std::runtime_error if the relations cannot be stratified
+ */
+std::vector<std::vector<const Rule*>> Stratify(
+    const std::vector<const Rule*>& rules,
+    const sexpr_parser::RuleGraph& graph,
+    const GameData& game);
+
+/**
+ * Range of the indices of tuples in a table
+ */
+using TupleRange = std::pair<int, int>;
+
+const TupleRange kAllTuples(0, std::numeric_limits<int>::max());
+
+/**
+ * Enumerates the instances of a rule whose positive literals are in tables.
+ * Each positive literal can be restricted to a range of tuples. Negative
+ * literals of exact relations (whose tables are complete) are checked too,
+ * the others are ignored.
+ */
+class Enumerator {
+public:
+  Enumerator(
+      const Rule& rule,
+      const Database& database,
+      const std::unordered_set<Atom>& exact_relations,
+      Budget& budget,
+      const std::vector<TupleRange>& ranges=std::vector<TupleRange>());
+
+  template <class Callback>
+  void Run(Callback& callback) {
+    Recurse(0, callback);
+  }
+
+private:
+  template <class Callback>
+  void Recurse(const int depth, Callback& callback);
+
+  /**
+   * Select the literal with the fewest candidate tuples, i.e. the smallest
+   * index bucket of its bound arguments (or its table if none is bound)
+   * @return the literal and its bucket (null if the whole table is scanned)
+   */
+  std::pair<int, const std::vector<int>*> SelectLiteral() const;
+
+  /**
+   * @return false if some distinct is violated (or unbound when required)
+   */
+  bool CheckDistincts(const bool requires_ground) const;
+
+  /**
+   * @return false if some negative literal of an exact relation holds
+   */
+  bool CheckNegatives() const;
+
+  const Rule& rule_;
+  const Database& database_;
+  const std::unordered_set<Atom>& exact_relations_;
+  Budget& budget_;
+  std::vector<TupleRange> ranges_;
+  Bindings bindings_;
+  std::vector<bool> used_;
+};
+
+template <class Callback>
+void Enumerator::Recurse(const int depth, Callback& callback) {
+  budget_.Consume();
+  const auto is_complete = depth == static_cast<int>(rule_.positives.size());
+  if (!CheckDistincts(is_complete)) {
+    return;
+  }
+  if (is_complete) {
+    if (CheckNegatives()) {
+      callback(static_cast<const Bindings&>(bindings_));
+    }
+    return;
+  }
+  const auto selection = SelectLiteral();
+  const auto literal_idx = selection.first;
+  const auto& pattern = rule_.positives[literal_idx];
+  const auto table = database_.Find(pattern.front());
+  if (!table) {
+    return;
+  }
+  const auto& range = ranges_[literal_idx];
+  used_[literal_idx] = true;
+  Tuple ground;
+  if (Substitute(pattern, bindings_, ground)) {
+    // Fully bound literal is just looked up
+    const auto id = table->FindId(ground);
+    if (id >= range.first && id < range.second) {
+      Recurse(depth + 1, callback);
+    }
+  } else {
+    std::vector<int> newly_bound;
+    auto try_tuple = [&](const Tuple& tuple) {
+      budget_.Consume();
+      if (Match(pattern, tuple, bindings_, newly_bound)) {
+        Recurse(depth + 1, callback);
+      }
+      for (const auto variable_idx : newly_bound) {
+        bindings_[variable_idx].clear();
+      }
+      newly_bound.clear();
+    };
+    if (selection.second) {
+      // Indices in a bucket are sorted
+      const auto& bucket = *selection.second;
+      for (auto it = std::lower_bound(bucket.begin(), bucket.end(), range.first);
+          it != bucket.end() && *it < range.second; ++it) {
+        try_tuple(table->tuples[*it]);
+      }
+    } else {
+      const auto end = std::min(range.second, static_cast<int>(table->tuples.size()));
+      for (auto i = range.first; i < end; ++i) {
+        try_tuple(table->tuples[i]);
+      }
+    }
+  }
+  used_[literal_idx] = false;
+}
+
+/**
+ * Evaluate rules until no new tuple is derived.
+ * Semi-naive evaluation: each iteration only enumerates the instances which
+ * use at least one tuple derived in the previous iteration.
+ * Derived heads are passed to insert(head, changed_relations).
+ */
+template <class Insert>
+void Saturate(
+    const std::vector<const Rule*>& rules,
+    const Database& database,
+    const std::unordered_set<Atom>& exact_relations,
+    Budget& budget,
+    Insert insert) {
+  // Table sizes before and after the previous iteration
+  std::unordered_map<Atom, int> old_sizes;
+  std::unordered_map<Atom, int> sizes;
+  auto is_first_iteration = true;
+  std::unordered_set<Atom> changed;
+  std::vector<Tuple> heads;
+  while (is_first_iteration || !changed.empty()) {
+    for (const auto rule : rules) {
+      for (const auto& pattern : rule->positives) {
+        sizes[pattern.front()] = database.GetSize(pattern.front());
+      }
+    }
+    std::unordered_set<Atom> next_changed;
+    for (const auto rule : rules) {
+      heads.clear();
+      auto collect_head = [&](const Bindings& bindings) {
+        Tuple head;
+        if (Substitute(rule->head, bindings, head)) {
+          heads.push_back(head);
+        }
+      };
+      const auto& positives = rule->positives;
+      if (is_first_iteration) {
+        std::vector<TupleRange> ranges;
+        for (const auto& pattern : positives) {
+          ranges.emplace_back(0, sizes[pattern.front()]);
+        }
+        Enumerator(*rule, database, exact_relations, budget, ranges).Run(collect_head);
+      } else {
+        for (auto i = 0; i < static_cast<int>(positives.size()); ++i) {
+          const auto relation = positives[i].front();
+          if (!changed.count(relation)) {
+            continue;
+          }
+          // Old tuples before the i-th literal, new ones at it
+          std::vector<TupleRange> ranges;
+          for (auto j = 0; j < static_cast<int>(positives.size()); ++j) {
+            const auto other_relation = positives[j].front();
+            if (j < i) {
+              ranges.emplace_back(0, old_sizes[other_relation]);
+            } else if (j == i) {
+              ranges.emplace_back(old_sizes[other_relation], sizes[other_relation]);
+            } else {
+              ranges.emplace_back(0, sizes[other_relation]);
+            }
+          }
+          Enumerator(*rule, database, exact_relations, budget, ranges).Run(collect_head);
+        }
+      }
+      for (const auto& head : heads) {
+        insert(head, next_changed);
+      }
+    }
+    old_sizes = sizes;
+    changed.swap(next_changed);
+    is_first_iteration = false;
+  }
+}
+
+}
+}
+
+#endif /* DATALOG_HPP_ */
@@ -0,0 +1,509 @@
+#include "datalog_engine.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+#include <glog/logging.h>
+
+#include "grounder.hpp"
+#include "optimizer.hpp"
+#include "rule_graph.hpp"
+
+namespace ggpe {
+namespace datalog {
+
+namespace {
+
+// Atoms below are reserved (see atoms)
+constexpr Atom kFirstMaterializedAtom = 512;
+
+std::mt19937& GetRandomEngine() {
+  static thread_local std::mt19937 random_engine(std::random_device{}());
+  return random_engine;
+}
+
+void Insert(const Tuple& tuple, Database& database, std::unordered_set<Atom>& changed) {
+  if (database.GetTable(tuple.front()).Insert(tuple)) {
+    changed.insert(tuple.front());
+  }
+}
+
+/**
+ * @return true iif the distincts and negative literals of a rule hold
+ */
+bool HoldsConditions(const Rule& rule, const Bindings& bindings, const Database& database) {
+  Tuple lhs;
+  Tuple rhs;
+  for (const auto& distinct : rule.distincts) {
+    if (!Substitute(distinct.first, bindings, lhs) ||
+        !Substitute(distinct.second, bindings, rhs) ||
+        lhs == rhs) {
+      return false;
+    }
+  }
+  Tuple literal;
+  for (const auto& pattern : rule.negatives) {
+    if (Substitute(pattern, bindings, literal) && database.Contains(literal)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}
+
+Evaluator::Evaluator(
+    const GameDataCsp& game,
+    const std::vector<sexpr_parser::TreeNode>& nodes,
+    const bool detects_frame_axioms) :
+    game_(game),
+    rules_(BuildRules(nodes, *game)),
+    exact_relations_(),
+    static_database_(),
+    state_strata_(),
+    joint_action_strata_(),
+    frame_axioms_(),
+    true_atom_(FindAtom(*game, "true")),
+    does_atom_(FindAtom(*game, "does")),
+    next_atom_(FindAtom(*game, "next")),
+    legal_atom_(FindAtom(*game, "legal")),
+    goal_atom_(FindAtom(*game, "goal")),
+    terminal_atom_(FindAtom(*game, "terminal")) {
+  for (const auto& entry : game->atom_to_string.left) {
+    exact_relations_.insert(entry.first);
+  }
+
+  // Relations which depend on 'true' or 'does'
+  const sexpr_parser::RuleGraph graph(nodes);
+  std::unordered_set<Atom> state_relations;
+  for (const auto& relation : graph.CollectDependents({"true"})) {
+    state_relations.insert(FindAtom(*game, relation));
+  }
+  std::unordered_set<Atom> joint_action_relations;
+  for (const auto& relation : graph.CollectDependents({"does"})) {
+    joint_action_relations.insert(FindAtom(*game, relation));
+  }
+
+  std::vector<const Rule*> static_rules;
+  std::vector<const Rule*> state_rules;
+  std::vector<const Rule*> joint_action_rules;
+  for (const auto& rule : rules_) {
+    const auto relation = rule.head.front();
+    if (joint_action_relations.count(relation)) {
+      joint_action_rules.push_back(&rule);
+    } else if (state_relations.count(relation)) {
+      state_rules.push_back(&rule);
+    } else {
+      static_rules.push_back(&rule);
+    }
+  }
+  auto static_database = std::make_shared<Database>();
+  Evaluate(Stratify(static_rules, graph, *game), *static_database);
+  static_database_ = static_database;
+  if (detects_frame_axioms) {
+    DetectFrameAxioms(state_rules);
+    DetectFrameAxioms(joint_action_rules);
+  }
+  VLOG(1) << "Detected " << frame_axioms_.size() << " frame axioms.";
+  state_strata_ = Stratify(state_rules, graph, *game);
+  joint_action_strata_ = Stratify(joint_action_rules, graph, *game);
+}
+
+void Evaluator::DetectFrameAxioms(std::vector<const Rule*>& rules) {
+  if (true_atom_ == kNoAtom || next_atom_ == kNoAtom) {
+    return;
+  }
+  std::vector<const Rule*> other_rules;
+  for (const auto rule : rules) {
+    const auto& head = rule->head;
+    auto is_frame_axiom = head.front() == next_atom_;
+    auto true_literal_idx = -1;
+    for (auto i = 0; is_frame_axiom && i < static_cast<int>(rule->positives.size()); ++i) {
+      const auto& pattern = rule->positives[i];
+      if (true_literal_idx < 0 &&
+          pattern.front() == true_atom_ &&
+          pattern.size() == head.size() &&
+          std::equal(pattern.begin() + 1, pattern.end(), head.begin() + 1)) {
+        true_literal_idx = i;
+      } else if (pattern.front() != does_atom_) {
+        is_frame_axiom = false;
+      }
+    }
+    if (!is_frame_axiom || true_literal_idx < 0) {
+      other_rules.push_back(rule);
+      continue;
+    }
+    FrameAxiom frame_axiom{rule, true_literal_idx, Rule()};
+    auto& does_rule = frame_axiom.does_rule;
+    does_rule.variable_count = rule->variable_count;
+    for (auto i = 0; i < static_cast<int>(rule->positives.size()); ++i) {
+      if (i != true_literal_idx) {
+        does_rule.positives.push_back(rule->positives[i]);
+        does_rule.positive_subterms.push_back(rule->positive_subterms[i]);
+      }
+    }
+    frame_axioms_.push_back(frame_axiom);
+  }
+  rules.swap(other_rules);
+}
+
+void Evaluator::KeepFacts(
+    const Database& database,
+    const FrameAxiom& frame_axiom,
+    FactSet& facts,
+    std::unordered_set<Fact, boost::hash<Fact>>& fact_set) const {
+  const auto table = database.Find(true_atom_);
+  if (!table) {
+    return;
+  }
+  // Bindings of the 'does' literals, which are at most one for each role
+  std::vector<Bindings> does_bindings_list;
+  auto collect_bindings = [&](const Bindings& bindings) {
+    does_bindings_list.push_back(bindings);
+  };
+  Budget budget;
+  Enumerator(frame_axiom.does_rule, database, exact_relations_, budget).Run(collect_bindings);
+  if (does_bindings_list.empty()) {
+    return;
+  }
+  const auto& rule = *frame_axiom.rule;
+  const auto& true_pattern = rule.positives[frame_axiom.true_literal_idx];
+  Bindings bindings;
+  std::vector<int> newly_bound;
+  auto try_tuple = [&](const Tuple& tuple, const Bindings& does_bindings) {
+    bindings = does_bindings;
+    newly_bound.clear();
+    if (!Match(true_pattern, tuple, bindings, newly_bound) ||
+        !HoldsConditions(rule, bindings, database)) {
+      return false;
+    }
+    auto fact = grounder::SplitArgs(tuple).front();
+    if (fact_set.insert(fact).second) {
+      facts.push_back(std::move(fact));
+    }
+    return true;
+  };
+  // For each binding of 'does', only the facts which have the most selective
+  // subterm of (true P) bound by it are tried, e.g. the facts of a relation,
+  // or those of a role bound by (does ?r A). Bindings which select the same
+  // facts are tried together, so that each fact is tried once.
+  std::vector<std::pair<const std::vector<int>*, std::vector<const Bindings*>>> groups;
+  Tuple term;
+  for (const auto& does_bindings : does_bindings_list) {
+    const std::vector<int>* selected_tuple_ids = nullptr;
+    for (const auto& subterm : rule.positive_subterms[frame_axiom.true_literal_idx]) {
+      if (Substitute(subterm.term, does_bindings, term)) {
+        const auto& tuple_ids = table->Find(subterm.path, term);
+        if (!selected_tuple_ids || tuple_ids.size() < selected_tuple_ids->size()) {
+          selected_tuple_ids = &tuple_ids;
+        }
+      }
+    }
+    if (!selected_tuple_ids) {
+      groups.clear();
+      break;
+    }
+    const auto group_it = std::find_if(groups.begin(), groups.end(),
+        [&](const std::pair<const std::vector<int>*, std::vector<const Bindings*>>& group) {
+          return group.first == selected_tuple_ids;
+        });
+    if (group_it == groups.end()) {
+      groups.emplace_back(selected_tuple_ids, std::vector<const Bindings*>({&does_bindings}));
+    } else {
+      group_it->second.push_back(&does_bindings);
+    }
+  }
+  if (groups.empty()) {
+    // (true ?x) binds nothing, thus every fact is tried
+    for (const auto& tuple : table->tuples) {
+      for (const auto& does_bindings : does_bindings_list) {
+        if (try_tuple(tuple, does_bindings)) {
+          break;
+        }
+      }
+    }
+    return;
+  }
+  for (const auto& group : groups) {
+    for (const auto tuple_idx : *group.first) {
+      for (const auto does_bindings : group.second) {
+        if (try_tuple(table->tuples[tuple_idx], *does_bindings)) {
+          break;
+        }
+      }
+    }
+  }
+}
+
+void Evaluator::Evaluate(const std::vector<std::vector<const Rule*>>& strata, Database& database) const {
+  Budget budget;
+  auto insert = [&](const Tuple& tuple, std::unordered_set<Atom>& changed) {
+    Insert(tuple, database, changed);
+  };
+  for (const auto& rules : strata) {
+    Saturate(rules, database, exact_relations_, budget, insert);
+  }
+}
+
+const GameDataCsp& Evaluator::GetGame() const {
+  return game_;
+}
+
+DatabaseCsp Evaluator::EvaluateState(const FactSet& facts) const {
+  auto database = std::make_shared<Database>(static_database_);
+  if (true_atom_ != kNoAtom) {
+    auto& table = database->GetTable(true_atom_);
+    for (const auto& fact : facts) {
+      table.Insert(grounder::ArgsToLiteral(true_atom_, {fact}));
+    }
+  }
+  Evaluate(state_strata_, *database);
+  return database;
+}
+
+DatabaseCsp Evaluator::EvaluateJointAction(
+    const DatabaseCsp& state_database,
+    const JointAction& joint_action) const {
+  assert(joint_action.size() == game_->roles.size());
+  auto database = std::make_shared<Database>(state_database);
+  if (does_atom_ != kNoAtom) {
+    auto& table = database->GetTable(does_atom_);
+    for (auto role_idx = 0; role_idx < static_cast<int>(joint_action.size()); ++role_idx) {
+      const auto role = Tuple({game_->roles[role_idx]});
+      table.Insert(grounder::ArgsToLiteral(does_atom_, {role, joint_action[role_idx]}));
+    }
+  }
+  Evaluate(joint_action_strata_, *database);
+  return database;
+}
+
+FactSet Evaluator::GetNextFacts(const Database& database) const {
+  FactSet facts;
+  std::unordered_set<Fact, boost::hash<Fact>> fact_set;
+  if (const auto table = database.Find(next_atom_)) {
+    for (const auto& literal : table->tuples) {
+      const auto args = grounder::SplitArgs(literal);
+      assert(args.size() == 1);
+      fact_set.insert(args.front());
+      facts.push_back(args.front());
+    }
+  }
+  for (const auto& frame_axiom : frame_axioms_) {
+    KeepFacts(database, frame_axiom, facts, fact_set);
+  }
+  return facts;
+}
+
+std::vector<ActionSet> Evaluator::GetLegalActions(const Database& database) const {
+  std::vector<ActionSet> legal_actions(game_->roles.size());
+  if (const auto table = database.Find(legal_atom_)) {
+    for (const auto& literal : table->tuples) {
+      const auto args = grounder::SplitArgs(literal);
+      assert(args.size() == 2 && args.front().size() == 1);
+      const auto role_it = game_->atom_to_role_index.find(args.front().front());
+      if (role_it != game_->atom_to_role_index.end()) {
+        legal_actions[role_it->second].push_back(args.back());
+      }
+    }
+  }
+  return legal_actions;
+}
+
+bool Evaluator::IsTerminal(const Database& database) const {
+  return database.GetSize(terminal_atom_) > 0;
+}
+
+std::vector<int> Evaluator::GetGoals(const Database& database) const {
+  std::vector<int> goals(game_->roles.size(), 0);
+  if (const auto table = database.Find(goal_atom_)) {
+    for (const auto& literal : table->tuples) {
+      assert(literal.size() == 3);
+      const auto role_it = game_->atom_to_role_index.find(literal[1]);
+      if (role_it != game_->atom_to_role_index.end()) {
+        goals[role_it->second] = game_->atom_to_goal_values.at(literal[2]);
+      }
+    }
+  }
+  return goals;
+}
+
+DatalogState::DatalogState(
+    const EvaluatorSp& evaluator,
+    const FactSet& facts,
+    const std::vector<JointAction>& joint_action_history) :
+        evaluator_(evaluator),
+        facts_(facts),
+        database_(evaluator->EvaluateState(facts)),
+        legal_actions_(),
+        is_terminal_(evaluator->IsTerminal(*database_)),
+        goals_(),
+        joint_action_history_(joint_action_history) {
+  if (is_terminal_) {
+    goals_ = evaluator_->GetGoals(*database_);
+  } else {
+    legal_actions_ = evaluator_->GetLegalActions(*database_);
+  }
+}
+
+const FactSet& DatalogState::GetFacts() const {
+  return facts_;
+}
+
+const std::vector<ActionSet>& DatalogState::GetLegalActions() const {
+  return legal_actions_;
+}
+
+StateSp DatalogState::GetNextState(const JointAction& joint_action) const {
+  const auto database = evaluator_->EvaluateJointAction(database_, joint_action);
+  auto next_joint_action_history = joint_action_history_;
+  next_joint_action_history.push_back(joint_action);
+  return std::make_shared<DatalogState>(
+      evaluator_,
+      evaluator_->GetNextFacts(*database),
+      next_joint_action_history);
+}
+
+bool DatalogState::IsTerminal() const {
+  return is_terminal_;
+}
+
+const std::vector<int>& DatalogState::GetGoals() const {
+  assert(is_terminal_);
+  return goals_;
+}
+
+std::vector<int> DatalogState::Simulate() const {
+  auto& random_engine = GetRandomEngine();
+  auto database = database_;
+  JointAction joint_action(evaluator_->GetGame()->roles.size());
+  while (!evaluator_->IsTerminal(*database)) {
+    const auto legal_actions = evaluator_->GetLegalActions(*database);
+    for (auto role_idx = 0; role_idx < static_cast<int>(legal_actions.size()); ++role_idx) {
+      const auto& actions = legal_actions[role_idx];
+      if (actions.empty()) {
+        throw std::runtime_error("Every role must always have at least one legal action.");
+      }
+      std::uniform_int_distribution<int> dist(0, actions.size() - 1);
+      joint_action[role_idx] = actions[dist(random_engine)];
+    }
+    const auto next_facts = evaluator_->GetNextFacts(*evaluator_->EvaluateJointAction(database, joint_action));
+    database = evaluator_->EvaluateState(next_facts);
+  }
+  return evaluator_->GetGoals(*database);
+}
+
+const std::vector<JointAction>& DatalogState::GetJointActionHistory() const {
+  return joint_action_history_;
+}
+
+std::string DatalogState::ToString() const {
+  std::ostringstream o;
+  for (const auto& fact : facts_) {
+    o << evaluator_->GetGame()->TupleToString(fact) << std::endl;
+  }
+  return o.str();
+}
+
+std::vector<sexpr_parser::TreeNode> MaterializeStaticRelations(
+    const std::vector<sexpr_parser::TreeNode>& nodes,
+    const long long max_step_count) {
+  const sexpr_parser::RuleGraph graph(nodes);
+  const auto dynamic_relations = graph.CollectDependents({"true", "does"});
+  std::unordered_set<std::string> static_relations;
+  for (const auto& node : nodes) {
+    if (node.IsImplication()) {
+      const auto& relation = node.GetChildren().at(1).GetFunctor();
+      if (!dynamic_relations.count(relation)) {
+        static_relations.insert(relation);
+      }
+    }
+  }
+  const auto has_non_ground_fact = std::any_of(nodes.begin(), nodes.end(), [](const sexpr_parser::TreeNode& node) {
+    std::unordered_set<std::string> variables;
+    node.CollectVariables(std::unordered_set<std::string>(), variables);
+    return !node.IsImplication() && !variables.empty();
+  });
+  if (static_relations.empty() || has_non_ground_fact) {
+    // Non-ground facts cannot be stored in tables
+    return nodes;
+  }
+
+  // Atoms only used for the evaluation
+  GameData game;
+  auto atom = kFirstMaterializedAtom;
+  for (const auto& atom_str : sexpr_parser::CollectAtoms(nodes)) {
+    game.atom_to_string.insert(AtomAndString(atom++, atom_str));
+  }
+  game.atom_to_string.insert(AtomAndString(atoms::kLeftParen, "("));
+  game.atom_to_string.insert(AtomAndString(atoms::kRightParen, ")"));
+  std::unordered_set<Atom> exact_relations;
+  for (const auto& entry : game.atom_to_string.left) {
+    exact_relations.insert(entry.first);
+  }
+
+  const auto rules = BuildRules(nodes, game);
+  std::vector<const Rule*> static_rules;
+  for (const auto& rule : rules) {
+    if (!dynamic_relations.count(game.AtomToString(rule.head.front()))) {
+      static_rules.push_back(&rule);
+    }
+  }
+  Database database;
+  try {
+    Budget budget(max_step_count);
+    auto insert = [&](const Tuple& tuple, std::unordered_set<Atom>& changed) {
+      Insert(tuple, database, changed);
+    };
+    for (const auto& stratum : Stratify(static_rules, graph, game)) {
+      Saturate(stratum, database, exact_relations, budget, insert);
+    }
+  } catch (const std::runtime_error& e) {
+    std::cout << "Note: static relations are not materialized: " << e.what() << std::endl;
+    return nodes;
+  }
+
+  std::vector<sexpr_parser::TreeNode> materialized_nodes;
+  std::unordered_set<std::string> materialized_relations;
+  for (const auto& node : nodes) {
+    const auto& relation = node.IsImplication() ? node.GetChildren().at(1).GetFunctor() : node.GetFunctor();
+    if (!static_relations.count(relation)) {
+      materialized_nodes.push_back(node);
+      continue;
+    }
+    if (!materialized_relations.insert(relation).second) {
+      continue;
+    }
+    // Facts of a relation replace its first fact or rule
+    const auto table = database.Find(game.StringToAtom(relation));
+    if (!table) {
+      continue;
+    }
+    for (const auto& tuple : table->tuples) {
+      materialized_nodes.push_back(sexpr_parser::ParseKIF(game.TupleToString(tuple)).front());
+    }
+  }
+  // Relations which derive no facts are no longer defined
+  return sexpr_parser::RemoveRulesOfEmptyRelations(materialized_nodes);
+}
+
+EvaluatorSp CreateEvaluator(const GameDataCsp& game) {
+  return std::make_shared<Evaluator>(game, game->nodes);
+}
+
+StateSp CreateInitialState(const EvaluatorSp& evaluator) {
+  return std::make_shared<DatalogState>(
+      evaluator,
+      evaluator->GetGame()->initial_facts,
+      std::vector<JointAction>());
+}
+
+StateSp CreateState(const EvaluatorSp& evaluator, const FactSet& facts) {
+  return std::make_shared<DatalogState>(evaluator, facts, std::vector<JointAction>());
+}
+
+}
+}
@@ -0,0 +1,145 @@
+#ifndef DATALOG_ENGINE_HPP_
+#define DATALOG_ENGINE_HPP_
+
+#include "ggpe.hpp"
+#include "state.hpp"
+#include "game_data.hpp"
+#include "datalog.hpp"
+
+namespace ggpe {
+namespace datalog {
+
+/**
+ * Bottom-up evaluator of the rules of a game as stratified Datalog.
+ *
+ * Relations are split into three phases: static ones (which depend on neither
+ * 'true' nor 'does') are evaluated once, state ones (which depend on 'true')
+ * for each state and joint action ones (which depend on 'does') for each
+ * joint action. The rules of each phase are evaluated stratum by stratum by
+ * semi-naive evaluation into a database layered on that of the previous
+ * phase.
+ *
+ * Frame axioms, i.e. 'next' rules which keep a fact of the current state
+ * under some conditions (e.g. (<= (next (cell ?m ?n ?w)) (true (cell ?m ?n ?w))
+ * (distinct ?w b))), are not evaluated as rules. Instead, the facts of the
+ * current state are copied unless the joint action and the negative literals
+ * of the frame axioms touch them.
+ *
+ * An evaluator is immutable once constructed, thus it can be shared by
+ * threads without lock.
+ */
+class Evaluator {
+public:
+  /**
+   * @param detects_frame_axioms false to evaluate frame axioms as ordinary
+   * rules, e.g. to check the facts kept by them
+   */
+  Evaluator(
+      const GameDataCsp& game,
+      const std::vector<sexpr_parser::TreeNode>& nodes,
+      const bool detects_frame_axioms=true);
+  Evaluator(const Evaluator&) = delete;
+  Evaluator& operator=(const Evaluator&) = delete;
+
+  const GameDataCsp& GetGame() const;
+  /**
+   * Evaluate the relations of the state phase for given facts
+   */
+  DatabaseCsp EvaluateState(const FactSet& facts) const;
+  /**
+   * Evaluate the relations of the joint action phase for a given joint action
+   */
+  DatabaseCsp EvaluateJointAction(const DatabaseCsp& state_database, const JointAction& joint_action) const;
+  /**
+   * @return facts derived by 'next' rules and facts kept by frame axioms
+   */
+  FactSet GetNextFacts(const Database& database) const;
+  std::vector<ActionSet> GetLegalActions(const Database& database) const;
+  bool IsTerminal(const Database& database) const;
+  std::vector<int> GetGoals(const Database& database) const;
+
+private:
+  /**
+   * (<= (next P) (true P) (does R A)* (not N)* (distinct X Y)*)
+   */
+  struct FrameAxiom {
+    const Rule* rule;
+    // Index of (true P) in the positive literals of the rule
+    int true_literal_idx;
+    // Rule whose positive literals are the 'does' literals of the frame axiom
+    Rule does_rule;
+  };
+  void DetectFrameAxioms(std::vector<const Rule*>& rules);
+  void KeepFacts(const Database& database, const FrameAxiom& frame_axiom, FactSet& facts,
+      std::unordered_set<Fact, boost::hash<Fact>>& fact_set) const;
+  void Evaluate(const std::vector<std::vector<const Rule*>>& strata, Database& database) const;
+
+  GameDataCsp game_;
+  std::vector<Rule> rules_;
+  // Every relation is exact since strata are evaluated in order
+  std::unordered_set<Atom> exact_relations_;
+  DatabaseCsp static_database_;
+  std::vector<std::vector<const Rule*>> state_strata_;
+  std::vector<std::vector<const Rule*>> joint_action_strata_;
+  std::vector<FrameAxiom> frame_axioms_;
+  Atom true_atom_;
+  Atom does_atom_;
+  Atom next_atom_;
+  Atom legal_atom_;
+  Atom goal_atom_;
+  Atom terminal_atom_;
+};
+
+using EvaluatorSp = std::shared_ptr<const Evaluator>;
+
+class DatalogState : public State {
+public:
+  DatalogState(
+      const EvaluatorSp& evaluator,
+      const FactSet& facts,
+      const std::vector<JointAction>& joint_action_history);
+  const FactSet& GetFacts() const override;
+  const std::vector<ActionSet>& GetLegalActions() const override;
+  StateSp GetNextState(const JointAction& joint_action) const override;
+  bool IsTerminal() const override;
+  const std::vector<int>& GetGoals() const override;
+  std::vector<int> Simulate() const override;
+  const std::vector<JointAction>& GetJointActionHistory() const override;
+  std::string ToString() const override;
+private:
+  EvaluatorSp evaluator_;
+  FactSet facts_;
+  DatabaseCsp database_;
+  std::vector<ActionSet> legal_actions_;
+  bool is_terminal_;
+  std::vector<int> goals_;
+  std::vector<JointAction> joint_action_history_;
+};
+
+/**
+ * Evaluate static relations derived by rules, i.e. those which depend on
+ * neither 'true' nor 'does', and replace their rules by the derived facts, so
+ * that backends look them up instead of deriving them on every query. Rules
+ * using a relation which derives no facts are removed as well (see
+ * sexpr_parser::RemoveRulesOfEmptyRelations), since YAP and GDLCC cannot
+ * call undefined relations.
+ * @return nodes whose static rules are replaced by facts, or given nodes if
+ * the evaluation takes more than given steps
+ */
+std::vector<sexpr_parser::TreeNode> MaterializeStaticRelations(
+    const std::vector<sexpr_parser::TreeNode>& nodes,
+    const long long max_step_count = 10000000);
+
+/**
+ * Compile the rules of a given game and evaluate its static relations
+ */
+EvaluatorSp CreateEvaluator(const GameDataCsp& game);
+
+StateSp CreateInitialState(const EvaluatorSp& evaluator);
+
+StateSp CreateState(const EvaluatorSp& evaluator, const FactSet& facts);
+
+}
+}
+
+#endif /* DATALOG_ENGINE_HPP_ */
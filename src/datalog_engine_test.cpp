@@ -0,0 +1,194 @@
+#include "gtest/gtest.h"
+#include "datalog_engine.hpp"
+
+#include <algorithm>
+#include <random>
+#include <set>
+
+#include "file_utils.hpp"
+#include "gdl_codec.hpp"
+#include "optimizer.hpp"
+
+namespace ggpe {
+namespace datalog {
+
+namespace {
+
+/**
+ * Create game data from the original rules without YAP, whose atoms include
+ * those of the rewritten rules
+ */
+GameDataSp CreateGameData(const std::vector<sexpr_parser::TreeNode>& nodes) {
+  auto game = std::make_shared<GameData>();
+  const auto atom_strs = sexpr_parser::CollectAtoms(nodes);
+  for (const auto& atom_str : std::set<std::string>(atom_strs.begin(), atom_strs.end())) {
+    const auto atom = static_cast<Atom>(game->atom_to_string.size()) + 512;
+    game->atom_to_string.insert(AtomAndString(atom, atom_str));
+    if (std::all_of(atom_str.begin(), atom_str.end(), ::isdigit) && std::stoi(atom_str) <= 100) {
+      game->atom_to_goal_values.emplace(atom, std::stoi(atom_str));
+    }
+  }
+  game->atom_to_string.insert(AtomAndString(atoms::kLeftParen, "("));
+  game->atom_to_string.insert(AtomAndString(atoms::kRightParen, ")"));
+  for (const auto& node : nodes) {
+    if (node.IsLeaf()) {
+      continue;
+    }
+    const auto& children = node.GetChildren();
+    if (children.front().GetValue() == "role") {
+      const auto role = game->StringToAtom(children.at(1).GetValue());
+      game->atom_to_role_index.emplace(role, game->roles.size());
+      game->role_indices.push_back(game->roles.size());
+      game->roles.push_back(role);
+    } else if (children.front().GetValue() == "init") {
+      const auto str = children.at(1).ToSexpr();
+      game->initial_facts.push_back(codec::ParseTuple(*game, str.data(), str.data() + str.size()));
+    }
+  }
+  game->possible_actions.resize(game->roles.size());
+  return game;
+}
+
+template <class T>
+std::vector<T> Sorted(std::vector<T> values) {
+  std::sort(values.begin(), values.end());
+  return values;
+}
+
+}
+
+/**
+ * Every backend compiles the rewritten rules, thus the rewrite itself is
+ * checked against the original rules here
+ */
+TEST(MaterializeStaticRelations, PlaysAsOriginalRules) {
+  for (const auto& filename : {
+      "kif/tictactoe.kif", "kif/breakthrough.kif", "kif/chinesecheckers4.kif", "kif/pilgrimage.kif"}) {
+    const auto nodes = sexpr_parser::ParseKIF(file_utils::LoadStringFromFile(filename));
+    const auto game = CreateGameData(nodes);
+    const auto original = std::make_shared<Evaluator>(game, nodes);
+    const auto rewritten = std::make_shared<Evaluator>(
+        game, sexpr_parser::Optimize(MaterializeStaticRelations(nodes)));
+    std::mt19937 random_engine(1);
+    for (auto playout = 0; playout < 3; ++playout) {
+      auto original_state = CreateInitialState(original);
+      auto rewritten_state = CreateInitialState(rewritten);
+      while (true) {
+        ASSERT_EQ(Sorted(original_state->GetFacts()), Sorted(rewritten_state->GetFacts())) << filename;
+        ASSERT_EQ(original_state->IsTerminal(), rewritten_state->IsTerminal()) << filename;
+        if (original_state->IsTerminal()) {
+          ASSERT_EQ(original_state->GetGoals(), rewritten_state->GetGoals()) << filename;
+          break;
+        }
+        JointAction joint_action;
+        for (const auto role_idx : game->role_indices) {
+          const auto legal_actions = Sorted(original_state->GetLegalActions().at(role_idx));
+          ASSERT_EQ(legal_actions, Sorted(rewritten_state->GetLegalActions().at(role_idx))) << filename;
+          joint_action.push_back(legal_actions.at(random_engine() % legal_actions.size()));
+        }
+        original_state = original_state->GetNextState(joint_action);
+        rewritten_state = rewritten_state->GetNextState(joint_action);
+      }
+    }
+  }
+}
+
+/**
+ * Facts kept by frame axioms must be those derived by evaluating the frame
+ * axioms as ordinary rules
+ */
+TEST(Evaluator, FrameAxioms) {
+  const auto nodes = sexpr_parser::ParseKIF(
+      "(role p) (role q) "
+      "(index 1) (index 2) (index 3) "
+      "(succ 0 1) (succ 1 2) (succ 2 3) "
+      "(init (cell 1 b)) (init (cell 2 b)) (init (cell 3 b)) "
+      "(init (owner p 1)) (init (owner q 2)) "
+      "(init (ready p)) (init (ready q)) "
+      "(init (step 0)) "
+      "(<= (legal p (mark ?x)) (true (cell ?x b))) "
+      "(<= (legal ?r noop) (role ?r)) "
+      "(<= (legal q (take ?x)) (index ?x)) "
+      "(<= (taken ?x) (does q (take ?x))) "
+      // Bound by 'does' and checked by 'distinct'
+      "(<= (next (cell ?x ?m)) (true (cell ?x ?m)) (does p (mark ?y)) (distinct ?x ?y)) "
+      "(<= (next (cell ?x ?m)) (true (cell ?x ?m)) (does p noop)) "
+      "(<= (next (cell ?x x)) (does p (mark ?x))) "
+      // Checked by negation
+      "(<= (next (owner ?r ?x)) (true (owner ?r ?x)) (not (taken ?x))) "
+      "(<= (next (owner q ?x)) (does q (take ?x))) "
+      // The role is bound by 'does'
+      "(<= (next (ready ?r)) (true (ready ?r)) (does ?r noop)) "
+      "(<= (next (step ?y)) (true (step ?x)) (succ ?x ?y)) "
+      "(<= terminal (true (step 3))) "
+      "(<= (goal ?r 100) (role ?r))");
+  const auto game = CreateGameData(nodes);
+  const auto evaluator = std::make_shared<Evaluator>(game, nodes);
+  const auto rule_evaluator = std::make_shared<Evaluator>(game, nodes, false);
+  // Every joint action is tried from every reachable state
+  std::vector<StateSp> states({CreateInitialState(evaluator)});
+  while (!states.empty()) {
+    const auto state = states.back();
+    states.pop_back();
+    const auto rule_state = CreateState(rule_evaluator, state->GetFacts());
+    ASSERT_EQ(state->IsTerminal(), rule_state->IsTerminal());
+    if (state->IsTerminal()) {
+      continue;
+    }
+    const auto& p_actions = state->GetLegalActions().at(0);
+    const auto& q_actions = state->GetLegalActions().at(1);
+    for (const auto& p_action : p_actions) {
+      for (const auto& q_action : q_actions) {
+        const JointAction joint_action({p_action, q_action});
+        const auto next_state = state->GetNextState(joint_action);
+        ASSERT_EQ(Sorted(next_state->GetFacts()), Sorted(rule_state->GetNextState(joint_action)->GetFacts()));
+        states.push_back(next_state);
+      }
+    }
+  }
+}
+
+TEST(MaterializeStaticRelations, Test) {
+  const auto nodes = sexpr_parser::Parse(
+      "(role p) (succ 1 2) (succ 2 3) "
+      "(<= (less ?x ?y) (succ ?x ?y)) "
+      "(<= (less ?x ?z) (succ ?x ?y) (less ?y ?z)) "
+      "(<= (legal p (move ?x)) (true (step ?y)) (less ?y ?x))");
+  // 'less' is replaced by its facts while 'legal' depends on 'true'
+  const auto answer = sexpr_parser::Parse(
+      "(role p) (succ 1 2) (succ 2 3) "
+      "(less 1 2) (less 2 3) (less 1 3) "
+      "(<= (legal p (move ?x)) (true (step ?y)) (less ?y ?x))");
+  const auto materialized_nodes = MaterializeStaticRelations(nodes);
+  ASSERT_EQ(materialized_nodes.size(), answer.size());
+  ASSERT_TRUE(std::is_permutation(materialized_nodes.begin(), materialized_nodes.end(), answer.begin()));
+
+  const auto nodes_with_empty_relations = sexpr_parser::Parse(
+      "(role p) (succ 1 2) "
+      "(<= (a ?x) (succ ?x 9)) "
+      "(<= (b ?x) (succ ?x ?y) (a ?y)) "
+      "(<= terminal (true (s ?x)) (b ?x)) "
+      "(<= (goal p 100) (true (s ?x)) (not (b ?x)))");
+  // 'a' and 'b' derive no facts, thus no rule may call them
+  const auto answer_without_empty_relations = sexpr_parser::Parse(
+      "(role p) (succ 1 2) "
+      "(<= (goal p 100) (true (s ?x)))");
+  const auto materialized_nodes_without_empty_relations =
+      MaterializeStaticRelations(nodes_with_empty_relations);
+  ASSERT_EQ(materialized_nodes_without_empty_relations, answer_without_empty_relations);
+  const auto program = sexpr_parser::ToProlog(materialized_nodes_without_empty_relations, true);
+  ASSERT_EQ(program.find("'a'("), std::string::npos);
+  ASSERT_EQ(program.find("'b'("), std::string::npos);
+}
+
+TEST(MaterializeStaticRelations, Budget) {
+  const auto nodes = sexpr_parser::Parse(
+      "(succ 1 2) (succ 2 3) "
+      "(<= (less ?x ?y) (succ ?x ?y)) "
+      "(<= (less ?x ?z) (succ ?x ?y) (less ?y ?z))");
+  // Given nodes are kept when the evaluation exceeds the budget
+  ASSERT_EQ(MaterializeStaticRelations(nodes, 1), nodes);
+}
+
+}
+}
@@ -9,16 +9,84 @@
 #define FILE_UTILS_HPP_
 
 #include <fstream>
+#include <iterator>
 #include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace file_utils {
 
+/**
+ * Read-only memory mapping of a whole file, whose pages are loaded on demand
+ * and can be dropped by the OS, e.g. for reading an analysis bundle in place.
+ */
+class MappedFile {
+public:
+  explicit MappedFile(const std::string& filename) :
+      data_(nullptr), size_(0) {
+    const auto fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("File '" + filename + "' does not exists.");
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+      close(fd);
+      throw std::runtime_error("File '" + filename + "' cannot be read.");
+    }
+    if (!S_ISREG(st.st_mode)) {
+      close(fd);
+      throw std::runtime_error("File '" + filename + "' is not a regular file.");
+    }
+    size_ = st.st_size;
+    if (size_ > 0) {
+      const auto data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+        close(fd);
+        throw std::runtime_error("File '" + filename + "' cannot be mapped.");
+      }
+      // Files are usually parsed from the beginning to the end
+      madvise(data, size_, MADV_SEQUENTIAL);
+      data_ = static_cast<const char*>(data);
+    }
+    // The mapping remains after the descriptor is closed
+    close(fd);
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() {
+    if (data_) {
+      munmap(const_cast<char*>(data_), size_);
+    }
+  }
+
+  const char* begin() const {
+    return data_;
+  }
+  const char* end() const {
+    return data_ + size_;
+  }
+  std::size_t size() const {
+    return size_;
+  }
+
+private:
+  const char* data_;
+  std::size_t size_;
+};
+
 inline std::string LoadStringFromFile(const std::string& filename) {
-  std::ifstream ifs(filename);
-  if (!ifs) {
-    throw std::runtime_error("File '" + filename + "' does not exists.");
+  struct stat st;
+  if (stat(filename.c_str(), &st) == 0 && !S_ISREG(st.st_mode)) {
+    // Pipes and devices cannot be mapped, and their size is unknown
+    std::ifstream ifs(filename);
+    return std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
   }
-  return std::string((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+  const MappedFile file(filename);
+  return std::string(file.begin(), file.end());
 }
 
 }
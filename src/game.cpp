@@ -0,0 +1,455 @@
+#include "game.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <stdexcept>
+
+#include <glog/logging.h>
+
+#include "sexpr_parser.hpp"
+#include "optimizer.hpp"
+#include "game_data.hpp"
+#include "gdl_codec.hpp"
+#include "yap_engine.hpp"
+#include "gdlcc_engine.hpp"
+#include "gdlcc_abi.hpp"
+#include "propnet_engine.hpp"
+#include "datalog_engine.hpp"
+#include "prettyprint.hpp"
+#include "initialization_report.hpp"
+
+namespace ggpe {
+
+namespace {
+
+GameSp default_game;
+
+gdlcc_abi::AtomTable CreateAtomTable(const GameData& game) {
+  gdlcc_abi::AtomTable atom_table;
+  atom_table.reserve(game.atom_to_string.size());
+  for (const auto& entry : game.atom_to_string.left) {
+    atom_table.emplace_back(entry.first, entry.second);
+  }
+  return atom_table;
+}
+
+void PrintThreadMode() {
+#ifndef GGPE_SINGLE_THREAD
+  std::cout << "Thread-safe mode." << std::endl;
+#else
+  std::cout << "Single-thread mode." << std::endl;
+#endif
+}
+
+}
+
+const std::string& GameData::AtomToString(const Atom atom) const {
+  return atom_to_string.left.at(atom);
+}
+
+Atom GameData::StringToAtom(const std::string& atom_str) const {
+  return atom_to_string.right.at(atom_str);
+}
+
+std::string GameData::TupleToString(const Tuple& tuple) const {
+  std::string str;
+  codec::AppendTuple(*this, tuple, str);
+  return str;
+}
+
+bool GameData::IsAnalyzed(const Analysis analysis) const {
+  return completed_analyses.test(static_cast<std::size_t>(analysis));
+}
+
+Game::Game(
+    std::string kif,
+    const std::string& name,
+    const EngineBackend backend,
+    const bool enables_tabling) :
+        data_(std::make_shared<GameData>()) {
+  assert(!kif.empty());
+  assert(!name.empty());
+  data_->kif = std::move(kif);
+  data_->name = name;
+  data_->enables_tabling = enables_tabling;
+  PrintThreadMode();
+
+  // Initialize yap engine
+  yap::InitializeYapEngine(data_);
+  std::cout << "Initialized yap engine." << std::endl;
+
+  auto& report = data_->initialization_report;
+
+  // Initialize gdlcc engine
+  if (backend == EngineBackend::GDLCC) {
+    try {
+      std::string converted_kif;
+      report.push_back(MeasurePhase("convert for gdlcc", [&]{
+        converted_kif = GetCompiledKif();
+      }));
+      report.push_back(MeasurePhase("compile gdlcc", [&]{
+        data_->gdlcc_library = gdlcc::LoadGameLibrary(
+            converted_kif, name, true, CreateAtomTable(*data_));
+      }));
+    } catch (std::exception& e) {
+      std::cerr << e.what() << std::endl;
+    }
+    if (data_->gdlcc_library && IsEngineValidWithReport("validate gdlcc")) {
+      std::cout << "Initialized gdlcc engine." << std::endl;
+    } else {
+      data_->gdlcc_library.reset();
+      std::cout << "Failed to initialize gdlcc engine." << std::endl;
+    }
+  }
+
+  // Initialize propnet engine
+  if (backend == EngineBackend::PROPNET) {
+    try {
+      report.push_back(MeasurePhase("create propnet", [&]{
+        propnet_ = propnet::CreatePropnet(data_);
+      }));
+    } catch (std::exception& e) {
+      std::cerr << e.what() << std::endl;
+    }
+    if (propnet_ && IsEngineValidWithReport("validate propnet")) {
+      std::cout << "Initialized propnet engine." << std::endl;
+    } else {
+      propnet_.reset();
+      std::cout << "Failed to initialize propnet engine." << std::endl;
+    }
+  }
+
+  // Initialize datalog engine
+  if (backend == EngineBackend::DATALOG) {
+    try {
+      report.push_back(MeasurePhase("create datalog evaluator", [&]{
+        datalog_ = datalog::CreateEvaluator(data_);
+      }));
+    } catch (std::exception& e) {
+      std::cerr << e.what() << std::endl;
+    }
+    if (datalog_ && IsEngineValidWithReport("validate datalog")) {
+      std::cout << "Initialized datalog engine." << std::endl;
+    } else {
+      datalog_.reset();
+      std::cout << "Failed to initialize datalog engine." << std::endl;
+    }
+  }
+  VLOG(1) << "Initialization report:\n" << InitializationReportToString(report);
+}
+
+Game::Game(
+    const std::string& kif,
+    const std::string& name,
+    const gdlcc_abi::StaticSymbols& symbols) :
+        data_(std::make_shared<GameData>()) {
+  assert(!kif.empty());
+  assert(!name.empty());
+  data_->kif = kif;
+  data_->name = name;
+  PrintThreadMode();
+
+  // Atom dictionary and analyses are still provided by yap engine
+  yap::InitializeYapEngine(data_);
+  std::cout << "Initialized yap engine." << std::endl;
+
+  try {
+    data_->gdlcc_library = gdlcc::GameLibrary::CreateStatic(symbols, CreateAtomTable(*data_));
+  } catch (std::exception& e) {
+    std::cerr << e.what() << std::endl;
+  }
+  if (data_->gdlcc_library && IsEngineValidWithReport("validate static gdlcc")) {
+    std::cout << "Initialized static gdlcc engine." << std::endl;
+  } else {
+    data_->gdlcc_library.reset();
+    std::cout << "Failed to initialize static gdlcc engine." << std::endl;
+  }
+  VLOG(1) << "Initialization report:\n" << InitializationReportToString(data_->initialization_report);
+}
+
+Game::~Game() {
+}
+
+bool Game::Analyze(const Analysis analysis, const boost::optional<Deadline>& deadline) const {
+  // Completion is checked under a lock of yap engine, since another thread
+  // can be running the analysis
+  return yap::Analyze(data_, analysis, deadline);
+}
+
+bool Game::IsEngineValidWithReport(const std::string& phase_name) const {
+  auto is_valid = false;
+  data_->initialization_report.push_back(MeasurePhase(phase_name, [&]{
+    is_valid = IsEngineValid();
+  }));
+  return is_valid;
+}
+
+bool Game::IsEngineValid() const {
+  assert(yap::IsBound(data_));
+  const auto& library = data_->gdlcc_library;
+  const std::string state_name = propnet_ ? "PropnetState" : datalog_ ? "DatalogState" : "CppState";
+  auto yap_state = yap::CreateInitialState(data_);
+  auto engine_state = CreateInitialState();
+  if (propnet_ || datalog_ || library->UsesBinaryABI()) {
+    // States created from facts must be the same as the original ones
+    auto created_facts = CreateState(yap_state->GetFacts())->GetFacts();
+    auto yap_facts = yap_state->GetFacts();
+    std::sort(created_facts.begin(), created_facts.end());
+    std::sort(yap_facts.begin(), yap_facts.end());
+    if (created_facts != yap_facts) {
+      std::cout << state_name << " created from facts differs from YapState." << std::endl;
+      return false;
+    }
+  }
+  while (!yap_state->IsTerminal()) {
+    if (engine_state->IsTerminal()) {
+      std::cout << "YapState is not terminal, but " << state_name << " is terminal." << std::endl;
+      std::cout << "YapState:\n" << yap_state->ToString();
+      std::cout << state_name << ":\n" << engine_state->ToString();
+      return false;
+    }
+    auto yap_facts = yap_state->GetFacts();
+    auto engine_facts = engine_state->GetFacts();
+    if (yap_facts.size() != engine_facts.size()) {
+      std::cout << "The number of facts in a state differs for YapState and " << state_name << "." << std::endl;
+      std::cout << "YapState:" << yap_state->GetFacts().size() << std::endl << yap_state->ToString();
+      std::cout << state_name << ":" << engine_state->GetFacts().size() << std::endl << engine_state->ToString();
+      return false;
+    }
+    std::sort(yap_facts.begin(), yap_facts.end());
+    std::sort(engine_facts.begin(), engine_facts.end());
+    if (yap_facts != engine_facts) {
+      std::cout << "The facts in a state differ for YapState and " << state_name << "." << std::endl;
+      std::cout << "yap_facts" << yap_facts << std::endl;
+      std::cout << "engine_facts" << engine_facts << std::endl;
+      std::cout << "YapState:" << std::endl;
+      std::cout << yap_state->ToString();
+      std::cout << state_name << ":" << std::endl;
+      std::cout << engine_state->ToString();
+      return false;
+    }
+    if (yap_state->GetLegalActions().size() != engine_state->GetLegalActions().size()) {
+      std::cout << "The number of legal actions in a state differs for YapState and " << state_name << "." << std::endl;
+      std::cout << "YapState:" << yap_state->GetLegalActions().size() << std::endl << yap_state->ToString();
+      std::cout << state_name << ":" << engine_state->GetLegalActions().size() << std::endl << engine_state->ToString();
+      return false;
+    }
+    JointAction joint_action;
+    for (auto role_idx : GetRoleIndices()) {
+      auto yap_actions = yap_state->GetLegalActions()[role_idx];
+      auto engine_actions = engine_state->GetLegalActions()[role_idx];
+      if (yap_actions.size() != engine_actions.size()) {
+        std::cout << "The number of legal actions for " << role_idx << " in a state differs for YapState and " << state_name << "." << std::endl;
+        std::cout << "YapState:" << yap_state->GetLegalActions()[role_idx].size() << std::endl << yap_state->ToString();
+        std::cout << state_name << ":" << engine_state->GetLegalActions()[role_idx].size() << std::endl << engine_state->ToString();
+        return false;
+      }
+      std::sort(yap_actions.begin(), yap_actions.end());
+      std::sort(engine_actions.begin(), engine_actions.end());
+      if (yap_actions != engine_actions) {
+        std::cout << "The legal actions for " << role_idx << " in a state differ for YapState and " << state_name << "." << std::endl;
+        std::cout << "YapState:\n" << yap_state->ToString();
+        std::cout << state_name << ":\n" << engine_state->ToString();
+        return false;
+      }
+      joint_action.push_back(yap_actions.front());
+    }
+    yap_state = yap_state->GetNextState(joint_action);
+    engine_state = engine_state->GetNextState(joint_action);
+  }
+  if (!yap_state->IsTerminal()) {
+    std::cout << "YapState is terminal, but " << state_name << " is not terminal." << std::endl;
+    std::cout << "YapState:\n" << yap_state->ToString();
+    std::cout << state_name << ":\n" << engine_state->ToString();
+    return false;
+  }
+  if (yap_state->GetGoals() != engine_state->GetGoals()) {
+    std::cout << "The goal value in a state differs for YapState and " << state_name << "." << std::endl;
+    std::cout << "YapState:\n" << yap_state->ToString();
+    std::cout << state_name << ":\n" << engine_state->ToString();
+    return false;
+  }
+  std::cout << state_name << " is valid." << std::endl;
+  return true;
+}
+
+const std::string& Game::GetName() const {
+  return data_->name;
+}
+
+const std::string& Game::GetKif() const {
+  return data_->kif;
+}
+
+std::string Game::GetCompiledKif() const {
+  return sexpr_parser::ToKIF(data_->nodes);
+}
+
+bool Game::EnablesTabling() const {
+  return data_->enables_tabling;
+}
+
+int Game::GetRoleCount() const {
+  return data_->roles.size();
+}
+
+const std::vector<int>& Game::GetRoleIndices() const {
+  return data_->role_indices;
+}
+
+bool Game::IsValidRoleIndex(const int role_idx) const {
+  const auto& role_indices = data_->role_indices;
+  return std::find(role_indices.begin(), role_indices.end(), role_idx) != role_indices.end();
+}
+
+std::string Game::RoleIndexToString(const int role_index) const {
+  return AtomToString(data_->roles[role_index]);
+}
+
+int Game::StringToRoleIndex(const std::string& role_str) const {
+  return data_->atom_to_role_index.at(StringToAtom(role_str));
+}
+
+Tuple Game::StringToTuple(const std::string& str) const {
+  return codec::ParseTuple(*data_, str.data(), str.data() + str.size());
+}
+
+std::string Game::TupleToString(const Tuple& tuple) const {
+  return data_->TupleToString(tuple);
+}
+
+Atom Game::StringToAtom(const std::string& str) const {
+  return data_->StringToAtom(str);
+}
+
+const std::string& Game::AtomToString(const Atom atom) const {
+  return data_->AtomToString(atom);
+}
+
+const FactSet& Game::GetPossibleFacts() const {
+  return data_->possible_facts;
+}
+
+const std::vector<ActionSet>& Game::GetPossibleActions() const {
+  return data_->possible_actions;
+}
+
+std::string Game::JointActionToString(const JointAction& joint_action) const {
+  assert(joint_action.size() == data_->roles.size());
+  std::string str;
+  codec::AppendJointAction(*data_, joint_action, str);
+  return str;
+}
+
+void Game::AppendTupleString(const Tuple& tuple, std::string& buffer) const {
+  codec::AppendTuple(*data_, tuple, buffer);
+}
+
+ServerMessage Game::ParseServerMessage(const std::string& message) const {
+  return codec::ParseServerMessage(message.data(), message.data() + message.size(), data_.get());
+}
+
+std::unordered_set<Atom> Game::GetStepCounters(const boost::optional<Deadline>& deadline) const {
+  // Results of an analysis which has not completed can be being written
+  if (!Analyze(Analysis::STEP_COUNTERS, deadline)) {
+    return {};
+  }
+  return data_->step_counter_atoms;
+}
+
+std::unordered_map<AtomPair, std::vector<std::pair<Atom, std::pair<int, int>>>, boost::hash<AtomPair>> Game::GetFactActionConnections(const boost::optional<Deadline>& deadline) const {
+  if (!Analyze(Analysis::FACT_ACTION_CONNECTIONS, deadline)) {
+    return {};
+  }
+  return data_->fact_action_connections;
+}
+
+std::unordered_map<Atom, std::unordered_map<Atom, int>> Game::GetOrderedDomains(const boost::optional<Deadline>& deadline) const {
+  if (!Analyze(Analysis::ORDERED_DOMAINS, deadline)) {
+    return {};
+  }
+  return data_->atom_to_ordered_domain;
+}
+
+StateSp Game::CreateInitialState() const {
+  if (propnet_) {
+    return propnet::CreateInitialState(propnet_);
+  } else if (datalog_) {
+    return datalog::CreateInitialState(datalog_);
+  } else if (data_->gdlcc_library) {
+    return data_->gdlcc_library->CreateInitialState();
+  } else {
+    return yap::CreateInitialState(data_);
+  }
+}
+
+StateSp Game::CreateState(const FactSet& facts) const {
+  if (propnet_) {
+    return propnet::CreateState(propnet_, facts);
+  }
+  if (datalog_) {
+    return datalog::CreateState(datalog_, facts);
+  }
+  if (data_->gdlcc_library) {
+    // A YapState would not be a state of this backend, thus it is not
+    // returned instead
+    if (!data_->gdlcc_library->UsesBinaryABI()) {
+      throw std::runtime_error("GDLCC library without the binary interface cannot create states from facts.");
+    }
+    return data_->gdlcc_library->CreateState(facts);
+  }
+  return yap::CreateState(data_, facts);
+}
+
+EngineBackend Game::GetEngineBackend() const {
+  if (propnet_) {
+    return EngineBackend::PROPNET;
+  } else if (datalog_) {
+    return EngineBackend::DATALOG;
+  } else if (data_->gdlcc_library) {
+    return EngineBackend::GDLCC;
+  } else {
+    return EngineBackend::YAP;
+  }
+}
+
+std::vector<int> Game::GetPartialGoals(const StateSp& state) const {
+  if (!Analyze(Analysis::WIN_CONDITIONS, boost::none)) {
+    return std::vector<int>(GetRoleCount(), 0);
+  }
+  return yap::GetPartialGoals(data_, state);
+}
+
+std::vector<NextCondition> Game::DetectNextConditions(const Fact& fact) const {
+  return yap::DetectNextConditions(data_, fact);
+}
+
+std::vector<std::vector<FactSet>> Game::GetWinConditions(const boost::optional<Deadline>& deadline) const {
+  if (!Analyze(Analysis::WIN_CONDITIONS, deadline)) {
+    return std::vector<std::vector<FactSet>>(GetRoleCount());
+  }
+  return data_->win_conditions;
+}
+
+void Game::RunAnalyses(const boost::optional<Deadline>& deadline) const {
+  yap::RunAnalyses(data_, deadline);
+}
+
+const InitializationReport& Game::GetInitializationReport() const {
+  return data_->initialization_report;
+}
+
+bool Game::IsBoundToYap() const {
+  return yap::IsBound(data_);
+}
+
+const GameSp& GetDefaultGame() {
+  return default_game;
+}
+
+void SetDefaultGame(const GameSp& game) {
+  default_game = game;
+}
+
+}
@@ -0,0 +1,91 @@
+#ifndef GAME_DATA_HPP_
+#define GAME_DATA_HPP_
+
+#include <bitset>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+#include <boost/bimap/bimap.hpp>
+#include <boost/bimap/unordered_set_of.hpp>
+
+#include "ggpe.hpp"
+#include "gdlcc_engine.hpp"
+#include "sexpr_parser.hpp"
+
+namespace ggpe {
+
+template <class K, class V>
+using UnorderedBimap = boost::bimaps::bimap<boost::bimaps::unordered_set_of<K>, boost::bimaps::unordered_set_of<V>>;
+using AtomAndString = UnorderedBimap<Atom, std::string>::value_type;
+
+/**
+ * Analyses which are run lazily on the first call of their getters
+ */
+enum class Analysis {
+  ORDERED_DOMAINS,
+  STEP_COUNTERS,
+  FACT_ACTION_CONNECTIONS,
+  WIN_CONDITIONS,
+  COUNT,
+};
+
+/**
+ * Per-game data shared by a Game and its states.
+ * Filled by yap::InitializeYapEngine, read-only after that except for the
+ * results of lazy analyses.
+ */
+struct GameData {
+  std::string kif;
+  std::string name;
+  bool enables_tabling = false;
+  /**
+   * Rules of the game with static relations materialized into facts and
+   * optimized, which engine backends compile instead of parsing KIF again
+   */
+  std::vector<sexpr_parser::TreeNode> nodes;
+  /**
+   * Static relations tabled by YAP, chosen by profiling if tabling is enabled
+   */
+  std::unordered_set<std::string> tabled_relations;
+  UnorderedBimap<Atom, std::string> atom_to_string;
+  std::vector<Atom> roles;
+  std::vector<int> role_indices;
+  std::unordered_map<Atom, int> atom_to_role_index;
+  std::unordered_map<Atom, int> atom_to_goal_values;
+  std::vector<Tuple> initial_facts;
+  std::vector<Tuple> possible_facts;
+  std::vector<std::vector<Tuple>> possible_actions;
+  std::unordered_map<Atom, std::unordered_map<Atom, int>> atom_to_ordered_domain;
+  std::unordered_set<Atom> step_counter_atoms;
+  std::unordered_map<AtomPair, std::vector<std::pair<Atom, std::pair<int, int>>>, boost::hash<AtomPair>> fact_action_connections;
+  std::unordered_map<Atom, std::unordered_map<int, Atom>> fact_ordered_args;
+  std::unordered_map<Atom, std::unordered_map<int, Atom>> action_ordered_args;
+  std::vector<std::vector<FactSet>> win_conditions;
+  /**
+   * Lazy analyses which have completed, indexed by Analysis
+   */
+  std::bitset<static_cast<std::size_t>(Analysis::COUNT)> completed_analyses;
+  /**
+   * Wall time and memory of each phase of initialization and lazy analyses
+   */
+  InitializationReport initialization_report;
+  /**
+   * Compiled game library, or null if GDLCC engine is not used
+   */
+  gdlcc::GameLibrarySp gdlcc_library;
+
+  const std::string& AtomToString(const Atom atom) const;
+  Atom StringToAtom(const std::string& atom_str) const;
+  std::string TupleToString(const Tuple& tuple) const;
+  bool IsAnalyzed(const Analysis analysis) const;
+};
+
+using GameDataSp = std::shared_ptr<GameData>;
+using GameDataCsp = std::shared_ptr<const GameData>;
+
+}
+
+#endif /* GAME_DATA_HPP_ */
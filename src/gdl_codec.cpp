@@ -0,0 +1,291 @@
+#include "gdl_codec.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+namespace ggpe {
+namespace codec {
+
+namespace {
+
+bool IsSpace(const char c) {
+  return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+bool IsDelimiter(const char c) {
+  return IsSpace(c) || c == '(' || c == ')' || c == ';';
+}
+
+void ToLowerCase(std::string& str) {
+  std::transform(str.begin(), str.end(), str.begin(), [](const char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  });
+}
+
+/**
+ * Reader of tokens in a message, which skips white spaces and comments
+ */
+class Scanner {
+public:
+  Scanner(const char* begin, const char* end) : pos_(begin), end_(end) {
+  }
+
+  bool AtEnd() {
+    SkipSpaces();
+    return pos_ == end_;
+  }
+
+  /**
+   * @return the first character of the next token
+   */
+  char Peek() {
+    if (AtEnd()) {
+      throw std::runtime_error("Unexpected end of GDL term");
+    }
+    return *pos_;
+  }
+
+  void Expect(const char c) {
+    if (Peek() != c) {
+      throw std::runtime_error(std::string("Expected '") + c + "' in GDL term");
+    }
+    ++pos_;
+  }
+
+  /**
+   * Read an atom into a given buffer
+   */
+  void ReadAtom(std::string& atom) {
+    const auto c = Peek();
+    if (c == '(' || c == ')') {
+      throw std::runtime_error("Expected an atom in GDL term");
+    }
+    const auto atom_begin = pos_;
+    while (pos_ != end_ && !IsDelimiter(*pos_)) {
+      ++pos_;
+    }
+    atom.assign(atom_begin, pos_);
+  }
+
+  /**
+   * Skip a term and return its range
+   */
+  void SkipTerm(const char*& term_begin, const char*& term_end) {
+    const auto is_atom = Peek() != '(';
+    term_begin = pos_;
+    if (is_atom) {
+      std::string atom;
+      ReadAtom(atom);
+      term_end = pos_;
+      return;
+    }
+    auto depth = 0;
+    do {
+      if (pos_ == end_) {
+        throw std::runtime_error("Unbalanced left paren in GDL term");
+      }
+      if (*pos_ == ';') {
+        pos_ = std::find(pos_, end_, '\n');
+        continue;
+      }
+      if (*pos_ == '(') {
+        ++depth;
+      } else if (*pos_ == ')') {
+        --depth;
+      }
+      ++pos_;
+    } while (depth > 0);
+    term_end = pos_;
+  }
+
+private:
+  void SkipSpaces() {
+    while (pos_ != end_) {
+      if (*pos_ == ';') {
+        // A comment continues until the end of the line
+        pos_ = std::find(pos_, end_, '\n');
+      } else if (IsSpace(*pos_)) {
+        ++pos_;
+      } else {
+        break;
+      }
+    }
+  }
+
+  const char* pos_;
+  const char* end_;
+};
+
+Atom LookUpAtom(const GameData& game, std::string& atom) {
+  const auto it = game.atom_to_string.right.find(atom);
+  if (it != game.atom_to_string.right.end()) {
+    return it->second;
+  }
+  // Reserved words are stored in lower cases
+  ToLowerCase(atom);
+  return game.StringToAtom(atom);
+}
+
+/**
+ * Parse a term and append it to a tuple
+ * @param nested whether the term is inside a compound term
+ * @param atom buffer reused for reading atoms
+ */
+void ParseTerm(
+    Scanner& scanner,
+    const GameData& game,
+    const bool nested,
+    std::string& atom,
+    Tuple& tuple) {
+  if (scanner.Peek() != '(') {
+    scanner.ReadAtom(atom);
+    tuple.push_back(LookUpAtom(game, atom));
+    return;
+  }
+  scanner.Expect('(');
+  const auto first = tuple.size();
+  if (nested) {
+    tuple.push_back(atoms::kLeftParen);
+  }
+  auto element_count = 0;
+  while (scanner.Peek() != ')') {
+    ParseTerm(scanner, game, true, atom, tuple);
+    ++element_count;
+  }
+  scanner.Expect(')');
+  if (element_count == 0) {
+    throw std::runtime_error("Empty compound term in GDL term");
+  }
+  if (element_count == 1) {
+    // A term between redundant parens is read as the term itself
+    if (nested) {
+      tuple.erase(tuple.begin() + first);
+    } else if (tuple[first] == atoms::kLeftParen) {
+      tuple.erase(tuple.begin() + first);
+      tuple.pop_back();
+    }
+    return;
+  }
+  if (tuple[first + (nested ? 1 : 0)] == atoms::kLeftParen) {
+    throw std::runtime_error("Functor of compound term must be an atom");
+  }
+  if (nested) {
+    tuple.push_back(atoms::kRightParen);
+  }
+}
+
+JointAction ParseMoves(Scanner& scanner, const GameData* game, std::string& atom) {
+  JointAction joint_action;
+  if (scanner.Peek() != '(') {
+    scanner.ReadAtom(atom);
+    ToLowerCase(atom);
+    if (atom != "nil") {
+      throw std::runtime_error("Expected moves or NIL in GGP message");
+    }
+    return joint_action;
+  }
+  if (!game) {
+    throw std::runtime_error("Moves cannot be parsed without a game");
+  }
+  scanner.Expect('(');
+  while (scanner.Peek() != ')') {
+    Tuple action;
+    ParseTerm(scanner, *game, false, atom, action);
+    joint_action.push_back(std::move(action));
+  }
+  scanner.Expect(')');
+  if (joint_action.size() != game->roles.size()) {
+    throw std::runtime_error("The number of moves differs from that of roles");
+  }
+  return joint_action;
+}
+
+}
+
+Tuple ParseTuple(const GameData& game, const char* begin, const char* end) {
+  Scanner scanner(begin, end);
+  std::string atom;
+  Tuple tuple;
+  ParseTerm(scanner, game, false, atom, tuple);
+  if (!scanner.AtEnd()) {
+    throw std::runtime_error("Unexpected characters after GDL term");
+  }
+  return tuple;
+}
+
+ServerMessage ParseServerMessage(const char* begin, const char* end, const GameData* game) {
+  Scanner scanner(begin, end);
+  std::string token;
+  ServerMessage message;
+  scanner.Expect('(');
+  scanner.ReadAtom(token);
+  ToLowerCase(token);
+  if (token == "start") {
+    message.type = ServerMessage::Type::START;
+    scanner.ReadAtom(message.match_id);
+    scanner.ReadAtom(message.role);
+    const char* description_begin = nullptr;
+    const char* description_end = nullptr;
+    scanner.SkipTerm(description_begin, description_end);
+    if (*description_begin != '(') {
+      throw std::runtime_error("Expected game description in START message");
+    }
+    // Rules inside the parens
+    message.kif.assign(description_begin + 1, description_end - 1);
+    scanner.ReadAtom(token);
+    message.start_clock = std::stoi(token);
+    scanner.ReadAtom(token);
+    message.play_clock = std::stoi(token);
+  } else if (token == "play" || token == "stop") {
+    message.type = token == "play" ? ServerMessage::Type::PLAY : ServerMessage::Type::STOP;
+    scanner.ReadAtom(message.match_id);
+    message.joint_action = ParseMoves(scanner, game, token);
+  } else if (token == "abort") {
+    message.type = ServerMessage::Type::ABORT;
+    scanner.ReadAtom(message.match_id);
+  } else if (token == "info") {
+    message.type = ServerMessage::Type::INFO;
+  } else {
+    throw std::runtime_error("Unknown GGP message: " + token);
+  }
+  scanner.Expect(')');
+  return message;
+}
+
+void AppendTuple(const GameData& game, const Tuple& tuple, std::string& buffer) {
+  if (tuple.size() == 1) {
+    buffer += game.AtomToString(tuple.front());
+    return;
+  }
+  buffer += '(';
+  for (auto it = tuple.begin(); it != tuple.end(); ++it) {
+    if (*it == atoms::kRightParen) {
+      buffer += ')';
+      continue;
+    }
+    if (it != tuple.begin() && *(it - 1) != atoms::kLeftParen) {
+      buffer += ' ';
+    }
+    if (*it == atoms::kLeftParen) {
+      buffer += '(';
+    } else {
+      buffer += game.AtomToString(*it);
+    }
+  }
+  buffer += ')';
+}
+
+void AppendJointAction(const GameData& game, const JointAction& joint_action, std::string& buffer) {
+  buffer += '(';
+  for (auto it = joint_action.begin(); it != joint_action.end(); ++it) {
+    if (it != joint_action.begin()) {
+      buffer += ' ';
+    }
+    AppendTuple(game, *it, buffer);
+  }
+  buffer += ')';
+}
+
+}
+}
@@ -0,0 +1,41 @@
+#ifndef GDL_CODEC_HPP_
+#define GDL_CODEC_HPP_
+
+#include <string>
+
+#include "ggpe.hpp"
+#include "game_data.hpp"
+
+namespace ggpe {
+namespace codec {
+
+/**
+ * Parse a term of GDL directly into a tuple, without building a tree.
+ * Compound terms inside compound terms are put between parens as engine
+ * backends do, and a compound term without arguments is read as its functor.
+ * Throws std::runtime_error on malformed terms and std::out_of_range on
+ * unknown atoms.
+ */
+Tuple ParseTuple(const GameData& game, const char* begin, const char* end);
+
+/**
+ * Parse a message of GGP protocol. Moves of PLAY and STOP are converted into
+ * a joint action with atoms of a given game, which can be null for the other
+ * messages.
+ */
+ServerMessage ParseServerMessage(const char* begin, const char* end, const GameData* game);
+
+/**
+ * Append the string representation of a tuple to a buffer
+ */
+void AppendTuple(const GameData& game, const Tuple& tuple, std::string& buffer);
+
+/**
+ * Append the string representation of a joint action, e.g. "((mark 1 1) noop)"
+ */
+void AppendJointAction(const GameData& game, const JointAction& joint_action, std::string& buffer);
+
+}
+}
+
+#endif /* GDL_CODEC_HPP_ */
@@ -0,0 +1,89 @@
+#include "gtest/gtest.h"
+#include "gdl_codec.hpp"
+
+namespace ggpe {
+namespace codec {
+
+namespace {
+
+GameData CreateGameData() {
+  GameData game;
+  auto atom = 512;
+  for (const auto& str : {"white", "black", "move", "cell", "1", "2", "noop", "true"}) {
+    game.atom_to_string.insert(AtomAndString(atom++, str));
+  }
+  game.atom_to_string.insert(AtomAndString(atoms::kLeftParen, "("));
+  game.atom_to_string.insert(AtomAndString(atoms::kRightParen, ")"));
+  game.roles = {game.StringToAtom("white"), game.StringToAtom("black")};
+  return game;
+}
+
+Tuple Parse(const GameData& game, const std::string& str) {
+  return ParseTuple(game, str.data(), str.data() + str.size());
+}
+
+}
+
+TEST(ParseTuple, Test) {
+  const auto game = CreateGameData();
+  const auto move = game.StringToAtom("move");
+  const auto cell = game.StringToAtom("cell");
+  const auto one = game.StringToAtom("1");
+  const auto two = game.StringToAtom("2");
+  ASSERT_EQ(Parse(game, " noop "), Tuple({game.StringToAtom("noop")}));
+  ASSERT_EQ(Parse(game, "(noop)"), Tuple({game.StringToAtom("noop")}));
+  ASSERT_EQ(Parse(game, "(move 1 2)"), Tuple({move, one, two}));
+  ASSERT_EQ(Parse(game, "(TRUE 1)"), Tuple({game.StringToAtom("true"), one}));
+  ASSERT_EQ(
+      Parse(game, "(move (cell 1 2) (2))"),
+      Tuple({move, atoms::kLeftParen, cell, one, two, atoms::kRightParen, two}));
+  ASSERT_THROW(Parse(game, "(move 1"), std::runtime_error);
+  ASSERT_THROW(Parse(game, "(move 1) 2"), std::runtime_error);
+  ASSERT_THROW(Parse(game, "(unknown 1)"), std::out_of_range);
+}
+
+TEST(AppendTuple, Test) {
+  const auto game = CreateGameData();
+  std::string buffer;
+  for (const auto& str : {"noop", "(move 1 2)", "(move (cell 1 2) 2)"}) {
+    buffer.clear();
+    AppendTuple(game, Parse(game, str), buffer);
+    ASSERT_EQ(buffer, str);
+  }
+  buffer.clear();
+  AppendJointAction(game, {Parse(game, "(move 1 2)"), Parse(game, "noop")}, buffer);
+  ASSERT_EQ(buffer, "((move 1 2) noop)");
+}
+
+TEST(ParseServerMessage, Test) {
+  const auto game = CreateGameData();
+  const std::string start = "(START match.1 white ((role white) (role black)) 30 10)";
+  const auto start_message = ParseServerMessage(start.data(), start.data() + start.size(), nullptr);
+  ASSERT_EQ(start_message.type, ServerMessage::Type::START);
+  ASSERT_EQ(start_message.match_id, "match.1");
+  ASSERT_EQ(start_message.role, "white");
+  ASSERT_EQ(start_message.kif, "(role white) (role black)");
+  ASSERT_EQ(start_message.start_clock, 30);
+  ASSERT_EQ(start_message.play_clock, 10);
+
+  const std::string first_play = "(PLAY match.1 NIL)";
+  const auto first_play_message =
+      ParseServerMessage(first_play.data(), first_play.data() + first_play.size(), nullptr);
+  ASSERT_EQ(first_play_message.type, ServerMessage::Type::PLAY);
+  ASSERT_TRUE(first_play_message.joint_action.empty());
+
+  const std::string stop = "(STOP match.1 ((move 1 2) noop))";
+  const auto stop_message = ParseServerMessage(stop.data(), stop.data() + stop.size(), &game);
+  ASSERT_EQ(stop_message.type, ServerMessage::Type::STOP);
+  ASSERT_EQ(stop_message.joint_action, JointAction({Parse(game, "(move 1 2)"), Parse(game, "noop")}));
+  // Moves need atoms of the game
+  ASSERT_THROW(ParseServerMessage(stop.data(), stop.data() + stop.size(), nullptr), std::runtime_error);
+
+  const std::string abort = "(ABORT match.1)";
+  ASSERT_EQ(
+      ParseServerMessage(abort.data(), abort.data() + abort.size(), nullptr).type,
+      ServerMessage::Type::ABORT);
+}
+
+}
+}
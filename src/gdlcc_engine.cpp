@@ -8,6 +8,7 @@
 #include <boost/filesystem.hpp>
 #include "gdlcc_engine.hpp"
 #include "ggpe.hpp"
+#include "gdlcc_abi.hpp"
 
 namespace ggpe {
 
@@ -15,36 +16,22 @@ namespace gdlcc {
 
 namespace fs = boost::filesystem;
 
-// Types of function pointers
-typedef Tuple StrToTupleFunc(const std::string& str);
-typedef std::string TupleToStrFunc(const Tuple& tuple);
-typedef int StrToLiteralFunc(const std::string& str);
-typedef std::string LiteralToStrFunc(const int literal);
-typedef StateSp CreateInitialStateFunc();
-//typedef State_p CreateStateFunc(const vector<Tuple> facts);
-typedef int GetRoleCountFunc();
-
 namespace {
 
-// Loaded library
-void *lib;
-
-// Function pointers
-StrToTupleFunc* str_to_tuple_func;
-TupleToStrFunc* tuple_to_str_func;
-StrToLiteralFunc* str_to_literal_func;
-LiteralToStrFunc* literal_to_str_func;
-CreateInitialStateFunc* create_initial_state_func;
-//CreateStateFunc* create_state_func;
-GetRoleCountFunc* get_role_count_func;
-
+void *LoadFuncOrNull(void *lib, const std::string& func_name) {
+  dlerror();
+  void* func = dlsym(lib, func_name.c_str());
+  if (dlerror()) {
+    return nullptr;
+  }
+  return func;
+}
 
 void *LoadFuncOrDie(void *lib, const std::string& func_name) {
   void* func = dlsym(lib, func_name.c_str());
   const char* dlsym_error = dlerror();
   if (dlsym_error) {
     std::cerr << "Cannot load symbol create: " << dlsym_error << std::endl;
-    dlclose(lib);
     throw std::runtime_error("Failed to load a function from the shared library.");
   }
   assert(func);
@@ -52,7 +39,7 @@ void *LoadFuncOrDie(void *lib, const std::string& func_name) {
 }
 
 void *LoadLibOrDie(const std::string& path) {
-  void *lib = dlopen(path.c_str(), RTLD_NOW);
+  void *lib = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
   if (!lib) {
     std::cerr << "Cannot load library: " << dlerror() << std::endl;
     throw std::runtime_error("Failed to load a shared library.");
@@ -60,45 +47,6 @@ void *LoadLibOrDie(const std::string& path) {
   return lib;
 }
 
-void Link(const std::string& lib_path) {
-  // Link library
-  lib = LoadLibOrDie(lib_path);
-  // Load pointers to necessary functions
-  str_to_tuple_func = reinterpret_cast<StrToTupleFunc*>(LoadFuncOrDie(lib, "StrToTuple"));
-  tuple_to_str_func = reinterpret_cast<TupleToStrFunc*>(LoadFuncOrDie(lib, "TupleToStr"));
-  str_to_literal_func = reinterpret_cast<StrToLiteralFunc*>(LoadFuncOrDie(lib, "StrToLiteral"));
-  literal_to_str_func = reinterpret_cast<LiteralToStrFunc*>(LoadFuncOrDie(lib, "LiteralToStr"));
-  create_initial_state_func = reinterpret_cast<CreateInitialStateFunc*>(LoadFuncOrDie(lib, "CreateInitialState"));
-//  create_state_func = reinterpret_cast<CreateStateFunc*>(LoadFuncOrDie(lib, "CreateState"));
-}
-
-void Delink() {
-  dlclose(lib);
-  lib = nullptr;
-}
-
-Tuple StrToTuple(const std::string& str) {
-  return str_to_tuple_func(str);
-}
-
-std::string TupleToStr(const Tuple& tuple) {
-  return tuple_to_str_func(tuple);
-}
-
-int StrToLiteral(const std::string& str) {
-  return str_to_literal_func(str);
-}
-
-std::string LiteralToStr(const int literal) {
-  return literal_to_str_func(literal);
-}
-
-//
-//// Create a state with given facts
-//State_p CreateState(const vector<Tuple> facts) {
-//  return create_state_func(facts);
-//}
-
 void SaveKifFile(const std::string& kif_filename, const std::string& kif) {
   std::ofstream ofs(kif_filename);
   ofs << kif << std::flush;
@@ -152,58 +100,201 @@ void CompileCppIntoSharedLibrary(
 
 } // anonymous
 
-void InitializeGDLCCEngine(
+GameLibrary::GameLibrary() :
+    path_(),
+    handle_(nullptr),
+    str_to_tuple_func_(nullptr),
+    tuple_to_str_func_(nullptr),
+    str_to_literal_func_(nullptr),
+    literal_to_str_func_(nullptr),
+    create_initial_state_func_(nullptr),
+    create_state_func_(nullptr),
+    uses_binary_abi_(false) {
+}
+
+GameLibrary::~GameLibrary() {
+  if (handle_) {
+    dlclose(handle_);
+  }
+}
+
+GameLibrarySp GameLibrary::Load(
+    const std::string& lib_path,
+    const gdlcc_abi::AtomTable& atom_table) {
+  // Constructed before dlopen so that the handle is closed on exceptions
+  std::shared_ptr<GameLibrary> library(new GameLibrary());
+  library->path_ = lib_path;
+  library->handle_ = LoadLibOrDie(lib_path);
+  const auto handle = library->handle_;
+  library->create_initial_state_func_ =
+      reinterpret_cast<CreateInitialStateFunc*>(LoadFuncOrDie(handle, "CreateInitialState"));
+  const auto get_abi_version_func =
+      reinterpret_cast<gdlcc_abi::GetABIVersionFunc*>(LoadFuncOrNull(handle, "GetABIVersion"));
+  if (get_abi_version_func && get_abi_version_func() == gdlcc_abi::kVersion) {
+    // Binary interface: tuples are exchanged without text round trips
+    library->BindBinaryABI(
+        reinterpret_cast<gdlcc_abi::SetAtomTableFunc*>(LoadFuncOrDie(handle, "SetAtomTable")),
+        reinterpret_cast<gdlcc_abi::CreateStateFunc*>(LoadFuncOrDie(handle, "CreateState")),
+        atom_table);
+  } else {
+    // String interface
+    library->str_to_tuple_func_ =
+        reinterpret_cast<gdlcc_abi::StrToTupleFunc*>(LoadFuncOrDie(handle, "StrToTuple"));
+    library->tuple_to_str_func_ =
+        reinterpret_cast<gdlcc_abi::TupleToStrFunc*>(LoadFuncOrDie(handle, "TupleToStr"));
+    library->str_to_literal_func_ =
+        reinterpret_cast<gdlcc_abi::StrToLiteralFunc*>(LoadFuncOrDie(handle, "StrToLiteral"));
+    library->literal_to_str_func_ =
+        reinterpret_cast<gdlcc_abi::LiteralToStrFunc*>(LoadFuncOrDie(handle, "LiteralToStr"));
+  }
+  return library;
+}
+
+GameLibrarySp GameLibrary::CreateStatic(
+    const gdlcc_abi::StaticSymbols& symbols,
+    const gdlcc_abi::AtomTable& atom_table) {
+  assert(symbols.create_initial_state);
+  std::shared_ptr<GameLibrary> library(new GameLibrary());
+  library->create_initial_state_func_ = symbols.create_initial_state;
+  if (symbols.get_abi_version && symbols.get_abi_version() == gdlcc_abi::kVersion) {
+    if (!symbols.set_atom_table || !symbols.create_state) {
+      throw std::runtime_error("The static library lacks functions of the binary interface.");
+    }
+    library->BindBinaryABI(symbols.set_atom_table, symbols.create_state, atom_table);
+  }
+  return library;
+}
+
+void GameLibrary::BindBinaryABI(
+    gdlcc_abi::SetAtomTableFunc* set_atom_table_func,
+    gdlcc_abi::CreateStateFunc* create_state_func,
+    const gdlcc_abi::AtomTable& atom_table) {
+  assert(set_atom_table_func);
+  assert(create_state_func);
+  create_state_func_ = create_state_func;
+  uses_binary_abi_ = true;
+  // Otherwise tuples of the library are numbered by its own atoms
+  if (atom_table.empty()) {
+    throw std::runtime_error("A game library of the binary interface needs an atom table.");
+  }
+  if (!set_atom_table_func(atom_table)) {
+    throw std::runtime_error("The game library uses atoms unknown to ggpe.");
+  }
+}
+
+StateSp GameLibrary::Attach(const StateSp& state) const {
+  return std::make_shared<GameLibraryState>(shared_from_this(), state);
+}
+
+StateSp GameLibrary::CreateInitialState() const {
+  assert(create_initial_state_func_);
+  return Attach(create_initial_state_func_());
+}
+
+StateSp GameLibrary::CreateState(const FactSet& facts) const {
+  assert(create_state_func_);
+  return Attach(create_state_func_(facts));
+}
+
+bool GameLibrary::UsesBinaryABI() const {
+  return uses_binary_abi_;
+}
+
+const std::string& GameLibrary::GetPath() const {
+  return path_;
+}
+
+Tuple GameLibrary::StrToTuple(const std::string& str) const {
+  assert(str_to_tuple_func_);
+  return str_to_tuple_func_(str);
+}
+
+std::string GameLibrary::TupleToStr(const Tuple& tuple) const {
+  assert(tuple_to_str_func_);
+  return tuple_to_str_func_(tuple);
+}
+
+GameLibraryState::GameLibraryState(const GameLibrarySp& library, const StateSp& state) :
+    library_(library),
+    state_(state) {
+  assert(library_);
+  assert(state_);
+}
+
+const FactSet& GameLibraryState::GetFacts() const {
+  return state_->GetFacts();
+}
+
+const std::vector<ActionSet>& GameLibraryState::GetLegalActions() const {
+  return state_->GetLegalActions();
+}
+
+StateSp GameLibraryState::GetNextState(const JointAction& joint_action) const {
+  return std::make_shared<GameLibraryState>(library_, state_->GetNextState(joint_action));
+}
+
+bool GameLibraryState::IsTerminal() const {
+  return state_->IsTerminal();
+}
+
+const std::vector<int>& GameLibraryState::GetGoals() const {
+  return state_->GetGoals();
+}
+
+std::vector<int> GameLibraryState::Simulate() const {
+  return state_->Simulate();
+}
+
+const std::vector<JointAction>& GameLibraryState::GetJointActionHistory() const {
+  return state_->GetJointActionHistory();
+}
+
+std::string GameLibraryState::ToString() const {
+  return state_->ToString();
+}
+
+const GameLibrarySp& GameLibraryState::GetLibrary() const {
+  return library_;
+}
+
+GameLibrarySp LoadGameLibrary(
     const std::string& kif,
     const std::string& name,
-    const bool reuses_existing_lib) {
-  if (lib) {
-    Delink();
-  }
+    const bool reuses_existing_lib,
+    const gdlcc_abi::AtomTable& atom_table) {
   const auto tmp_dir = std::string("tmp/");
   const auto kif_filename = tmp_dir + name + ".kif";
   const auto cpp_filename = tmp_dir + name + ".cpp";
   const auto lib_filename = tmp_dir + name + ".so";
+  const auto version_filename = tmp_dir + name + ".version";
+  const auto version = std::to_string(gdlcc_abi::kHeaderVersion);
 
   // Reuse old shared library if available
   if (reuses_existing_lib &&
       fs::exists(fs::path(kif_filename)) &&
-      fs::exists(fs::path(lib_filename))) {
-    // Check if descriptions are completely the same
+      fs::exists(fs::path(lib_filename)) &&
+      fs::exists(fs::path(version_filename))) {
+    // Check if descriptions and headers are completely the same
     std::cout << "Old files exist." << std::endl;
     std::ifstream ifs(kif_filename);
     std::string old_kif((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
 //    std::cout << "Old KIF file: " << old_kif << std::endl;
-    if (kif == old_kif) {
+    std::ifstream version_ifs(version_filename);
+    std::string old_version;
+    version_ifs >> old_version;
+    if (kif == old_kif && version == old_version) {
       std::cout << "Reuse old shared library:" << lib_filename << std::endl;
-      gdlcc::Link(lib_filename);
-      return;
+      return GameLibrary::Load(lib_filename, atom_table);
     }
   }
+  fs::remove(fs::path(version_filename));
   SaveKifFile(kif_filename, kif);
   ConvertKifToCpp(kif_filename);
   CompileCppIntoSharedLibrary(cpp_filename, lib_filename);
-  gdlcc::Link(lib_filename);
-}
-
-bool InitializeGDLCCEngineOrFalse(
-    const std::string& kif,
-    const std::string& name,
-    const bool reuses_existing_lib) {
-  try {
-    InitializeGDLCCEngine(kif, name, true);
-    return true;
-  } catch (std::exception& e) {
-    std::cerr << e.what() << std::endl;
-    return false;
-  } catch (...) {
-    std::cerr << "some exception" << std::endl;
-    return false;
-  }
-}
-
-StateSp CreateInitialState() {
-  assert(create_initial_state_func);
-  return create_initial_state_func();
+  // The version is saved last, since a library without it is never reused
+  std::ofstream version_ofs(version_filename);
+  version_ofs << version << std::flush;
+  return GameLibrary::Load(lib_filename, atom_table);
 }
 
 } // gdlcc
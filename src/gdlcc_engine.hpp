@@ -2,27 +2,117 @@
 #define GDLCC_ENGINE_HPP_
 
 #include "ggpe.hpp"
+#include "gdlcc_abi.hpp"
 
 namespace ggpe {
 namespace gdlcc {
 
+class GameLibrary;
+using GameLibrarySp = std::shared_ptr<const GameLibrary>;
+
 /**
- * Initialize GDLCC Engine:
- * 1) Convert KIF -> C++
- * 2) Compile C++
- * 3) Load as a shared library
+ * A game compiled by GDLCC: owns its dlopen handle and symbol table.
+ * Several libraries can stay resident at the same time. A library is unloaded
+ * when neither its handle nor any of its states are referenced.
  */
-void InitializeGDLCCEngine(
-    const std::string& kif,
-    const std::string& name,
-    const bool reuses_existing_lib);
+class GameLibrary : public std::enable_shared_from_this<GameLibrary> {
+public:
+  /**
+   * Load a shared library. If it supports the binary interface, atom_table
+   * is passed to it so that it shares ggpe atoms, and std::runtime_error is
+   * thrown if atom_table is empty.
+   */
+  static GameLibrarySp Load(
+      const std::string& lib_path,
+      const gdlcc_abi::AtomTable& atom_table);
+  /**
+   * Wrap a game library linked at build time. If it supports the binary
+   * interface, atom_table is passed to it as in Load.
+   */
+  static GameLibrarySp CreateStatic(
+      const gdlcc_abi::StaticSymbols& symbols,
+      const gdlcc_abi::AtomTable& atom_table);
+  GameLibrary(const GameLibrary&) = delete;
+  GameLibrary& operator=(const GameLibrary&) = delete;
+  ~GameLibrary();
+  /**
+   * @return the initial state, which knows this library
+   */
+  StateSp CreateInitialState() const;
+  /**
+   * Create a state with a given set of facts (binary interface only)
+   */
+  StateSp CreateState(const FactSet& facts) const;
+  /**
+   * @return true iif this library supports the binary interface
+   */
+  bool UsesBinaryABI() const;
+  /**
+   * @return the path of the shared library (empty if linked statically)
+   */
+  const std::string& GetPath() const;
+  /**
+   * Convert: string representation -> tuple (string interface only)
+   */
+  Tuple StrToTuple(const std::string& str) const;
+  /**
+   * Convert: tuple -> string representation (string interface only)
+   */
+  std::string TupleToStr(const Tuple& tuple) const;
+private:
+  GameLibrary();
+  void BindBinaryABI(
+      gdlcc_abi::SetAtomTableFunc* set_atom_table_func,
+      gdlcc_abi::CreateStateFunc* create_state_func,
+      const gdlcc_abi::AtomTable& atom_table);
+  StateSp Attach(const StateSp& state) const;
+  std::string path_;
+  void* handle_;
+  gdlcc_abi::StrToTupleFunc* str_to_tuple_func_;
+  gdlcc_abi::TupleToStrFunc* tuple_to_str_func_;
+  gdlcc_abi::StrToLiteralFunc* str_to_literal_func_;
+  gdlcc_abi::LiteralToStrFunc* literal_to_str_func_;
+  CreateInitialStateFunc* create_initial_state_func_;
+  gdlcc_abi::CreateStateFunc* create_state_func_;
+  bool uses_binary_abi_;
+};
 
-bool InitializeGDLCCEngineOrFalse(
+/**
+ * A state created by a game library, which keeps the library loaded
+ */
+class GameLibraryState : public State {
+public:
+  GameLibraryState(const GameLibrarySp& library, const StateSp& state);
+  const FactSet& GetFacts() const override;
+  const std::vector<ActionSet>& GetLegalActions() const override;
+  StateSp GetNextState(const JointAction& joint_action) const override;
+  bool IsTerminal() const override;
+  const std::vector<int>& GetGoals() const override;
+  std::vector<int> Simulate() const override;
+  const std::vector<JointAction>& GetJointActionHistory() const override;
+  std::string ToString() const override;
+  /**
+   * @return the library which created this state
+   */
+  const GameLibrarySp& GetLibrary() const;
+private:
+  GameLibrarySp library_;
+  StateSp state_;
+};
+
+/**
+ * Convert KIF -> C++, compile it and load it as a shared library.
+ * The files are put as tmp/<name>.{kif,cpp,so}, thus name must be unique
+ * among the games loaded concurrently.
+ * The KIF is converted as it is, thus a string-interface library numbers the
+ * same atoms as the rules given, e.g. ToKIF(GameData::nodes). A library of the
+ * binary interface needs atom_table (see GameLibrary::Load).
+ */
+GameLibrarySp LoadGameLibrary(
     const std::string& kif,
     const std::string& name,
-    const bool reuses_existing_lib);
-
-StateSp CreateInitialState();
+    const bool reuses_existing_lib,
+    const gdlcc_abi::AtomTable& atom_table=gdlcc_abi::AtomTable());
 
 }
 }
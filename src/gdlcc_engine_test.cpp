@@ -1,8 +1,13 @@
 #include "gtest/gtest.h"
 #include "gdlcc_engine.hpp"
 
+#include <cstdlib>
 #include <iostream>
+#include <set>
+#include <stdexcept>
+#include <dlfcn.h>
 #include "file_utils.hpp"
+#include "sexpr_parser.hpp"
 
 namespace ggpe {
 namespace gdlcc {
@@ -14,11 +19,41 @@ const auto tictactoe_kif =
 const auto breakthrough_filename = "kif/breakthrough.kif";
 const auto breakthrough_kif =
     file_utils::LoadStringFromFile(breakthrough_filename);
+
+/**
+ * Number the atoms of a KIF without YAP, which libraries of the binary
+ * interface need
+ */
+gdlcc_abi::AtomTable CreateAtomTable(const std::string& kif) {
+  gdlcc_abi::AtomTable atom_table = {{atoms::kLeftParen, "("}, {atoms::kRightParen, ")"}};
+  const auto atom_strs = sexpr_parser::CollectAtoms(sexpr_parser::ParseKIF(kif));
+  Atom atom = 512;
+  for (const auto& atom_str : std::set<std::string>(atom_strs.begin(), atom_strs.end())) {
+    atom_table.emplace_back(atom++, atom_str);
+  }
+  return atom_table;
+}
+
+/**
+ * Compile test/gdlcc_abi_fixture.cpp, a library of the binary interface
+ * @return the path of the library
+ */
+std::string CompileABIFixture() {
+  const auto lib_filename = std::string("tmp/gdlcc_abi_fixture.so");
+  const auto compile_command =
+      "${CXX:-c++} -std=c++11 -I./include/ggpe -I./src -I. -shared -fPIC -o " +
+      lib_filename + " test/gdlcc_abi_fixture.cpp";
+  if (std::system(compile_command.c_str()) != 0) {
+    throw std::runtime_error("Failed to compile the fixture library.");
+  }
+  return lib_filename;
+}
 }
 
 TEST(GDLCCEngine, TicTacToe) {
-  InitializeGDLCCEngine(tictactoe_kif, "tictactoe", false);
-  const auto state = CreateInitialState();
+  const auto library = LoadGameLibrary(
+      tictactoe_kif, "tictactoe", false, CreateAtomTable(tictactoe_kif));
+  const auto state = library->CreateInitialState();
   std::cout << state->ToString() << std::endl;
   const auto& legal_actions = state->GetLegalActions();
   ASSERT_EQ(legal_actions.size(), 2);
@@ -34,8 +69,9 @@ TEST(GDLCCEngine, TicTacToe) {
 }
 
 TEST(GDLCCEngine, Breakthrough) {
-  InitializeGDLCCEngine(breakthrough_kif, "breakthrough", false);
-  auto state = CreateInitialState();
+  const auto library = LoadGameLibrary(
+      breakthrough_kif, "breakthrough", false, CreateAtomTable(breakthrough_kif));
+  auto state = library->CreateInitialState();
   std::cout << state->ToString() << std::endl;
   const auto& legal_actions = state->GetLegalActions();
   ASSERT_EQ(legal_actions.size(), 2);
@@ -50,5 +86,66 @@ TEST(GDLCCEngine, Breakthrough) {
   ASSERT_TRUE(!goals.empty());
 }
 
+TEST(GDLCCEngine, MultipleLibraries) {
+  const auto tictactoe = LoadGameLibrary(
+      tictactoe_kif, "tictactoe", true, CreateAtomTable(tictactoe_kif));
+  const auto breakthrough = LoadGameLibrary(
+      breakthrough_kif, "breakthrough", true, CreateAtomTable(breakthrough_kif));
+  const auto tictactoe_state = tictactoe->CreateInitialState();
+  const auto breakthrough_state = breakthrough->CreateInitialState();
+  ASSERT_EQ(tictactoe_state->GetLegalActions().at(0).size(), 9);
+  ASSERT_EQ(breakthrough_state->GetLegalActions().at(0).size(), 22);
+  const auto next_state =
+      tictactoe_state->GetNextState(JointAction{{
+          tictactoe_state->GetLegalActions().at(0).front(),
+          tictactoe_state->GetLegalActions().at(1).front()}});
+  const auto library_state = std::dynamic_pointer_cast<const GameLibraryState>(next_state);
+  ASSERT_TRUE(library_state != nullptr);
+  ASSERT_EQ(library_state->GetLibrary(), tictactoe);
+  ASSERT_TRUE(!breakthrough_state->Simulate().empty());
+}
+
+TEST(GDLCCEngine, BinaryABI) {
+  const auto lib_filename = CompileABIFixture();
+  const gdlcc_abi::AtomTable atom_table = {{600, "cell"}, {601, "x"}, {602, "o"}};
+  const auto library = GameLibrary::Load(lib_filename, atom_table);
+  ASSERT_TRUE(library->UsesBinaryABI());
+  // Tuples of the library use the atoms of the table
+  const auto initial_state = library->CreateInitialState();
+  ASSERT_EQ(initial_state->GetFacts(), FactSet({{600, 601}}));
+  const auto state = library->CreateState(FactSet({{600, 602}}));
+  ASSERT_EQ(state->GetFacts(), FactSet({{600, 602}}));
+  const auto library_state = std::dynamic_pointer_cast<const GameLibraryState>(state);
+  ASSERT_TRUE(library_state != nullptr);
+  ASSERT_EQ(library_state->GetLibrary(), library);
+  // A table without some atom of the game is rejected, and so is no table
+  ASSERT_THROW(GameLibrary::Load(lib_filename, {{600, "cell"}}), std::runtime_error);
+  ASSERT_THROW(GameLibrary::Load(lib_filename, gdlcc_abi::AtomTable()), std::runtime_error);
+}
+TEST(GDLCCEngine, StaticBinaryABI) {
+  // The functions of the fixture stand in for those linked at build time
+  const auto lib_filename = CompileABIFixture();
+  const auto handle = dlopen(lib_filename.c_str(), RTLD_NOW | RTLD_LOCAL);
+  ASSERT_TRUE(handle != nullptr);
+  const gdlcc_abi::StaticSymbols symbols = {
+    reinterpret_cast<CreateInitialStateFunc*>(dlsym(handle, "CreateInitialState")),
+    reinterpret_cast<gdlcc_abi::GetABIVersionFunc*>(dlsym(handle, "GetABIVersion")),
+    reinterpret_cast<gdlcc_abi::SetAtomTableFunc*>(dlsym(handle, "SetAtomTable")),
+    reinterpret_cast<gdlcc_abi::CreateStateFunc*>(dlsym(handle, "CreateState"))
+  };
+  const gdlcc_abi::AtomTable atom_table = {{700, "cell"}, {701, "x"}};
+  {
+    const auto library = GameLibrary::CreateStatic(symbols, atom_table);
+    ASSERT_TRUE(library->UsesBinaryABI());
+    ASSERT_EQ(library->CreateInitialState()->GetFacts(), FactSet({{700, 701}}));
+    ASSERT_EQ(library->CreateState(FactSet({{701, 700}}))->GetFacts(), FactSet({{701, 700}}));
+  }
+  // Without the binary interface, only the initial state is available
+  const auto string_library = GameLibrary::CreateStatic(
+      {symbols.create_initial_state, nullptr, nullptr, nullptr}, atom_table);
+  ASSERT_FALSE(string_library->UsesBinaryABI());
+  dlclose(handle);
+}
+
 }
 }
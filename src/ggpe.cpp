@@ -1,215 +1,69 @@
 #include "ggpe.hpp"
 
-#include <algorithm>
 #include <cassert>
-#include <cstdlib>
-#include <fstream>
-#include <iostream>
-#include <sstream>
-#include <thread>
-#include <mutex>
-#include <unordered_map>
-#include <unordered_set>
-
-#include <boost/format.hpp>
+
 #include <boost/filesystem.hpp>
-#include <boost/timer.hpp>
-#include <boost/functional/hash.hpp>
-#include <boost/bimap/bimap.hpp>
-#include <boost/bimap/unordered_set_of.hpp>
-#include <Yap/YapInterface.h>
-#include <glog/logging.h>
-
-#include "sexpr_parser.hpp"
+
 #include "file_utils.hpp"
-#include "yap_engine.hpp"
-#include "gdlcc_engine.hpp"
-#include "prettyprint.hpp"
+#include "gdl_codec.hpp"
 
 namespace ggpe {
 
-template <class K, class V>
-using UnorderedBimap = boost::bimaps::bimap<boost::bimaps::unordered_set_of<K>, boost::bimaps::unordered_set_of<V>>;
-using AtomAndString = UnorderedBimap<Atom, std::string>::value_type;
-UnorderedBimap<Atom, std::string> atom_to_string;
-std::string game_name;
-std::vector<Atom> roles;
-std::vector<int> role_indices;
-std::unordered_map<Atom, int> atom_to_role_index;
-std::unordered_map<Atom, int> atom_to_functor_arity;
-std::unordered_map<Atom, int> atom_to_goal_values;
-std::vector<Tuple> initial_facts;
-std::vector<Tuple> possible_facts;
-std::vector<std::vector<Tuple>> possible_actions;
-std::unordered_map<Atom, std::unordered_map<Atom, int>> atom_to_ordered_domain;
-std::unordered_set<Atom> step_counter_atoms;
-std::unordered_map<AtomPair, std::vector<std::pair<Atom, std::pair<int, int>>>, boost::hash<AtomPair>> fact_action_connections;
-std::unordered_map<Atom, std::unordered_map<int, Atom>> fact_ordered_args;
-std::unordered_map<Atom, std::unordered_map<int, Atom>> action_ordered_args;
-std::string game_kif = "";
-bool game_enables_tabling = false;
-EngineBackend engine_backend;
-bool is_yap_engine_initialized = false;
-bool is_gdlcc_engine_initialized = false;
-std::vector<std::vector<FactSet>> win_conditions;
-
-//template <class Iterator>
-//std::string TupleToString(const Iterator& begin, const Iterator& end) {
-//  assert(std::distance(begin, end) > 0);
-//  if (std::distance(begin, end) == 1) {
-//    // Atom
-//    return std::string(AtomToString(*begin));
-//  }
-//  // Compound term
-//  std::ostringstream o;
-//  o << '(';
-//  o << AtomToString(*begin) << ' ';
-//  for (auto i = begin + 1; i != end; ++i) {
-//    const auto atom = *i;
-////    o << AtomToString(atom);
-//    if (atom_to_functor_arity.count(atom)) {
-//      // Functor atom
-//      const auto arity = atom_to_functor_arity[atom];
-//      o << TupleToString(i, i + arity);
-//      i += arity - 1;
-//    } else {
-//      // Non-functor atom
-//      o << AtomToString(atom);
-//    }
-//    if (i != end - 1) {
-//      o << ' ';
-//    }
-//  }
-//  o << ')';
-//  return o.str();
-//}
+namespace {
+
+const Game& GetGame() {
+  assert(GetDefaultGame() && "Initialize must be called before.");
+  return *GetDefaultGame();
+}
+
+}
 
 const std::string& AtomToString(const Atom atom) {
-  return atom_to_string.left.at(atom);
+  return GetGame().AtomToString(atom);
 }
 
 Atom StringToAtom(const std::string& atom_str) {
-  return atom_to_string.right.at(atom_str);
+  return GetGame().StringToAtom(atom_str);
 }
 
 std::string TupleToString(const Tuple& tuple) {
-  if (tuple.size() == 1) {
-    return AtomToString(tuple.front());
-  } else {
-    std::ostringstream o;
-    o << '(';
-    for (auto it = tuple.begin(); it != tuple.end(); ++it) {
-      o << AtomToString(*it);
-      if (it != tuple.end() - 1) {
-        o << ' ';
-      }
-    }
-    o << ')';
-    return o.str();
-  }
-//  return TupleToString(tuple.begin(), tuple.end());
-}
-
-Tuple NodeToTuple(const sexpr_parser::TreeNode& node) {
-  if (node.IsLeaf()) {
-    const auto atom = StringToAtom(node.GetValue());
-    return Tuple({atom});
-  } else {
-    assert(node.GetChildren().size() >= 2);
-    assert(node.GetChildren().front().IsLeaf());
-    Tuple tuple;
-    tuple.reserve(node.GetChildren().size());
-    tuple.push_back(StringToAtom(node.GetChildren().front().GetValue()));
-    const auto& children = node.GetChildren();
-    for (auto i = children.begin() + 1; i != children.end(); ++i) {
-      const auto arg_tuple = NodeToTuple(*i);
-      tuple.insert(tuple.end(), arg_tuple.begin(), arg_tuple.end());
-    }
-    return tuple;
-  }
+  return GetGame().TupleToString(tuple);
 }
 
 Tuple StringToTuple(const std::string& str) {
-  const auto nodes = sexpr_parser::ParseKIF(str);
-  assert(nodes.size() == 1);
-  const auto node = nodes.front();
-  return NodeToTuple(node);
-}
-
-bool IsGDLCCEngineValid() {
-  assert(is_yap_engine_initialized);
-  auto yap_state = yap::CreateInitialState();
-  auto gdlcc_state = gdlcc::CreateInitialState();
-  while (!yap_state->IsTerminal()) {
-    if (gdlcc_state->IsTerminal()) {
-      std::cout << "YapState is not terminal, but CppState is terminal." << std::endl;
-      std::cout << "YapState:\n" << yap_state->ToString();
-      std::cout << "CppState:\n" << gdlcc_state->ToString();
-      return false;
-    }
-    auto yap_facts = yap_state->GetFacts();
-    auto gdlcc_facts = gdlcc_state->GetFacts();
-    if (yap_facts.size() != gdlcc_facts.size()) {
-      std::cout << "The number of facts in a state differs for YapState and CppState." << std::endl;
-      std::cout << "YapState:" << yap_state->GetFacts().size() << std::endl << yap_state->ToString();
-      std::cout << "CppState:" << gdlcc_state->GetFacts().size() << std::endl << gdlcc_state->ToString();
-      return false;
-    }
-    std::sort(yap_facts.begin(), yap_facts.end());
-    std::sort(gdlcc_facts.begin(), gdlcc_facts.end());
-    if (yap_facts != gdlcc_facts) {
-      std::cout << "The facts in a state differ for YapState and CppState." << std::endl;
-      std::cout << "yap_facts" << yap_facts << std::endl;
-      std::cout << "gdlcc_facts" << gdlcc_facts << std::endl;
-      std::cout << "YapState:" << std::endl;
-      std::cout << yap_state->ToString();
-      std::cout << "CppState:" << std::endl;
-      std::cout << gdlcc_state->ToString();
-      return false;
-    }
-    if (yap_state->GetLegalActions().size() != gdlcc_state->GetLegalActions().size()) {
-      std::cout << "The number of legal actions in a state differs for YapState and CppState." << std::endl;
-      std::cout << "YapState:" << yap_state->GetLegalActions().size() << std::endl << yap_state->ToString();
-      std::cout << "CppState:" << gdlcc_state->GetLegalActions().size() << std::endl << gdlcc_state->ToString();
-      return false;
-    }
-    JointAction joint_action;
-    for (auto role_idx : GetRoleIndices()) {
-      auto yap_actions = yap_state->GetLegalActions()[role_idx];
-      auto gdlcc_actions = gdlcc_state->GetLegalActions()[role_idx];
-      if (yap_actions.size() != gdlcc_actions.size()) {
-        std::cout << "The number of legal actions for " << role_idx << " in a state differs for YapState and CppState." << std::endl;
-        std::cout << "YapState:" << yap_state->GetLegalActions()[role_idx].size() << std::endl << yap_state->ToString();
-        std::cout << "CppState:" << gdlcc_state->GetLegalActions()[role_idx].size() << std::endl << gdlcc_state->ToString();
-        return false;
-      }
-      std::sort(yap_actions.begin(), yap_actions.end());
-      std::sort(gdlcc_actions.begin(), gdlcc_actions.end());
-      if (yap_actions != gdlcc_actions) {
-        std::cout << "The legal actions for " << role_idx << " in a state differ for YapState and CppState." << std::endl;
-        std::cout << "YapState:\n" << yap_state->ToString();
-        std::cout << "CppState:\n" << gdlcc_state->ToString();
-        return false;
-      }
-      joint_action.push_back(yap_actions.front());
-    }
-    yap_state = yap_state->GetNextState(joint_action);
-    gdlcc_state = gdlcc_state->GetNextState(joint_action);
-  }
-  if (!yap_state->IsTerminal()) {
-    std::cout << "YapState is terminal, but CppState is not terminal." << std::endl;
-    std::cout << "YapState:\n" << yap_state->ToString();
-    std::cout << "CppState:\n" << gdlcc_state->ToString();
-    return false;
-  }
-  if (yap_state->GetGoals() != gdlcc_state->GetGoals()) {
-    std::cout << "The goal value in a state differs for YapState and CppState." << std::endl;
-    std::cout << "YapState:\n" << yap_state->ToString();
-    std::cout << "CppState:\n" << gdlcc_state->ToString();
-    return false;
+  return GetGame().StringToTuple(str);
+}
+
+void AppendTupleString(const Tuple& tuple, std::string& buffer) {
+  GetGame().AppendTupleString(tuple, buffer);
+}
+
+ServerMessage ParseServerMessage(const std::string& message) {
+  if (GetDefaultGame()) {
+    return GetGame().ParseServerMessage(message);
   }
-  std::cout << "GDLCC engine is valid." << std::endl;
-  return true;
+  return codec::ParseServerMessage(message.data(), message.data() + message.size(), nullptr);
+}
+
+namespace {
+
+/**
+ * @return true iif the default game is already initialized in the same way
+ */
+bool IsInitialized(
+    const std::string& kif,
+    const std::string& name,
+    const EngineBackend backend,
+    const bool enables_tabling) {
+  const auto& game = GetDefaultGame();
+  return game &&
+      game->GetKif() == kif &&
+      game->GetName() == name &&
+      game->EnablesTabling() == enables_tabling &&
+      game->GetEngineBackend() == backend &&
+      game->IsBoundToYap();
+}
+
 }
 
 void Initialize(
@@ -217,41 +71,19 @@ void Initialize(
     const std::string& name,
     const EngineBackend backend,
     const bool enables_tabling) {
-  assert(!kif.empty());
-  assert(!name.empty());
-  game_name = name;
-  if (game_kif == kif &&
-      engine_backend == backend &&
-      game_enables_tabling == enables_tabling) {
+  if (IsInitialized(kif, name, backend, enables_tabling)) {
     // Nothing to do
     return;
   }
-  game_kif = kif;
-  engine_backend = backend;
-  game_enables_tabling = enables_tabling;
-  is_yap_engine_initialized = false;
-  is_gdlcc_engine_initialized = false;
-#ifndef GGPE_SINGLE_THREAD
-  std::cout << "Thread-safe mode." << std::endl;
-#else
-  std::cout << "Single-thread mode." << std::endl;
-#endif
+  // States of the previous game stay valid as long as they are referenced
+  SetDefaultGame(std::make_shared<Game>(kif, name, backend, enables_tabling));
+}
 
-  // Initialize yap engine
-  yap::InitializeYapEngine(kif, name, enables_tabling);
-  is_yap_engine_initialized = true;
-  std::cout << "Initialized yap engine." << std::endl;
-
-  // Initialize gdlcc engine
-  if (backend == EngineBackend::GDLCC) {
-    if (gdlcc::InitializeGDLCCEngineOrFalse(kif, name, true) &&
-        IsGDLCCEngineValid()) {
-      std::cout << "Initialized gdlcc engine." << std::endl;
-      is_gdlcc_engine_initialized = true;
-    } else {
-      std::cout << "Failed to initialize gdlcc engine." << std::endl;
-    }
-  }
+void InitializeWithStaticGame(
+    const std::string& kif,
+    const std::string& name,
+    const gdlcc_abi::StaticSymbols& symbols) {
+  SetDefaultGame(std::make_shared<Game>(kif, name, symbols));
 }
 
 void InitializeFromFile(
@@ -259,66 +91,57 @@ void InitializeFromFile(
     const EngineBackend backend,
     const bool enables_tabling) {
   boost::filesystem::path path(kif_filename);
-  Initialize(
-      file_utils::LoadStringFromFile(kif_filename),
-      path.stem().string(),
-      backend,
-      enables_tabling);
+  auto kif = file_utils::LoadStringFromFile(kif_filename);
+  const auto name = path.stem().string();
+  if (IsInitialized(kif, name, backend, enables_tabling)) {
+    return;
+  }
+  // The KIF is moved into the game, since large KIFs are not worth a copy
+  SetDefaultGame(std::make_shared<Game>(std::move(kif), name, backend, enables_tabling));
 }
 
 const std::vector<Tuple>& GetPossibleFacts() {
-  return possible_facts;
+  return GetGame().GetPossibleFacts();
 }
 
 const std::vector<std::vector<Tuple>>& GetPossibleActions() {
-  return possible_actions;
+  return GetGame().GetPossibleActions();
 }
 
 int GetRoleCount() {
-  return roles.size();
+  return GetGame().GetRoleCount();
 }
 
 const std::vector<int>& GetRoleIndices() {
-  return role_indices;
+  return GetGame().GetRoleIndices();
 }
 
 bool IsValidRoleIndex(const int role_idx) {
-  return std::find(role_indices.begin(), role_indices.end(), role_idx) != role_indices.end();
+  return GetGame().IsValidRoleIndex(role_idx);
 }
 
 std::string RoleIndexToString(const int role_index) {
-  return AtomToString(roles[role_index]);
+  return GetGame().RoleIndexToString(role_index);
 }
 
 int StringToRoleIndex(const std::string& role_str) {
-  return atom_to_role_index.at(StringToAtom(role_str));
+  return GetGame().StringToRoleIndex(role_str);
 }
 
-
 std::string JointActionToString(const JointAction& joint_action) {
-  assert(joint_action.size() == roles.size());
-  std::ostringstream o;
-  o << '(';
-  for (auto i = joint_action.begin(); i != joint_action.end(); ++i) {
-    if (i != joint_action.begin()) {
-      o << ' ';
-    }
-    o << TupleToString(*i);
-  }
-  o << ')';
-  return o.str();
+  return GetGame().JointActionToString(joint_action);
 }
 
-const std::unordered_set<Atom>& GetStepCounters() {
-  return step_counter_atoms;
+std::unordered_set<Atom> GetStepCounters(const boost::optional<Deadline>& deadline) {
+  return GetGame().GetStepCounters(deadline);
 }
 
-const std::unordered_map<AtomPair, std::vector<std::pair<Atom, std::pair<int, int>>>, boost::hash<AtomPair>>& GetFactActionConnections() {
-  return fact_action_connections;
+std::unordered_map<AtomPair, std::vector<std::pair<Atom, std::pair<int, int>>>, boost::hash<AtomPair>> GetFactActionConnections(const boost::optional<Deadline>& deadline) {
+  return GetGame().GetFactActionConnections(deadline);
 }
 
-const std::unordered_map<Atom, std::unordered_map<Atom, int>>& GetOrderedDomains() {
-  return atom_to_ordered_domain;
+std::unordered_map<Atom, std::unordered_map<Atom, int>> GetOrderedDomains(const boost::optional<Deadline>& deadline) {
+  return GetGame().GetOrderedDomains(deadline);
 }
 
 void InitializeTicTacToe(const EngineBackend backend) {
@@ -485,15 +308,19 @@ void InitializeTicTacToe(const EngineBackend backend) {
 }
 
 const std::string& GetGameName() {
-  return game_name;
+  return GetGame().GetName();
+}
+
+const InitializationReport& GetInitializationReport() {
+  return GetGame().GetInitializationReport();
 }
 
 StateSp CreateInitialState() {
-  if (is_gdlcc_engine_initialized) {
-    return gdlcc::CreateInitialState();
-  } else {
-    return yap::CreateInitialState();
-  }
+  return GetGame().CreateInitialState();
+}
+
+StateSp CreateState(const FactSet& facts) {
+  return GetGame().CreateState(facts);
 }
 
 std::string GetGGPEPath() {
@@ -505,23 +332,23 @@ std::string GetGGPEPath() {
 }
 
 EngineBackend GetEngineBackend() {
-  if (is_gdlcc_engine_initialized) {
-    return EngineBackend::GDLCC;
-  } else {
-    return EngineBackend::YAP;
-  }
+  return GetGame().GetEngineBackend();
 }
 
 std::vector<int> GetPartialGoals(const StateSp& state) {
-  return yap::GetPartialGoals(state);
+  return GetGame().GetPartialGoals(state);
 }
 
 std::vector<NextCondition> DetectNextConditions(const Fact& fact) {
-  return yap::DetectNextConditions(fact);
+  return GetGame().DetectNextConditions(fact);
+}
+
+std::vector<std::vector<FactSet>> GetWinConditions(const boost::optional<Deadline>& deadline) {
+  return GetGame().GetWinConditions(deadline);
 }
 
-const std::vector<std::vector<FactSet>>& GetWinConditions() {
-  return win_conditions;
+void RunAnalyses(const boost::optional<Deadline>& deadline) {
+  GetGame().RunAnalyses(deadline);
 }
 
 }
@@ -1,8 +1,11 @@
 #include "gtest/gtest.h"
 #include "ggpe.hpp"
+#include "file_utils.hpp"
 
 #include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstdio>
 #include <fstream>
 #include <thread>
 #include <boost/timer/timer.hpp>
@@ -70,6 +73,17 @@ TEST(GetGameName, TicTacToe) {
   ASSERT_EQ(GetGameName(), "tictactoe");
 }
 
+TEST(GetInitializationReport, TicTacToe) {
+  InitializeTicTacToe();
+  const auto& report = GetInitializationReport();
+  ASSERT_FALSE(report.empty());
+  ASSERT_EQ(report.front().name, "parse");
+  for (const auto& phase : report) {
+    ASSERT_GE(phase.wall_time, 0);
+    ASSERT_GT(phase.end_memory, 0);
+  }
+}
+
 TEST(Role, TicTacToe) {
   InitializeTicTacToe();
   ASSERT_EQ(GetRoleCount(), 2);
@@ -204,6 +218,31 @@ TEST(DetectNextConditions, TicTacToe) {
   ASSERT_EQ(fact_condition.front(), StringToTuple("(cell 1 1 b)"));
 }
 
+TEST(GetWinConditions, Deadline) {
+  // Analyses saved by previous runs would be reused
+  std::remove("tmp/tictactoe_lazy.bundle");
+  const auto game = std::make_shared<Game>(
+      file_utils::LoadStringFromFile(tictactoe_filename), "tictactoe_lazy");
+  // The result is empty if the deadline has passed
+  const auto expired = game->GetWinConditions(std::chrono::steady_clock::now());
+  ASSERT_TRUE(std::all_of(expired.begin(), expired.end(), [](const std::vector<FactSet>& conditions){
+    return conditions.empty();
+  }));
+  // The analysis is run again without a deadline
+  const auto win_conditions = game->GetWinConditions();
+  ASSERT_EQ(win_conditions.size(), 2);
+  ASSERT_FALSE(win_conditions[0].empty());
+}
+
+TEST(RunAnalyses, Breakthrough) {
+  std::remove("tmp/breakthrough_parallel.bundle");
+  const auto game = std::make_shared<Game>(
+      file_utils::LoadStringFromFile(breakthrough_filename), "breakthrough_parallel");
+  game->RunAnalyses();
+  // Results are joined from forked processes
+  ASSERT_EQ(game->GetWinConditions().size(), 2);
+}
+
 TEST(Atoms, TicTacToe) {
   InitializeTicTacToe();
   ASSERT_EQ(AtomToString(atoms::kFree), "?");
@@ -231,6 +270,129 @@ TEST(GetJointActionHistory, TicTacToe) {
   ASSERT_EQ(third_state->GetJointActionHistory().at(1), second_action);
 }
 
+TEST(CreateState, TicTacToe) {
+  InitializeTicTacToe();
+  const auto initial_state = CreateInitialState();
+  const auto state = CreateState(initial_state->GetFacts());
+  ASSERT_TRUE(*state == *initial_state);
+  ASSERT_FALSE(state->IsTerminal());
+  ASSERT_EQ(state->GetLegalActions(), initial_state->GetLegalActions());
+  ASSERT_EQ(state->GetJointActionHistory().size(), 0);
+  const auto terminal_state = SimpleSimulate(initial_state);
+  const auto restored_terminal_state = CreateState(terminal_state->GetFacts());
+  ASSERT_TRUE(restored_terminal_state->IsTerminal());
+  ASSERT_EQ(restored_terminal_state->GetGoals(), terminal_state->GetGoals());
+}
+
+TEST(Game, MultipleGames) {
+  const auto tictactoe = std::make_shared<Game>(
+      file_utils::LoadStringFromFile(tictactoe_filename), "tictactoe", EngineBackend::GDLCC);
+  const auto tictactoe_state = tictactoe->CreateInitialState();
+  const auto breakthrough = std::make_shared<Game>(
+      file_utils::LoadStringFromFile(breakthrough_filename), "breakthrough", EngineBackend::GDLCC);
+  const auto breakthrough_state = breakthrough->CreateInitialState();
+  ASSERT_FALSE(tictactoe->IsBoundToYap());
+  ASSERT_TRUE(breakthrough->IsBoundToYap());
+  // Each game keeps its own atoms and roles
+  ASSERT_EQ(tictactoe->GetRoleCount(), 2);
+  ASSERT_EQ(breakthrough->RoleIndexToString(0), "white");
+  ASSERT_EQ(tictactoe->AtomToString(tictactoe->StringToAtom("cell")), "cell");
+  ASSERT_THROW(breakthrough->StringToAtom("cell"), std::out_of_range);
+  // States of GDLCC engine do not depend on YAP
+  ASSERT_EQ(tictactoe_state->GetLegalActions().at(0).size(), 9);
+  ASSERT_FALSE(tictactoe_state->Simulate().empty());
+  ASSERT_EQ(breakthrough_state->GetLegalActions().at(0).size(), 22);
+  // States of YAP engine can be queried only while YAP holds their game
+  const auto yap_game = std::make_shared<Game>(
+      file_utils::LoadStringFromFile(tictactoe_filename), "tictactoe");
+  const auto yap_state = yap_game->CreateInitialState();
+  ASSERT_EQ(yap_state->GetLegalActions().at(0).size(), 9);
+  const auto other_game = std::make_shared<Game>(
+      file_utils::LoadStringFromFile(breakthrough_filename), "breakthrough");
+  ASSERT_FALSE(yap_state->GetFacts().empty());
+  ASSERT_THROW(yap_game->CreateState(yap_state->GetFacts()), std::runtime_error);
+}
+
+TEST(Game, SwitchGames) {
+  // Analyses saved by previous runs would be reused instead of queried
+  std::remove("tmp/breakthrough_switch.bundle");
+  std::remove("tmp/tictactoe_switch.bundle");
+  const auto breakthrough = std::make_shared<Game>(
+      file_utils::LoadStringFromFile(breakthrough_filename), "breakthrough_switch");
+  ASSERT_EQ(breakthrough->CreateInitialState()->GetLegalActions().at(0).size(), 22);
+  // Rules and memoized results of breakthrough are replaced
+  const auto tictactoe = std::make_shared<Game>(
+      file_utils::LoadStringFromFile(tictactoe_filename), "tictactoe_switch", EngineBackend::YAP, true);
+  ASSERT_EQ(tictactoe->GetPossibleActions().at(0).size(), 10);
+  ASSERT_EQ(tictactoe->GetPossibleFacts().size(), 29);
+  ASSERT_EQ(tictactoe->CreateInitialState()->GetLegalActions().at(0).size(), 9);
+  // Analyses of a game no longer held by YAP are empty instead of thrown
+  const auto win_conditions = breakthrough->GetWinConditions();
+  ASSERT_EQ(win_conditions.size(), 2);
+  ASSERT_TRUE(win_conditions[0].empty());
+}
+
+TEST(Game, Propnet) {
+  const auto tictactoe = std::make_shared<Game>(
+      file_utils::LoadStringFromFile(tictactoe_filename), "tictactoe", EngineBackend::PROPNET);
+  ASSERT_EQ(tictactoe->GetEngineBackend(), EngineBackend::PROPNET);
+  const auto state = tictactoe->CreateInitialState();
+  ASSERT_EQ(state->GetFacts().size(), 10);
+  ASSERT_EQ(state->GetLegalActions().at(0).size(), 9);
+  ASSERT_EQ(state->GetLegalActions().at(1).size(), 1);
+  // States of propnet engine do not depend on YAP
+  const auto other_game = std::make_shared<Game>(
+      file_utils::LoadStringFromFile(breakthrough_filename), "breakthrough");
+  const auto next_state = state->GetNextState(
+      {state->GetLegalActions().at(0).front(), state->GetLegalActions().at(1).front()});
+  ASSERT_EQ(next_state->GetLegalActions().at(1).size(), 8);
+  ASSERT_EQ(next_state->GetJointActionHistory().size(), 1);
+  const auto goals = state->Simulate();
+  ASSERT_EQ(goals.size(), 2);
+  ASSERT_EQ(goals.at(0) + goals.at(1), 100);
+  // Playouts more than lanes in a word
+  const auto goals_list = state->SimulateBatch(100);
+  ASSERT_EQ(goals_list.size(), 100);
+  for (const auto& goals : goals_list) {
+    ASSERT_EQ(goals.size(), 2);
+    ASSERT_EQ(goals.at(0) + goals.at(1), 100);
+  }
+  const auto restored_state = tictactoe->CreateState(next_state->GetFacts());
+  ASSERT_EQ(restored_state->GetLegalActions(), next_state->GetLegalActions());
+}
+
+TEST(Game, Datalog) {
+  const auto tictactoe = std::make_shared<Game>(
+      file_utils::LoadStringFromFile(tictactoe_filename), "tictactoe", EngineBackend::DATALOG);
+  ASSERT_EQ(tictactoe->GetEngineBackend(), EngineBackend::DATALOG);
+  const auto state = tictactoe->CreateInitialState();
+  ASSERT_EQ(state->GetFacts().size(), 10);
+  ASSERT_EQ(state->GetLegalActions().at(0).size(), 9);
+  ASSERT_EQ(state->GetLegalActions().at(1).size(), 1);
+  // States of datalog engine do not depend on YAP
+  const auto other_game = std::make_shared<Game>(
+      file_utils::LoadStringFromFile(breakthrough_filename), "breakthrough");
+  const auto next_state = state->GetNextState(
+      {state->GetLegalActions().at(0).front(), state->GetLegalActions().at(1).front()});
+  ASSERT_EQ(next_state->GetLegalActions().at(1).size(), 8);
+  ASSERT_EQ(next_state->GetJointActionHistory().size(), 1);
+  // Threads simulate without lock
+  std::vector<std::vector<int>> goals_list(4);
+  std::vector<std::thread> threads;
+  for (auto& goals : goals_list) {
+    threads.emplace_back([&state, &goals]() { goals = state->Simulate(); });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (const auto& goals : goals_list) {
+    ASSERT_EQ(goals.size(), 2);
+    ASSERT_EQ(goals.at(0) + goals.at(1), 100);
+  }
+  const auto restored_state = tictactoe->CreateState(next_state->GetFacts());
+  ASSERT_EQ(restored_state->GetLegalActions(), next_state->GetLegalActions());
+}
+
 TEST(InitializeFromFile, Breakthrough) {
   InitializeFromFile(breakthrough_filename);
   auto state = CreateInitialState();
@@ -265,6 +427,10 @@ TEST(InitializeFromFile, ChineseCheckers4) {
   TestChineseCheckers4();
   InitializeFromFile(chinesecheckers4_filename, EngineBackend::GDLCC);
   TestChineseCheckers4();
+  InitializeFromFile(chinesecheckers4_filename, EngineBackend::PROPNET);
+  TestChineseCheckers4();
+  InitializeFromFile(chinesecheckers4_filename, EngineBackend::DATALOG);
+  TestChineseCheckers4();
 }
 
 #ifndef __clang__
@@ -280,6 +446,8 @@ TEST(CheckParallelizability, ChineseCheckers4) {
   CheckParallelizability(100);
   InitializeFromFile(chinesecheckers4_filename, EngineBackend::GDLCC);
   CheckParallelizability(1000);
+  InitializeFromFile(chinesecheckers4_filename, EngineBackend::DATALOG);
+  CheckParallelizability(100);
 }
 #endif
 
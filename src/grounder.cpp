@@ -0,0 +1,556 @@
+#include "grounder.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <boost/functional/hash.hpp>
+
+#include "datalog.hpp"
+
+namespace ggpe {
+namespace grounder {
+
+namespace {
+
+using sexpr_parser::TreeNode;
+using datalog::Bindings;
+using datalog::Budget;
+using datalog::Database;
+using datalog::Enumerator;
+using datalog::Rule;
+using datalog::RuleBuilder;
+using datalog::kNoAtom;
+using datalog::ContainsVariable;
+using datalog::ExpandBody;
+using datalog::FindAtom;
+using datalog::FindTermEnd;
+using datalog::IsVariable;
+using datalog::Saturate;
+using datalog::Stratify;
+using datalog::Substitute;
+using datalog::ToVariableIndex;
+
+/**
+ * Relations whose rules are kept in ground programs
+ */
+const std::unordered_set<std::string> kRootRelations = {
+  "next", "legal", "goal", "terminal"
+};
+
+/**
+ * Relations which are never evaluated while grounding
+ */
+const std::unordered_set<std::string> kKeptRelations = {
+  "true", "does", "next", "legal", "goal", "terminal"
+};
+
+constexpr long long kMaxStepCountPerRule = 100;
+
+const std::string kGroundProgramHeader = "ggpe-ground-program";
+constexpr int kGroundProgramVersion = 1;
+
+/**
+ * Estimate the number of instances of a rule, assuming that the values of
+ * each argument are uniformly distributed over its domain
+ */
+double EstimateInstanceCount(const Rule& rule, const Database& database) {
+  std::vector<bool> is_bound(rule.variable_count, false);
+  std::vector<bool> used(rule.positives.size(), false);
+  auto estimate = 1.0;
+  for (auto n = 0; n < static_cast<int>(rule.positives.size()); ++n) {
+    auto best_idx = -1;
+    auto best_factor = 0.0;
+    for (auto i = 0; i < static_cast<int>(rule.positives.size()); ++i) {
+      if (used[i]) {
+        continue;
+      }
+      const auto table = database.Find(rule.positives[i].front());
+      if (!table) {
+        return 0.0;
+      }
+      auto factor = static_cast<double>(table->tuples.size());
+      // Constants select their buckets, and bound variables divide by their
+      // domain sizes
+      for (const auto& subterm : rule.positive_subterms[i]) {
+        if (subterm.term.size() != 1) {
+          continue;
+        }
+        const auto atom = subterm.term.front();
+        if (!IsVariable(atom)) {
+          factor = std::min(factor, static_cast<double>(table->Find(subterm.path, subterm.term).size()));
+        } else if (is_bound[ToVariableIndex(atom)] && table->GetDomainSize(subterm.path) > 0) {
+          factor /= table->GetDomainSize(subterm.path);
+        }
+      }
+      if (best_idx < 0 || factor < best_factor) {
+        best_idx = i;
+        best_factor = factor;
+      }
+    }
+    used[best_idx] = true;
+    for (const auto atom : rule.positives[best_idx]) {
+      if (IsVariable(atom)) {
+        is_bound[ToVariableIndex(atom)] = true;
+      }
+    }
+    estimate *= std::max(best_factor, 1.0);
+  }
+  return estimate;
+}
+
+/**
+ * Inserts tuples, applying the reserved implications
+ * (init X) -> (true X), (next X) -> (true X) and (legal R A) -> (does R A)
+ */
+class Inserter {
+public:
+  explicit Inserter(const GameData& game) :
+      true_atom_(FindAtom(game, "true")),
+      does_atom_(FindAtom(game, "does")),
+      init_atom_(FindAtom(game, "init")),
+      next_atom_(FindAtom(game, "next")),
+      legal_atom_(FindAtom(game, "legal")) {}
+
+  void Insert(const Tuple& tuple, Database& database, std::unordered_set<Atom>& changed) const {
+    const auto relation = tuple.front();
+    if (database.GetTable(relation).Insert(tuple)) {
+      changed.insert(relation);
+    }
+    if ((relation == init_atom_ || relation == next_atom_) && true_atom_ != kNoAtom) {
+      auto true_tuple = tuple;
+      true_tuple.front() = true_atom_;
+      Insert(true_tuple, database, changed);
+    } else if (relation == legal_atom_ && does_atom_ != kNoAtom) {
+      auto does_tuple = tuple;
+      does_tuple.front() = does_atom_;
+      Insert(does_tuple, database, changed);
+    }
+  }
+
+  Atom GetTrueAtom() const {
+    return true_atom_;
+  }
+
+  Atom GetDoesAtom() const {
+    return does_atom_;
+  }
+
+private:
+  const Atom true_atom_;
+  const Atom does_atom_;
+  const Atom init_atom_;
+  const Atom next_atom_;
+  const Atom legal_atom_;
+};
+
+}
+
+std::vector<Tuple> SplitArgs(const Tuple& literal) {
+  std::vector<Tuple> args;
+  auto it = literal.begin() + 1;
+  while (it != literal.end()) {
+    const auto end = FindTermEnd(it);
+    if (*it == atoms::kLeftParen) {
+      args.emplace_back(it + 1, end - 1);
+    } else {
+      args.emplace_back(it, end);
+    }
+    it = end;
+  }
+  return args;
+}
+
+Tuple ArgsToLiteral(const Atom relation, const std::vector<Tuple>& args) {
+  Tuple literal({relation});
+  for (const auto& arg : args) {
+    if (arg.size() == 1) {
+      literal.push_back(arg.front());
+    } else {
+      literal.push_back(atoms::kLeftParen);
+      literal.insert(literal.end(), arg.begin(), arg.end());
+      literal.push_back(atoms::kRightParen);
+    }
+  }
+  return literal;
+}
+
+GroundProgram Ground(
+    const std::vector<sexpr_parser::TreeNode>& nodes,
+    const GameData& game,
+    const int max_rule_count) {
+  RuleBuilder builder(game);
+  const Inserter inserter(game);
+  Database database;
+  Budget budget(static_cast<long long>(max_rule_count) * kMaxStepCountPerRule);
+  auto insert = [&](const Tuple& tuple, std::unordered_set<Atom>& changed) {
+    inserter.Insert(tuple, database, changed);
+  };
+
+  // Relations whose tables are complete once static rules are evaluated
+  const auto dynamic_relation_strs = sexpr_parser::CollectDynamicRelations(nodes);
+  std::unordered_set<Atom> exact_relations;
+  for (const auto& entry : game.atom_to_string.left) {
+    if (!dynamic_relation_strs.count(entry.second) && !kKeptRelations.count(entry.second)) {
+      exact_relations.insert(entry.first);
+    }
+  }
+
+  // Facts and rules
+  std::vector<Tuple> facts;
+  std::vector<Rule> rules;
+  std::unordered_set<Atom> changed;
+  for (const auto& node : nodes) {
+    if (!node.IsImplication()) {
+      const auto literal = builder.ToLiteral(node);
+      if (ContainsVariable(literal)) {
+        std::cout << "Note: non-ground fact is ignored: " << node.ToSexpr() << std::endl;
+        continue;
+      }
+      insert(literal, changed);
+      facts.push_back(literal);
+      continue;
+    }
+    const auto& children = node.GetChildren();
+    for (const auto& conjunction : ExpandBody(children.begin() + 2, children.end())) {
+      rules.push_back(builder.Build(children.at(1), conjunction));
+    }
+  }
+
+  // Evaluate static rules stratum by stratum
+  std::vector<const Rule*> dynamic_rules;
+  std::vector<const Rule*> static_rules;
+  for (const auto& rule : rules) {
+    (exact_relations.count(rule.head.front()) ? static_rules : dynamic_rules).push_back(&rule);
+  }
+  for (const auto& stratum_rules : Stratify(static_rules, sexpr_parser::RuleGraph(nodes), game)) {
+    Saturate(stratum_rules, database, exact_relations, budget, insert);
+  }
+
+  // Possible facts and actions
+  if (inserter.GetTrueAtom() != kNoAtom) {
+    for (const auto& fact : game.initial_facts) {
+      insert(ArgsToLiteral(inserter.GetTrueAtom(), {fact}), changed);
+    }
+    for (const auto& fact : game.possible_facts) {
+      insert(ArgsToLiteral(inserter.GetTrueAtom(), {fact}), changed);
+    }
+  }
+  if (inserter.GetDoesAtom() != kNoAtom) {
+    for (auto role_idx = 0; role_idx < static_cast<int>(game.possible_actions.size()); ++role_idx) {
+      const auto role = Tuple({game.roles.at(role_idx)});
+      for (const auto& action : game.possible_actions[role_idx]) {
+        insert(ArgsToLiteral(inserter.GetDoesAtom(), {role, action}), changed);
+      }
+    }
+  }
+
+  // Derive possible tuples of the other relations, ignoring their negations
+  Saturate(dynamic_rules, database, exact_relations, budget, insert);
+
+  // Estimate the size before instantiation
+  auto estimate = 0.0;
+  for (const auto rule : dynamic_rules) {
+    estimate += EstimateInstanceCount(*rule, database);
+  }
+  if (estimate > max_rule_count) {
+    throw std::runtime_error(
+        "Grounding is estimated to produce " + std::to_string(static_cast<long long>(estimate)) +
+        " rules, which exceeds " + std::to_string(max_rule_count) + ".");
+  }
+
+  // Instantiate the other rules over the possible tuples
+  std::vector<Tuple> literals;
+  std::unordered_map<Tuple, int, boost::hash<Tuple>> literal_to_id;
+  auto get_literal_id = [&](const Tuple& literal) {
+    const auto it = literal_to_id.emplace(literal, literals.size());
+    if (it.second) {
+      literals.push_back(literal);
+    }
+    return it.first->second;
+  };
+  std::vector<GroundRule> ground_rules;
+  for (const auto& fact : facts) {
+    if (!exact_relations.count(fact.front())) {
+      // Facts are rules without body
+      ground_rules.push_back(GroundRule{get_literal_id(fact), {}, {}});
+    }
+  }
+  auto unsafe_rule_count = 0;
+  Tuple head;
+  Tuple literal;
+  for (const auto rule : dynamic_rules) {
+    auto instantiate = [&](const Bindings& bindings) {
+      if (!Substitute(rule->head, bindings, head)) {
+        ++unsafe_rule_count;
+        return;
+      }
+      for (const auto& pattern : rule->negatives) {
+        if (!Substitute(pattern, bindings, literal)) {
+          ++unsafe_rule_count;
+          return;
+        }
+      }
+      GroundRule ground_rule;
+      ground_rule.head = get_literal_id(head);
+      for (const auto& pattern : rule->positives) {
+        if (!exact_relations.count(pattern.front())) {
+          Substitute(pattern, bindings, literal);
+          ground_rule.positive_body.push_back(get_literal_id(literal));
+        }
+      }
+      for (const auto& pattern : rule->negatives) {
+        if (exact_relations.count(pattern.front())) {
+          // Checked by enumerator
+          continue;
+        }
+        Substitute(pattern, bindings, literal);
+        if (!database.Contains(literal)) {
+          // Never derived, thus its negation always holds
+          continue;
+        }
+        ground_rule.negative_body.push_back(get_literal_id(literal));
+      }
+      ground_rules.push_back(ground_rule);
+      if (static_cast<int>(ground_rules.size()) > max_rule_count) {
+        throw std::runtime_error("Grounding produced more than " + std::to_string(max_rule_count) + " rules.");
+      }
+    };
+    Enumerator(*rule, database, exact_relations, budget).Run(instantiate);
+  }
+  if (unsafe_rule_count > 0) {
+    std::cout << "Note: " << unsafe_rule_count << " unsafe rule instances are ignored." << std::endl;
+  }
+
+  // Keep the rules which reserved relations depend on
+  std::vector<std::vector<int>> head_to_rules(literals.size());
+  for (auto i = 0; i < static_cast<int>(ground_rules.size()); ++i) {
+    head_to_rules[ground_rules[i].head].push_back(i);
+  }
+  std::vector<bool> is_needed(literals.size(), false);
+  std::vector<int> stack;
+  for (auto i = 0; i < static_cast<int>(literals.size()); ++i) {
+    if (kRootRelations.count(game.AtomToString(literals[i].front()))) {
+      is_needed[i] = true;
+      stack.push_back(i);
+    }
+  }
+  while (!stack.empty()) {
+    const auto literal_id = stack.back();
+    stack.pop_back();
+    for (const auto rule_idx : head_to_rules[literal_id]) {
+      const auto& rule = ground_rules[rule_idx];
+      for (const auto& body : {std::cref(rule.positive_body), std::cref(rule.negative_body)}) {
+        for (const auto body_literal_id : body.get()) {
+          if (!is_needed[body_literal_id]) {
+            is_needed[body_literal_id] = true;
+            stack.push_back(body_literal_id);
+          }
+        }
+      }
+    }
+  }
+
+  // Renumber literals: facts, actions, then the others
+  GroundProgram program;
+  std::vector<int> new_ids(literals.size(), -1);
+  auto add_literal = [&](const Tuple& literal) {
+    const auto it = literal_to_id.find(literal);
+    if (it != literal_to_id.end() && new_ids[it->second] >= 0) {
+      return new_ids[it->second];
+    }
+    const int new_id = program.literals.size();
+    program.literals.push_back(literal);
+    if (it != literal_to_id.end()) {
+      new_ids[it->second] = new_id;
+    }
+    return new_id;
+  };
+  std::unordered_map<Fact, int, boost::hash<Fact>> fact_to_id;
+  if (const auto true_table = database.Find(inserter.GetTrueAtom())) {
+    for (const auto& true_literal : true_table->tuples) {
+      const auto args = SplitArgs(true_literal);
+      assert(args.size() == 1);
+      fact_to_id.emplace(args.front(), program.facts.size());
+      program.facts.push_back(args.front());
+      program.true_literals.push_back(add_literal(true_literal));
+    }
+  }
+  program.next_literals.assign(program.facts.size(), -1);
+  const auto role_count = game.roles.size();
+  std::vector<std::unordered_map<Action, int, boost::hash<Action>>> action_to_ids(role_count);
+  program.actions.resize(role_count);
+  program.does_literals.resize(role_count);
+  program.legal_literals.resize(role_count);
+  program.goal_literals.resize(role_count);
+  if (const auto does_table = database.Find(inserter.GetDoesAtom())) {
+    for (const auto& does_literal : does_table->tuples) {
+      const auto args = SplitArgs(does_literal);
+      assert(args.size() == 2 && args.front().size() == 1);
+      const auto role_it = game.atom_to_role_index.find(args.front().front());
+      if (role_it == game.atom_to_role_index.end()) {
+        continue;
+      }
+      const auto role_idx = role_it->second;
+      action_to_ids[role_idx].emplace(args.back(), program.actions[role_idx].size());
+      program.actions[role_idx].push_back(args.back());
+      program.does_literals[role_idx].push_back(add_literal(does_literal));
+    }
+  }
+  for (auto role_idx = 0; role_idx < static_cast<int>(role_count); ++role_idx) {
+    program.legal_literals[role_idx].assign(program.actions[role_idx].size(), -1);
+  }
+  for (const auto& rule : ground_rules) {
+    if (!is_needed[rule.head]) {
+      continue;
+    }
+    GroundRule new_rule;
+    new_rule.head = add_literal(literals[rule.head]);
+    for (const auto literal_id : rule.positive_body) {
+      new_rule.positive_body.push_back(add_literal(literals[literal_id]));
+    }
+    for (const auto literal_id : rule.negative_body) {
+      new_rule.negative_body.push_back(add_literal(literals[literal_id]));
+    }
+    program.rules.push_back(new_rule);
+  }
+
+  // Literals of reserved relations
+  for (auto i = 0; i < static_cast<int>(program.literals.size()); ++i) {
+    const auto& literal = program.literals[i];
+    const auto& relation = game.AtomToString(literal.front());
+    if (relation == "next") {
+      const auto args = SplitArgs(literal);
+      assert(args.size() == 1);
+      program.next_literals.at(fact_to_id.at(args.front())) = i;
+    } else if (relation == "legal") {
+      const auto args = SplitArgs(literal);
+      assert(args.size() == 2 && args.front().size() == 1);
+      const auto role_it = game.atom_to_role_index.find(args.front().front());
+      if (role_it == game.atom_to_role_index.end()) {
+        continue;
+      }
+      const auto role_idx = role_it->second;
+      program.legal_literals[role_idx].at(action_to_ids[role_idx].at(args.back())) = i;
+    } else if (relation == "goal") {
+      assert(literal.size() == 3);
+      const auto role_it = game.atom_to_role_index.find(literal[1]);
+      if (role_it == game.atom_to_role_index.end()) {
+        continue;
+      }
+      program.goal_literals[role_it->second].emplace_back(i, game.atom_to_goal_values.at(literal[2]));
+    } else if (relation == "terminal") {
+      program.terminal_literal = i;
+    }
+  }
+  std::cout << "Grounded " << program.rules.size() << " rules (estimated " <<
+      static_cast<long long>(estimate) << ")." << std::endl;
+  return program;
+}
+
+void WriteGroundProgram(std::ostream& os, const GroundProgram& program) {
+  auto write_ints = [&](const std::vector<int>& ints) {
+    os << ints.size();
+    for (const auto i : ints) {
+      os << ' ' << i;
+    }
+    os << '\n';
+  };
+  os << kGroundProgramHeader << ' ' << kGroundProgramVersion << '\n';
+  os << program.literals.size() << '\n';
+  for (const auto& literal : program.literals) {
+    write_ints(literal);
+  }
+  os << program.rules.size() << '\n';
+  for (const auto& rule : program.rules) {
+    os << rule.head << '\n';
+    write_ints(rule.positive_body);
+    write_ints(rule.negative_body);
+  }
+  os << program.facts.size() << '\n';
+  for (auto i = 0; i < static_cast<int>(program.facts.size()); ++i) {
+    write_ints(program.facts[i]);
+    os << program.true_literals[i] << ' ' << program.next_literals[i] << '\n';
+  }
+  os << program.actions.size() << '\n';
+  for (auto role_idx = 0; role_idx < static_cast<int>(program.actions.size()); ++role_idx) {
+    os << program.actions[role_idx].size() << '\n';
+    for (auto i = 0; i < static_cast<int>(program.actions[role_idx].size()); ++i) {
+      write_ints(program.actions[role_idx][i]);
+      os << program.does_literals[role_idx][i] << ' ' << program.legal_literals[role_idx][i] << '\n';
+    }
+    os << program.goal_literals[role_idx].size();
+    for (const auto& entry : program.goal_literals[role_idx]) {
+      os << ' ' << entry.first << ' ' << entry.second;
+    }
+    os << '\n';
+  }
+  os << program.terminal_literal << '\n';
+}
+
+GroundProgram ReadGroundProgram(std::istream& is) {
+  auto read_int = [&]() {
+    int i;
+    if (!(is >> i)) {
+      throw std::runtime_error("Invalid ground program.");
+    }
+    return i;
+  };
+  auto read_ints = [&]() {
+    std::vector<int> ints(read_int());
+    for (auto& i : ints) {
+      i = read_int();
+    }
+    return ints;
+  };
+  std::string header;
+  is >> header;
+  if (header != kGroundProgramHeader || read_int() != kGroundProgramVersion) {
+    throw std::runtime_error("Invalid ground program header.");
+  }
+  GroundProgram program;
+  program.literals.resize(read_int());
+  for (auto& literal : program.literals) {
+    literal = read_ints();
+  }
+  program.rules.resize(read_int());
+  for (auto& rule : program.rules) {
+    rule.head = read_int();
+    rule.positive_body = read_ints();
+    rule.negative_body = read_ints();
+  }
+  const auto fact_count = read_int();
+  for (auto i = 0; i < fact_count; ++i) {
+    program.facts.push_back(read_ints());
+    program.true_literals.push_back(read_int());
+    program.next_literals.push_back(read_int());
+  }
+  const auto role_count = read_int();
+  program.actions.resize(role_count);
+  program.does_literals.resize(role_count);
+  program.legal_literals.resize(role_count);
+  program.goal_literals.resize(role_count);
+  for (auto role_idx = 0; role_idx < role_count; ++role_idx) {
+    const auto action_count = read_int();
+    for (auto i = 0; i < action_count; ++i) {
+      program.actions[role_idx].push_back(read_ints());
+      program.does_literals[role_idx].push_back(read_int());
+      program.legal_literals[role_idx].push_back(read_int());
+    }
+    const auto goal_count = read_int();
+    for (auto i = 0; i < goal_count; ++i) {
+      const auto literal_id = read_int();
+      program.goal_literals[role_idx].emplace_back(literal_id, read_int());
+    }
+  }
+  program.terminal_literal = read_int();
+  return program;
+}
+
+}
+}
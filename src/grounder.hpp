@@ -0,0 +1,100 @@
+#ifndef GROUNDER_HPP_
+#define GROUNDER_HPP_
+
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "ggpe.hpp"
+#include "sexpr_parser.hpp"
+#include "game_data.hpp"
+
+namespace ggpe {
+namespace grounder {
+
+/**
+ * A rule whose literals are fully instantiated, referred by literal ids
+ */
+struct GroundRule {
+  int head;
+  std::vector<int> positive_body;
+  std::vector<int> negative_body;
+};
+
+/**
+ * Ground rules of a game.
+ *
+ * Each literal is a tuple of a relation and its arguments, e.g.
+ * (true (cell 1 1 b)) -> [true, (, cell, 1, 1, b, )], and is referred by its
+ * index in literals. Static relations are evaluated while grounding, thus
+ * only rules which 'next', 'legal', 'goal' and 'terminal' depend on are left.
+ * Facts and actions get integer ids too, and the literals of reserved
+ * relations are listed by their ids.
+ *
+ * Note: atoms are those of the game the program was grounded from.
+ */
+struct GroundProgram {
+  std::vector<Tuple> literals;
+  std::vector<GroundRule> rules;
+  // Fact id -> fact, its 'true' literal and its 'next' literal (or -1)
+  std::vector<Fact> facts;
+  std::vector<int> true_literals;
+  std::vector<int> next_literals;
+  // Action id -> action, its 'does' literal and its 'legal' literal (or -1)
+  // for each role
+  std::vector<std::vector<Action>> actions;
+  std::vector<std::vector<int>> does_literals;
+  std::vector<std::vector<int>> legal_literals;
+  // Pairs of 'goal' literal and goal value for each role
+  std::vector<std::vector<std::pair<int, int>>> goal_literals;
+  // 'terminal' literal, or -1
+  int terminal_literal = -1;
+};
+
+constexpr int kDefaultMaxRuleCount = 1000000;
+
+/**
+ * Instantiate the rules of a game.
+ *
+ * Static relations (which depend on neither 'true' nor 'does') are evaluated
+ * exactly, stratum by stratum. Tuples of the other relations that can
+ * possibly be derived are computed by a fixpoint iteration that ignores their
+ * negations: 'true' is seeded with initial and possible facts and 'does' with
+ * possible actions, 'true' also receives every argument of 'next' and 'does'
+ * every pair of 'legal'. Rules are then instantiated over these tuples,
+ * picking each literal by the size of the matching index bucket.
+ *
+ * Grounding bails out with std::runtime_error if the number of rules is
+ * estimated (from the sizes of argument domains) or turns out to exceed
+ * max_rule_count.
+ */
+GroundProgram Ground(
+    const std::vector<sexpr_parser::TreeNode>& nodes,
+    const GameData& game,
+    const int max_rule_count=kDefaultMaxRuleCount);
+
+/**
+ * Serialize a ground program in a text format
+ */
+void WriteGroundProgram(std::ostream& os, const GroundProgram& program);
+
+/**
+ * Deserialize a ground program written by WriteGroundProgram
+ * @throw std::runtime_error if the format is invalid
+ */
+GroundProgram ReadGroundProgram(std::istream& is);
+
+/**
+ * @return the arguments of a literal (compound arguments without parens)
+ */
+std::vector<Tuple> SplitArgs(const Tuple& literal);
+
+/**
+ * Convert: arguments -> literal of a given relation
+ */
+Tuple ArgsToLiteral(const Atom relation, const std::vector<Tuple>& args);
+
+}
+}
+
+#endif /* GROUNDER_HPP_ */
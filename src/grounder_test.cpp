@@ -0,0 +1,74 @@
+#include "gtest/gtest.h"
+#include "grounder.hpp"
+
+#include <sstream>
+#include "file_utils.hpp"
+#include "yap_engine.hpp"
+
+namespace ggpe {
+namespace grounder {
+
+namespace {
+const auto tictactoe_filename = "kif/tictactoe.kif";
+
+GameDataSp CreateGameData(const std::string& kif_filename) {
+  const auto game = std::make_shared<GameData>();
+  game->kif = file_utils::LoadStringFromFile(kif_filename);
+  game->name = "tmp";
+  yap::InitializeYapEngine(game);
+  return game;
+}
+}
+
+TEST(Ground, TicTacToe) {
+  const auto game = CreateGameData(tictactoe_filename);
+  const auto program = Ground(sexpr_parser::ParseKIF(game->kif), *game);
+  // (cell ?m ?n ?x) for 3 * 3 * 3 and (control ?r) for 2
+  ASSERT_EQ(program.facts.size(), 29);
+  ASSERT_EQ(program.true_literals.size(), 29);
+  ASSERT_EQ(program.next_literals.size(), 29);
+  ASSERT_EQ(program.actions.size(), 2);
+  for (auto role_idx = 0; role_idx < 2; ++role_idx) {
+    // (mark ?m ?n) for 3 * 3 and noop
+    ASSERT_EQ(program.actions[role_idx].size(), 10);
+    for (const auto legal_literal : program.legal_literals[role_idx]) {
+      ASSERT_GE(legal_literal, 0);
+    }
+    ASSERT_FALSE(program.goal_literals[role_idx].empty());
+  }
+  ASSERT_GE(program.terminal_literal, 0);
+  for (const auto& rule : program.rules) {
+    ASSERT_LT(rule.head, program.literals.size());
+  }
+}
+
+TEST(Ground, BailOut) {
+  const auto game = CreateGameData(tictactoe_filename);
+  ASSERT_THROW(Ground(sexpr_parser::ParseKIF(game->kif), *game, 10), std::runtime_error);
+}
+
+TEST(WriteGroundProgram, TicTacToe) {
+  const auto game = CreateGameData(tictactoe_filename);
+  const auto program = Ground(sexpr_parser::ParseKIF(game->kif), *game);
+  std::stringstream ss;
+  WriteGroundProgram(ss, program);
+  const auto read_program = ReadGroundProgram(ss);
+  ASSERT_EQ(read_program.literals, program.literals);
+  ASSERT_EQ(read_program.rules.size(), program.rules.size());
+  for (auto i = 0; i < static_cast<int>(program.rules.size()); ++i) {
+    ASSERT_EQ(read_program.rules[i].head, program.rules[i].head);
+    ASSERT_EQ(read_program.rules[i].positive_body, program.rules[i].positive_body);
+    ASSERT_EQ(read_program.rules[i].negative_body, program.rules[i].negative_body);
+  }
+  ASSERT_EQ(read_program.facts, program.facts);
+  ASSERT_EQ(read_program.next_literals, program.next_literals);
+  ASSERT_EQ(read_program.actions, program.actions);
+  ASSERT_EQ(read_program.legal_literals, program.legal_literals);
+  ASSERT_EQ(read_program.goal_literals, program.goal_literals);
+  ASSERT_EQ(read_program.terminal_literal, program.terminal_literal);
+  std::stringstream invalid("ggpe-ground-program 0");
+  ASSERT_THROW(ReadGroundProgram(invalid), std::runtime_error);
+}
+
+}
+}
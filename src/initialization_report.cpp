@@ -0,0 +1,71 @@
+#include "initialization_report.hpp"
+
+#include <chrono>
+#include <fstream>
+
+#include <boost/format.hpp>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
+
+namespace ggpe {
+
+namespace {
+
+/**
+ * @return current resident memory of the process in bytes, or 0 if unknown
+ */
+std::size_t GetResidentMemory() {
+#ifdef __APPLE__
+  mach_task_basic_info info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO,
+      reinterpret_cast<task_info_t>(&info), &count) != KERN_SUCCESS) {
+    return 0;
+  }
+  return info.resident_size;
+#else
+  // The second field is the number of resident pages
+  std::ifstream ifs("/proc/self/statm");
+  std::size_t size = 0;
+  std::size_t resident = 0;
+  if (!(ifs >> size >> resident)) {
+    return 0;
+  }
+  return resident * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+}
+
+InitializationPhase MeasurePhase(
+    const std::string& name,
+    const std::function<void()>& phase,
+    const bool is_concurrent) {
+  InitializationPhase result;
+  result.name = name;
+  result.is_concurrent = is_concurrent;
+  result.start_memory = GetResidentMemory();
+  const auto begin = std::chrono::steady_clock::now();
+  phase();
+  result.wall_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  result.end_memory = GetResidentMemory();
+  return result;
+}
+
+std::string InitializationReportToString(const InitializationReport& report) {
+  std::string str;
+  for (const auto& phase : report) {
+    const auto megabytes = [](const double bytes) { return bytes / (1024.0 * 1024.0); };
+    str += (boost::format("%1$-32s %2$10.3fs %3$10.1fMB %4$+10.1fMB%5%\n") %
+        phase.name %
+        phase.wall_time %
+        megabytes(phase.end_memory) %
+        megabytes(static_cast<double>(phase.end_memory) - phase.start_memory) %
+        (phase.is_concurrent ? " (concurrent)" : "")).str();
+  }
+  return str;
+}
+
+}
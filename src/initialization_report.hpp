@@ -0,0 +1,28 @@
+#ifndef INITIALIZATION_REPORT_HPP_
+#define INITIALIZATION_REPORT_HPP_
+
+#include <functional>
+#include <string>
+
+#include "ggpe.hpp"
+
+namespace ggpe {
+
+/**
+ * Run a phase of initialization, measuring its wall time and the resident
+ * memory of the process before and after it
+ */
+InitializationPhase MeasurePhase(
+    const std::string& name,
+    const std::function<void()>& phase,
+    const bool is_concurrent=false);
+
+/**
+ * @return a table of phases with their wall time, resident memory at the end
+ * and its change, one line per phase
+ */
+std::string InitializationReportToString(const InitializationReport& report);
+
+}
+
+#endif /* INITIALIZATION_REPORT_HPP_ */
@@ -0,0 +1,38 @@
+#include "gtest/gtest.h"
+#include "initialization_report.hpp"
+
+#include <algorithm>
+#include <thread>
+
+namespace ggpe {
+
+TEST(MeasurePhase, Test) {
+  auto is_run = false;
+  const auto phase = MeasurePhase("sleep", [&]{
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    is_run = true;
+  });
+  ASSERT_TRUE(is_run);
+  ASSERT_EQ(phase.name, "sleep");
+  ASSERT_GE(phase.wall_time, 0.01);
+  ASSERT_GT(phase.start_memory, 0);
+  ASSERT_GT(phase.end_memory, 0);
+  ASSERT_FALSE(phase.is_concurrent);
+  const auto str = InitializationReportToString({phase, phase});
+  ASSERT_EQ(std::count(str.begin(), str.end(), '\n'), 2);
+  ASSERT_EQ(str.find("sleep"), 0);
+  ASSERT_EQ(str.find("concurrent"), std::string::npos);
+}
+
+TEST(MeasurePhase, Memory) {
+  std::vector<char> buffer;
+  const auto phase = MeasurePhase("allocate", [&]{
+    buffer.assign(64 * 1024 * 1024, 1);
+  }, true);
+  // Pages written in the phase are resident at its end
+  ASSERT_GE(phase.end_memory, phase.start_memory + 32 * 1024 * 1024);
+  ASSERT_TRUE(phase.is_concurrent);
+  ASSERT_NE(InitializationReportToString({phase}).find("(concurrent)"), std::string::npos);
+}
+
+}
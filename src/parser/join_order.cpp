@@ -0,0 +1,219 @@
+#include "join_order.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace sexpr_parser {
+
+namespace {
+
+// Estimates for relations derived by rules, whose sizes are unknown before
+// evaluation
+constexpr auto kUnknownSize = 100.0;
+constexpr auto kUnknownDomainSize = 10.0;
+
+bool IsFilter(const TreeNode& literal) {
+  return !literal.IsLeaf() &&
+      (literal.GetFunctor() == "not" || literal.GetFunctor() == "distinct");
+}
+
+/**
+ * Find the key of statistics and the tuple whose arguments are counted
+ * @return false if the statistics cannot be found by the key
+ */
+bool GetKeyAndTuple(const TreeNode& literal, std::string& key, const TreeNode*& tuple) {
+  const auto& functor = literal.GetFunctor();
+  if (functor == "true" && !literal.IsLeaf() && literal.GetChildren().size() == 2) {
+    // Facts are distinguished by their relations
+    const auto& fact = literal.GetChildren()[1];
+    if (fact.IsVariable()) {
+      return false;
+    }
+    key = "true " + fact.GetFunctor();
+    tuple = &fact;
+  } else {
+    key = functor;
+    tuple = &literal;
+  }
+  return true;
+}
+
+bool AreAllVariablesBound(
+    const TreeNode& node,
+    const std::unordered_set<std::string>& bound_variables) {
+  std::unordered_set<std::string> unbound_variables;
+  node.CollectVariables(bound_variables, unbound_variables);
+  return unbound_variables.empty();
+}
+
+}
+
+SelectivityEstimator::SelectivityEstimator(const std::vector<TreeNode>& nodes) :
+    graph_(nodes) {
+  std::unordered_map<std::string, Statistics> init_statistics;
+  for (const auto& node : nodes) {
+    if (node.IsImplication()) {
+      derived_relations_.insert(node.GetChildren().at(1).GetFunctor());
+      continue;
+    }
+    const auto& functor = node.GetFunctor();
+    if ((functor == "base" || functor == "init") && !node.IsLeaf() &&
+        node.GetChildren().size() == 2) {
+      const auto& fact = node.GetChildren()[1];
+      AddFact("true " + fact.GetFunctor(), fact,
+          functor == "base" ? statistics_ : init_statistics);
+    } else {
+      if (functor == "role" && !node.IsLeaf() && node.GetChildren().size() == 2) {
+        // Each role does exactly one action
+        AddFact("does", node, statistics_);
+      }
+      AddFact(functor, node, statistics_);
+    }
+  }
+  // 'init' facts give a lower bound of the facts of a relation without 'base'
+  for (const auto& pair : init_statistics) {
+    statistics_.insert(pair);
+  }
+}
+
+void SelectivityEstimator::AddFact(
+    const std::string& key,
+    const TreeNode& tuple,
+    std::unordered_map<std::string, Statistics>& statistics) {
+  auto& relation_statistics = statistics[key];
+  ++relation_statistics.size;
+  if (tuple.IsLeaf()) {
+    return;
+  }
+  const auto& args = tuple.GetChildren();
+  relation_statistics.domains.resize(
+      std::max(relation_statistics.domains.size(), args.size() - 1));
+  for (auto i = 1u; i < args.size(); ++i) {
+    relation_statistics.domains[i - 1].insert(args[i].ToSexpr());
+  }
+}
+
+double SelectivityEstimator::Estimate(
+    const TreeNode& literal,
+    const std::unordered_set<std::string>& bound_variables) const {
+  assert(!IsFilter(literal));
+  if (!literal.IsLeaf() && literal.GetFunctor() == "or") {
+    auto estimate = 0.0;
+    const auto& children = literal.GetChildren();
+    for (auto i = children.begin() + 1; i != children.end(); ++i) {
+      estimate += IsFilter(*i) ? 1.0 : Estimate(*i, bound_variables);
+    }
+    return estimate;
+  }
+  std::string key;
+  const TreeNode* tuple = nullptr;
+  const auto has_key = GetKeyAndTuple(literal, key, tuple);
+  const Statistics* statistics = nullptr;
+  if (has_key && !derived_relations_.count(literal.GetFunctor())) {
+    const auto it = statistics_.find(key);
+    if (it != statistics_.end()) {
+      statistics = &it->second;
+    } else if (literal.GetFunctor() != "true" && literal.GetFunctor() != "does") {
+      // Relation without facts or rules
+      return 0.0;
+    }
+  }
+  auto estimate = statistics ? statistics->size : kUnknownSize;
+  if (!tuple || tuple->IsLeaf()) {
+    return estimate;
+  }
+  const auto& args = tuple->GetChildren();
+  for (auto i = 1u; i < args.size(); ++i) {
+    if (!AreAllVariablesBound(args[i], bound_variables)) {
+      continue;
+    }
+    if (statistics) {
+      if (i - 1 < statistics->domains.size() && !statistics->domains[i - 1].empty()) {
+        estimate /= statistics->domains[i - 1].size();
+      }
+    } else {
+      estimate /= kUnknownDomainSize;
+    }
+  }
+  return estimate;
+}
+
+bool SelectivityEstimator::IsRecursive(const TreeNode& literal, const int component_idx) const {
+  if (!literal.IsLeaf() && (literal.GetFunctor() == "or" || literal.GetFunctor() == "not")) {
+    const auto& children = literal.GetChildren();
+    return std::any_of(children.begin() + 1, children.end(), [&](const TreeNode& child) {
+      return IsRecursive(child, component_idx);
+    });
+  }
+  const auto relation_idx = graph_.GetRelationIndex(literal.GetFunctor());
+  return relation_idx >= 0 && graph_.GetComponentIndex(relation_idx) == component_idx;
+}
+
+TreeNode SelectivityEstimator::ReorderBody(const TreeNode& rule) const {
+  assert(rule.IsImplication());
+  const auto& children = rule.GetChildren();
+  const auto head_idx = graph_.GetRelationIndex(children.at(1).GetFunctor());
+  assert(head_idx >= 0);
+  const auto component_idx = graph_.GetComponentIndex(head_idx);
+  std::vector<TreeNode> remaining(children.begin() + 2, children.end());
+  std::vector<TreeNode> reordered(children.begin(), children.begin() + 2);
+  std::unordered_set<std::string> bound_variables;
+  while (!remaining.empty()) {
+    // Filters are placed first once they can be checked
+    const auto filter_it = std::find_if(remaining.begin(), remaining.end(), [&](const TreeNode& literal) {
+      return IsFilter(literal) && AreAllVariablesBound(literal, bound_variables);
+    });
+    if (filter_it != remaining.end()) {
+      reordered.push_back(*filter_it);
+      remaining.erase(filter_it);
+      continue;
+    }
+    auto best_it = remaining.end();
+    auto best_estimate = 0.0;
+    for (auto it = remaining.begin(); it != remaining.end(); ++it) {
+      if (IsFilter(*it)) {
+        continue;
+      }
+      if (IsRecursive(*it, component_idx)) {
+        // Do not let recursive literals overtake, which could loop forever
+        const auto overtakes = std::any_of(remaining.begin(), it, [](const TreeNode& literal) {
+          return !IsFilter(literal);
+        });
+        if (overtakes) {
+          continue;
+        }
+      }
+      const auto estimate = Estimate(*it, bound_variables);
+      if (best_it == remaining.end() || estimate < best_estimate) {
+        best_it = it;
+        best_estimate = estimate;
+      }
+    }
+    if (best_it == remaining.end()) {
+      // Only filters with unbound variables remain
+      reordered.insert(reordered.end(), remaining.begin(), remaining.end());
+      break;
+    }
+    std::unordered_set<std::string> unbound_variables;
+    best_it->CollectBoundAndUnboundVariables(bound_variables, unbound_variables);
+    reordered.push_back(*best_it);
+    remaining.erase(best_it);
+  }
+  return TreeNode(reordered);
+}
+
+std::vector<TreeNode> ReorderBodiesBySelectivity(const std::vector<TreeNode>& nodes) {
+  const SelectivityEstimator estimator(nodes);
+  std::vector<TreeNode> reordered_nodes;
+  reordered_nodes.reserve(nodes.size());
+  for (const auto& node : nodes) {
+    if (node.IsImplication()) {
+      reordered_nodes.push_back(estimator.ReorderBody(node));
+    } else {
+      reordered_nodes.push_back(node);
+    }
+  }
+  return reordered_nodes;
+}
+
+}
@@ -0,0 +1,56 @@
+#include "gtest/gtest.h"
+#include "join_order.hpp"
+#include "file_utils.hpp"
+
+#include <algorithm>
+
+namespace sexpr_parser {
+
+namespace {
+
+const auto kTicTacToeKIF = file_utils::LoadStringFromFile("kif/tictactoe.kif");
+
+}
+
+TEST(SelectivityEstimator, Estimate) {
+  const SelectivityEstimator estimator(Parse(
+      "(succ 1 2) (succ 2 3) (succ 3 4) (succ 4 5) (index 1) (index 2) "
+      "(base (cell 1 1 b)) (base (cell 1 2 b)) (base (cell 2 1 x)) (base (cell 2 2 o)) "
+      "(<= (derived ?x) (index ?x))"));
+  const auto literals = Parse("(succ ?x ?y) (true (cell ?x ?y b)) (derived ?x) (undefined ?x)");
+  ASSERT_DOUBLE_EQ(estimator.Estimate(literals[0], {}), 4.0);
+  ASSERT_DOUBLE_EQ(estimator.Estimate(literals[0], {"?x"}), 1.0);
+  // 'b' is bound and there are three values in the domain
+  ASSERT_DOUBLE_EQ(estimator.Estimate(literals[1], {}), 4.0 / 3.0);
+  ASSERT_DOUBLE_EQ(estimator.Estimate(literals[1], {"?x", "?y"}), 4.0 / 12.0);
+  ASSERT_GT(estimator.Estimate(literals[2], {}), estimator.Estimate(literals[2], {"?x"}));
+  ASSERT_DOUBLE_EQ(estimator.Estimate(literals[3], {}), 0.0);
+}
+
+TEST(SelectivityEstimator, ReorderBody) {
+  const auto nodes = Parse(
+      "(index 1) (index 2) (index 3) (succ 1 2) (succ 2 3) "
+      "(<= (a ?x ?y) (not (index ?y)) (index ?x) (distinct ?x 1) (succ ?x ?y))");
+  const SelectivityEstimator estimator(nodes);
+  const auto answer = Parse(
+      "(<= (a ?x ?y) (succ ?x ?y) (not (index ?y)) (distinct ?x 1) (index ?x))").front();
+  ASSERT_EQ(estimator.ReorderBody(nodes.back()), answer);
+}
+
+TEST(SelectivityEstimator, Recursion) {
+  const auto nodes = Parse(
+      "(edge 1 2) (edge 2 3) (edge 3 4) (edge 4 5) "
+      "(<= (reach ?x ?y) (edge ?x ?y)) "
+      "(<= (reach ?x ?y) (edge ?x ?z) (reach ?z ?y))");
+  const SelectivityEstimator estimator(nodes);
+  ASSERT_EQ(estimator.ReorderBody(nodes.back()), nodes.back());
+}
+
+TEST(ReorderBodiesBySelectivity, TicTacToe) {
+  const auto nodes = ReorderBodiesBySelectivity(ParseKIF(kTicTacToeKIF));
+  const auto answer = Parse(
+      "(<= (legal ?w (mark ?x ?y)) (true (control ?w)) (true (cell ?x ?y b)))").front();
+  ASSERT_TRUE(std::find(nodes.begin(), nodes.end(), answer) != nodes.end());
+}
+
+}
@@ -0,0 +1,493 @@
+#include "optimizer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "rule_graph.hpp"
+
+namespace sexpr_parser {
+
+namespace {
+
+const std::unordered_set<std::string> kReservedRelations = {
+  "role",
+  "init",
+  "true",
+  "does",
+  "legal",
+  "next",
+  "goal",
+  "terminal",
+  "input",
+  "base",
+  "or",
+  "not",
+  "distinct"
+};
+
+// Relations whose rules are always kept
+const std::unordered_set<std::string> kRootRelations = {
+  "role",
+  "init",
+  "legal",
+  "next",
+  "goal",
+  "terminal",
+  "input",
+  "base"
+};
+
+// Relations which hold without facts or rules
+const std::unordered_set<std::string> kBuiltinRelations = {
+  "true",
+  "does",
+  "distinct"
+};
+
+using Substitution = std::unordered_map<std::string, TreeNode>;
+
+const TreeNode& Resolve(const TreeNode& term, const Substitution& substitution) {
+  auto resolved = &term;
+  while (resolved->IsVariable()) {
+    const auto it = substitution.find(resolved->GetValue());
+    if (it == substitution.end()) {
+      break;
+    }
+    resolved = &it->second;
+  }
+  return *resolved;
+}
+
+TreeNode Substitute(const TreeNode& term, const Substitution& substitution) {
+  const auto& resolved = Resolve(term, substitution);
+  if (resolved.IsLeaf()) {
+    return resolved;
+  }
+  std::vector<TreeNode> children;
+  children.reserve(resolved.GetChildren().size());
+  for (const auto& child : resolved.GetChildren()) {
+    children.push_back(Substitute(child, substitution));
+  }
+  return TreeNode(children);
+}
+
+bool Unify(const TreeNode& a, const TreeNode& b, Substitution& substitution) {
+  const auto& resolved_a = Resolve(a, substitution);
+  const auto& resolved_b = Resolve(b, substitution);
+  if (resolved_a.IsVariable()) {
+    if (!(resolved_b.IsVariable() && resolved_b.GetValue() == resolved_a.GetValue())) {
+      substitution.emplace(resolved_a.GetValue(), resolved_b);
+    }
+    return true;
+  }
+  if (resolved_b.IsVariable()) {
+    substitution.emplace(resolved_b.GetValue(), resolved_a);
+    return true;
+  }
+  if (resolved_a.IsLeaf() || resolved_b.IsLeaf()) {
+    return resolved_a.IsLeaf() && resolved_b.IsLeaf() &&
+        resolved_a.GetValue() == resolved_b.GetValue();
+  }
+  const auto& children_a = resolved_a.GetChildren();
+  const auto& children_b = resolved_b.GetChildren();
+  if (children_a.size() != children_b.size()) {
+    return false;
+  }
+  for (auto i = 0u; i < children_a.size(); ++i) {
+    if (!Unify(children_a[i], children_b[i], substitution)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool IsGround(const TreeNode& node) {
+  std::unordered_set<std::string> variables;
+  node.CollectVariables(std::unordered_set<std::string>(), variables);
+  return variables.empty();
+}
+
+/**
+ * @return a fact if the body is empty and the head is ground, otherwise a rule
+ */
+TreeNode MakeRule(const TreeNode& head, const std::vector<TreeNode>& body) {
+  if (body.empty() && IsGround(head)) {
+    return head;
+  }
+  std::vector<TreeNode> children = {TreeNode("<="), head};
+  children.insert(children.end(), body.begin(), body.end());
+  return TreeNode(children);
+}
+
+class StaticLiteralEvaluator {
+public:
+  explicit StaticLiteralEvaluator(const std::vector<TreeNode>& nodes) {
+    std::unordered_set<std::string> non_static_relations(
+        kReservedRelations.begin(), kReservedRelations.end());
+    for (const auto& node : nodes) {
+      if (node.IsImplication()) {
+        non_static_relations.insert(node.GetChildren().at(1).GetFunctor());
+      } else if (!IsGround(node)) {
+        non_static_relations.insert(node.GetFunctor());
+      } else {
+        facts_[node.GetFunctor()].push_back(node);
+      }
+    }
+    for (const auto& relation : non_static_relations) {
+      facts_.erase(relation);
+    }
+  }
+
+  /**
+   * @return false if the rule never holds
+   */
+  bool Evaluate(const TreeNode& rule, TreeNode& output) const {
+    assert(rule.IsImplication());
+    const auto& children = rule.GetChildren();
+    auto head = children.at(1);
+    std::vector<TreeNode> body(children.begin() + 2, children.end());
+    for (auto i = 0u; i < body.size();) {
+      const auto& literal = body[i];
+      std::vector<Substitution> matches;
+      if (!EvaluateLiteral(literal, matches)) {
+        ++i;
+      } else if (matches.empty()) {
+        return false;
+      } else if (matches.size() == 1) {
+        body.erase(body.begin() + i);
+        head = Substitute(head, matches.front());
+        for (auto& substituted_literal : body) {
+          substituted_literal = Substitute(substituted_literal, matches.front());
+        }
+        // Substituted literals may be evaluated now
+        i = 0;
+      } else {
+        ++i;
+      }
+    }
+    output = MakeRule(head, body);
+    return true;
+  }
+
+private:
+  bool IsStatic(const TreeNode& literal) const {
+    return facts_.count(literal.GetFunctor());
+  }
+
+  /**
+   * Find substitutions of the facts matched with a literal
+   * @return false if the literal cannot be evaluated statically
+   */
+  bool EvaluateLiteral(const TreeNode& literal, std::vector<Substitution>& matches) const {
+    const auto& functor = literal.GetFunctor();
+    if (functor == "distinct" && !literal.IsLeaf()) {
+      if (!IsGround(literal)) {
+        return false;
+      }
+      const auto& children = literal.GetChildren();
+      if (children.size() == 3 && !(children[1] == children[2])) {
+        matches.emplace_back();
+      }
+      return true;
+    } else if (functor == "not" && !literal.IsLeaf()) {
+      const auto& negated = literal.GetChildren().back();
+      if (!IsGround(negated) || !IsStatic(negated)) {
+        return false;
+      }
+      std::vector<Substitution> negated_matches;
+      EvaluateLiteral(negated, negated_matches);
+      if (negated_matches.empty()) {
+        matches.emplace_back();
+      }
+      return true;
+    } else if (!IsStatic(literal)) {
+      return false;
+    }
+    for (const auto& fact : facts_.at(functor)) {
+      Substitution substitution;
+      if (Unify(literal, fact, substitution)) {
+        matches.push_back(substitution);
+        if (matches.size() > 1) {
+          // It is enough to know that the literal matches several facts
+          break;
+        }
+      }
+    }
+    return true;
+  }
+
+  std::unordered_map<std::string, std::vector<TreeNode>> facts_;
+};
+
+void CollectNestedRelations(const TreeNode& literal, std::unordered_set<std::string>& output) {
+  if (literal.IsLeaf()) {
+    return;
+  }
+  const auto& functor = literal.GetFunctor();
+  if (functor == "not" || functor == "or") {
+    const auto& children = literal.GetChildren();
+    for (auto i = children.begin() + 1; i != children.end(); ++i) {
+      output.insert(i->GetFunctor());
+      CollectNestedRelations(*i, output);
+    }
+  }
+}
+
+/**
+ * Rename the variables of a rule which conflict with given variables
+ */
+TreeNode RenameVariables(const TreeNode& rule, std::unordered_set<std::string>& used_variables) {
+  std::unordered_set<std::string> variables;
+  rule.CollectVariables(std::unordered_set<std::string>(), variables);
+  // Fresh variables must conflict with neither of them
+  auto unavailable_variables = used_variables; // copy
+  unavailable_variables.insert(variables.begin(), variables.end());
+  Substitution renaming;
+  for (const auto& variable : variables) {
+    if (!used_variables.count(variable)) {
+      continue;
+    }
+    auto renamed = variable;
+    for (auto i = 1; unavailable_variables.count(renamed); ++i) {
+      renamed = variable + "_" + std::to_string(i);
+    }
+    unavailable_variables.insert(renamed);
+    renaming.emplace(variable, TreeNode(renamed));
+  }
+  used_variables.swap(unavailable_variables);
+  return Substitute(rule, renaming);
+}
+
+/**
+ * Replace literals of the relation of a definition in a rule by the body of
+ * the definition
+ * @return false if the rule never holds
+ */
+bool InlineRule(const TreeNode& definition, const TreeNode& rule, TreeNode& output) {
+  const auto& relation = definition.GetChildren().at(1).GetFunctor();
+  auto head = rule.GetChildren().at(1);
+  std::vector<TreeNode> body(rule.GetChildren().begin() + 2, rule.GetChildren().end());
+  std::unordered_set<std::string> used_variables;
+  rule.CollectVariables(std::unordered_set<std::string>(), used_variables);
+  for (auto i = 0u; i < body.size();) {
+    if (body[i].GetFunctor() != relation) {
+      ++i;
+      continue;
+    }
+    const auto renamed = RenameVariables(definition, used_variables);
+    const auto& renamed_children = renamed.GetChildren();
+    Substitution substitution;
+    if (!Unify(body[i], renamed_children.at(1), substitution)) {
+      return false;
+    }
+    std::vector<TreeNode> inlined_body(body.begin(), body.begin() + i);
+    inlined_body.insert(inlined_body.end(), renamed_children.begin() + 2, renamed_children.end());
+    inlined_body.insert(inlined_body.end(), body.begin() + i + 1, body.end());
+    const auto inlined_count = renamed_children.size() - 2;
+    head = Substitute(head, substitution);
+    body.clear();
+    for (const auto& literal : inlined_body) {
+      body.push_back(Substitute(literal, substitution));
+    }
+    i += inlined_count;
+  }
+  output = MakeRule(head, body);
+  return true;
+}
+
+/**
+ * @return a relation which can be inlined, or an empty string
+ */
+std::string FindInlinableRelation(const std::vector<TreeNode>& nodes) {
+  const RuleGraph graph(nodes);
+  std::unordered_map<std::string, int> rule_counts;
+  std::unordered_set<std::string> fact_relations;
+  std::unordered_set<std::string> nested_relations;
+  std::unordered_set<std::string> used_relations;
+  for (const auto& node : nodes) {
+    if (!node.IsImplication()) {
+      fact_relations.insert(node.GetFunctor());
+      continue;
+    }
+    const auto& children = node.GetChildren();
+    ++rule_counts[children.at(1).GetFunctor()];
+    for (auto i = children.begin() + 2; i != children.end(); ++i) {
+      used_relations.insert(i->GetFunctor());
+      CollectNestedRelations(*i, nested_relations);
+    }
+  }
+  for (const auto& node : nodes) {
+    if (!node.IsImplication()) {
+      continue;
+    }
+    const auto& relation = node.GetChildren().at(1).GetFunctor();
+    const auto is_inlinable =
+        rule_counts.at(relation) == 1 &&
+        !fact_relations.count(relation) &&
+        !kReservedRelations.count(relation) &&
+        !nested_relations.count(relation) &&
+        used_relations.count(relation) &&
+        !graph.IsRecursive(graph.GetRelationIndex(relation));
+    if (is_inlinable) {
+      return relation;
+    }
+  }
+  return std::string();
+}
+
+/**
+ * Remove literals which always hold and disjuncts which never hold because
+ * of empty relations
+ * @return false if the rule never holds
+ */
+bool RemoveEmptyLiterals(
+    const TreeNode& rule,
+    const std::unordered_set<std::string>& defined_relations,
+    TreeNode& output) {
+  const auto is_connective = [](const TreeNode& literal) {
+    return !literal.IsLeaf() && (literal.GetFunctor() == "not" || literal.GetFunctor() == "or");
+  };
+  const auto is_empty = [&](const TreeNode& literal) {
+    const auto& functor = literal.GetFunctor();
+    return !is_connective(literal) &&
+        !kBuiltinRelations.count(functor) &&
+        !defined_relations.count(functor);
+  };
+  const auto is_negated_empty = [&](const TreeNode& literal) {
+    return is_connective(literal) && literal.GetFunctor() == "not" &&
+        is_empty(literal.GetChildren().back());
+  };
+  const auto& children = rule.GetChildren();
+  std::vector<TreeNode> body;
+  for (auto i = children.begin() + 2; i != children.end(); ++i) {
+    if (is_negated_empty(*i)) {
+      continue;
+    } else if (is_empty(*i)) {
+      return false;
+    } else if (!is_connective(*i) || i->GetFunctor() == "not") {
+      body.push_back(*i);
+      continue;
+    }
+    const auto& disjuncts = i->GetChildren();
+    if (std::any_of(disjuncts.begin() + 1, disjuncts.end(), is_negated_empty)) {
+      continue;
+    }
+    std::vector<TreeNode> kept_disjuncts = {disjuncts.front()};
+    std::copy_if(disjuncts.begin() + 1, disjuncts.end(), std::back_inserter(kept_disjuncts), [&](const TreeNode& disjunct) {
+      return !is_empty(disjunct);
+    });
+    if (kept_disjuncts.size() == 1) {
+      return false;
+    } else if (kept_disjuncts.size() == 2) {
+      body.push_back(kept_disjuncts.back());
+    } else {
+      body.push_back(TreeNode(kept_disjuncts));
+    }
+  }
+  output = MakeRule(children.at(1), body);
+  return true;
+}
+
+}
+
+std::vector<TreeNode> RemoveRulesOfEmptyRelations(const std::vector<TreeNode>& nodes) {
+  auto kept_nodes = nodes; // copy
+  while (true) {
+    std::unordered_set<std::string> defined_relations;
+    for (const auto& node : kept_nodes) {
+      defined_relations.insert(node.IsImplication() ? node.GetChildren().at(1).GetFunctor() : node.GetFunctor());
+    }
+    std::vector<TreeNode> next_nodes;
+    for (const auto& node : kept_nodes) {
+      if (!node.IsImplication()) {
+        next_nodes.push_back(node);
+        continue;
+      }
+      auto kept_node = node;
+      if (RemoveEmptyLiterals(node, defined_relations, kept_node)) {
+        next_nodes.push_back(kept_node);
+      }
+    }
+    // Relations become empty only when their rules are removed
+    const auto is_fixpoint = next_nodes.size() == kept_nodes.size();
+    kept_nodes.swap(next_nodes);
+    if (is_fixpoint) {
+      return kept_nodes;
+    }
+  }
+}
+
+std::vector<TreeNode> EvaluateStaticLiterals(const std::vector<TreeNode>& nodes) {
+  const StaticLiteralEvaluator evaluator(nodes);
+  std::vector<TreeNode> evaluated_nodes;
+  for (const auto& node : nodes) {
+    if (!node.IsImplication()) {
+      evaluated_nodes.push_back(node);
+      continue;
+    }
+    auto evaluated_node = node;
+    if (evaluator.Evaluate(node, evaluated_node)) {
+      evaluated_nodes.push_back(evaluated_node);
+    }
+  }
+  return evaluated_nodes;
+}
+
+std::vector<TreeNode> InlineRules(const std::vector<TreeNode>& nodes) {
+  auto inlined_nodes = nodes; // copy
+  while (true) {
+    const auto relation = FindInlinableRelation(inlined_nodes);
+    if (relation.empty()) {
+      return inlined_nodes;
+    }
+    const auto definition = *std::find_if(inlined_nodes.begin(), inlined_nodes.end(), [&](const TreeNode& node) {
+      return node.IsImplication() && node.GetChildren().at(1).GetFunctor() == relation;
+    });
+    std::vector<TreeNode> next_nodes;
+    for (const auto& node : inlined_nodes) {
+      if (!node.IsImplication()) {
+        next_nodes.push_back(node);
+        continue;
+      }
+      if (node == definition) {
+        continue;
+      }
+      auto inlined_node = node;
+      if (InlineRule(definition, node, inlined_node)) {
+        next_nodes.push_back(inlined_node);
+      }
+    }
+    inlined_nodes.swap(next_nodes);
+  }
+}
+
+std::vector<TreeNode> RemoveUnreachableRules(const std::vector<TreeNode>& nodes) {
+  const auto non_empty_nodes = RemoveRulesOfEmptyRelations(nodes);
+  const auto reachable_relations = RuleGraph(non_empty_nodes).CollectDependencies(kRootRelations);
+  std::vector<TreeNode> reachable_nodes;
+  for (const auto& node : non_empty_nodes) {
+    if (!node.IsImplication() ||
+        reachable_relations.count(node.GetChildren().at(1).GetFunctor())) {
+      reachable_nodes.push_back(node);
+    }
+  }
+  return reachable_nodes;
+}
+
+std::vector<TreeNode> Optimize(const std::vector<TreeNode>& nodes) {
+  return RemoveUnreachableRules(InlineRules(EvaluateStaticLiterals(nodes)));
+}
+
+std::string ToKIF(const std::vector<TreeNode>& nodes) {
+  std::ostringstream o;
+  for (const auto& node : nodes) {
+    o << node.ToSexpr() << std::endl;
+  }
+  return o.str();
+}
+
+}
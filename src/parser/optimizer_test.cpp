@@ -0,0 +1,99 @@
+#include "gtest/gtest.h"
+#include "optimizer.hpp"
+#include "file_utils.hpp"
+
+namespace sexpr_parser {
+
+namespace {
+
+const auto kTicTacToeKIF = file_utils::LoadStringFromFile("kif/tictactoe.kif");
+
+}
+
+TEST(EvaluateStaticLiterals, Test) {
+  const auto nodes = Parse(
+      "(succ 1 2) (succ 2 3) (max 3) "
+      "(<= (next (step ?y)) (true (step ?x)) (succ ?x ?y)) "
+      "(<= (next (last ?y)) (max ?x) (succ ?y ?x) (distinct ?y 1)) "
+      "(<= (next (first ?x)) (succ ?x 1)) "
+      "(<= (next (other ?x)) (true (step ?x)) (not (max 3)))");
+  const auto answer = Parse(
+      "(succ 1 2) (succ 2 3) (max 3) "
+      "(<= (next (step ?y)) (true (step ?x)) (succ ?x ?y)) "
+      "(next (last 2))");
+  ASSERT_EQ(EvaluateStaticLiterals(nodes), answer);
+}
+
+TEST(InlineRules, Test) {
+  const auto nodes = Parse(
+      "(<= (a ?x) (b ?x ?y) (c ?y)) "
+      "(<= (b ?x ?y) (true (cell ?x ?z)) (true (cell ?z ?y))) "
+      "(<= (b2 ?x 1) (true (cell ?x 1))) "
+      "(<= terminal (a ?x) (b2 1 ?x)) "
+      "(<= (goal p 0) (b2 1 2)) "
+      "(<= (c ?x) (not (d ?x))) "
+      "(<= (d ?x) (true (p ?x)))");
+  // The rule of 'goal' never holds since (b2 1 2) does not match (b2 ?x 1)
+  const auto answer = Parse(
+      "(<= terminal (true (cell 1 ?z)) (true (cell ?z ?x)) (not (d ?x)) (true (cell 1 1))) "
+      "(<= (d ?x) (true (p ?x)))");
+  ASSERT_EQ(InlineRules(nodes), answer);
+}
+
+TEST(InlineRules, Recursive) {
+  const auto nodes = Parse(
+      "(<= (a ?x) (b ?x)) "
+      "(<= (b ?x) (a ?x))");
+  ASSERT_EQ(InlineRules(nodes), nodes);
+}
+
+TEST(RemoveUnreachableRules, Test) {
+  const auto nodes = Parse(
+      "(index 1) (<= terminal (a ?x)) (<= (a ?x) (index ?x)) (<= (b ?x) (index ?x))");
+  const auto answer = Parse(
+      "(index 1) (<= terminal (a ?x)) (<= (a ?x) (index ?x))");
+  ASSERT_EQ(RemoveUnreachableRules(nodes), answer);
+}
+
+TEST(RemoveUnreachableRules, EmptyRelations) {
+  const auto nodes = Parse(
+      "(index 1) "
+      "(<= terminal (a ?x) (index ?x)) "
+      "(<= (a ?x) (b ?x)) "
+      "(<= (goal p 0) (or (a 1) (true (c 1))) (not (b 1))) "
+      "(<= (goal p 100) (or (a 1) (not (a 2))))");
+  // 'b' has neither facts nor rules, and 'a' becomes empty as well
+  const auto answer = Parse(
+      "(index 1) "
+      "(<= (goal p 0) (true (c 1))) "
+      "(goal p 100)");
+  ASSERT_EQ(RemoveUnreachableRules(nodes), answer);
+}
+
+TEST(Optimize, TicTacToe) {
+  const auto nodes = ParseKIF(kTicTacToeKIF);
+  const auto optimized_nodes = Optimize(nodes);
+  // 'row' and 'column' are inlined into 'line'
+  ASSERT_EQ(optimized_nodes.size(), nodes.size() - 2);
+  ASSERT_EQ(ParseKIF(ToKIF(optimized_nodes)), optimized_nodes);
+}
+
+TEST(Optimize, EmptyRelations) {
+  const auto nodes = Parse(
+      "(role p) (succ 1 2) "
+      "(<= (a ?x) (succ ?x 9)) "
+      "(<= (b ?x) (succ ?x ?y) (a ?y)) "
+      "(<= terminal (true (s ?x)) (b ?x))");
+  // Evaluating (succ ?x 9) removes the only rule of 'a', and so 'terminal'
+  // has no rules after 'b' is inlined into it
+  const auto answer = Parse("(role p) (succ 1 2)");
+  const auto optimized_nodes = Optimize(nodes);
+  ASSERT_EQ(optimized_nodes, answer);
+  // Otherwise the Prolog program calls undefined predicates
+  const auto program = ToProlog(optimized_nodes, true);
+  ASSERT_EQ(program.find("'a'("), std::string::npos);
+  ASSERT_EQ(program.find("'b'("), std::string::npos);
+  ASSERT_EQ(program.find("'terminal'"), std::string::npos);
+}
+
+}
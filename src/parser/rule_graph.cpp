@@ -0,0 +1,212 @@
+#include "rule_graph.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+
+namespace sexpr_parser {
+
+RuleGraph::RuleGraph(const std::vector<TreeNode>& nodes) :
+    is_stratified_(true) {
+  for (const auto& node : nodes) {
+    if (!node.IsImplication()) {
+      AddRelation(node.GetFunctor());
+      continue;
+    }
+    const auto& children = node.GetChildren();
+    const auto head_idx = AddRelation(children.at(1).GetFunctor());
+    for (auto i = children.begin() + 2; i != children.end(); ++i) {
+      AddEdges(head_idx, *i, false);
+    }
+  }
+  ComputeComponents();
+  ComputeStrata();
+}
+
+int RuleGraph::AddRelation(const std::string& relation) {
+  const auto it = relation_indices_.emplace(relation, relations_.size());
+  if (it.second) {
+    relations_.push_back(relation);
+    dependencies_.emplace_back();
+    dependents_.emplace_back();
+  }
+  return it.first->second;
+}
+
+void RuleGraph::AddEdges(const int head_idx, const TreeNode& literal, const bool is_negative) {
+  const auto& functor = literal.GetFunctor();
+  if (!literal.IsLeaf()) {
+    const auto& children = literal.GetChildren();
+    if (functor == "not") {
+      assert(children.size() == 2);
+      AddEdges(head_idx, children.back(), !is_negative);
+      return;
+    } else if (functor == "or") {
+      for (auto i = children.begin() + 1; i != children.end(); ++i) {
+        AddEdges(head_idx, *i, is_negative);
+      }
+      return;
+    } else if (functor == "distinct") {
+      return;
+    }
+  }
+  const auto relation_idx = AddRelation(functor);
+  dependencies_[head_idx].push_back(Edge{relation_idx, is_negative});
+  dependents_[relation_idx].push_back(Edge{head_idx, is_negative});
+}
+
+void RuleGraph::ComputeComponents() {
+  // Tarjan's algorithm, which finds a component after every component it
+  // depends on
+  const auto relation_count = GetRelationCount();
+  std::vector<int> order(relation_count, -1);
+  std::vector<int> low_links(relation_count, 0);
+  std::vector<bool> is_on_stack(relation_count, false);
+  std::vector<int> stack;
+  auto next_order = 0;
+  component_indices_.assign(relation_count, -1);
+  std::function<void(int)> visit = [&](const int relation_idx) {
+    order[relation_idx] = low_links[relation_idx] = next_order++;
+    stack.push_back(relation_idx);
+    is_on_stack[relation_idx] = true;
+    for (const auto& edge : dependencies_[relation_idx]) {
+      if (order[edge.relation_idx] < 0) {
+        visit(edge.relation_idx);
+        low_links[relation_idx] = std::min(low_links[relation_idx], low_links[edge.relation_idx]);
+      } else if (is_on_stack[edge.relation_idx]) {
+        low_links[relation_idx] = std::min(low_links[relation_idx], order[edge.relation_idx]);
+      }
+    }
+    if (low_links[relation_idx] != order[relation_idx]) {
+      return;
+    }
+    std::vector<int> component;
+    int member_idx;
+    do {
+      member_idx = stack.back();
+      stack.pop_back();
+      is_on_stack[member_idx] = false;
+      component_indices_[member_idx] = components_.size();
+      component.push_back(member_idx);
+    } while (member_idx != relation_idx);
+    components_.push_back(component);
+  };
+  for (auto i = 0; i < relation_count; ++i) {
+    if (order[i] < 0) {
+      visit(i);
+    }
+  }
+  is_recursive_.assign(relation_count, false);
+  for (auto i = 0; i < relation_count; ++i) {
+    for (const auto& edge : dependencies_[i]) {
+      if (component_indices_[edge.relation_idx] == component_indices_[i]) {
+        is_recursive_[i] = true;
+      }
+    }
+  }
+}
+
+void RuleGraph::ComputeStrata() {
+  strata_.assign(GetRelationCount(), 0);
+  for (const auto& component : components_) {
+    auto stratum = 0;
+    for (const auto relation_idx : component) {
+      for (const auto& edge : dependencies_[relation_idx]) {
+        const auto is_same_component =
+            component_indices_[edge.relation_idx] == component_indices_[relation_idx];
+        if (is_same_component) {
+          if (edge.is_negative) {
+            is_stratified_ = false;
+          }
+          continue;
+        }
+        stratum = std::max(stratum, strata_[edge.relation_idx] + (edge.is_negative ? 1 : 0));
+      }
+    }
+    for (const auto relation_idx : component) {
+      strata_[relation_idx] = stratum;
+    }
+  }
+}
+
+int RuleGraph::GetRelationCount() const {
+  return relations_.size();
+}
+
+const std::string& RuleGraph::GetRelation(const int relation_idx) const {
+  return relations_.at(relation_idx);
+}
+
+int RuleGraph::GetRelationIndex(const std::string& relation) const {
+  const auto it = relation_indices_.find(relation);
+  return it == relation_indices_.end() ? -1 : it->second;
+}
+
+const std::vector<RuleGraph::Edge>& RuleGraph::GetDependencies(const int relation_idx) const {
+  return dependencies_.at(relation_idx);
+}
+
+const std::vector<RuleGraph::Edge>& RuleGraph::GetDependents(const int relation_idx) const {
+  return dependents_.at(relation_idx);
+}
+
+const std::vector<std::vector<int>>& RuleGraph::GetComponents() const {
+  return components_;
+}
+
+int RuleGraph::GetComponentIndex(const int relation_idx) const {
+  return component_indices_.at(relation_idx);
+}
+
+bool RuleGraph::IsRecursive(const int relation_idx) const {
+  return is_recursive_.at(relation_idx);
+}
+
+bool RuleGraph::IsStratified() const {
+  return is_stratified_;
+}
+
+int RuleGraph::GetStratum(const int relation_idx) const {
+  return strata_.at(relation_idx);
+}
+
+std::unordered_set<std::string> RuleGraph::CollectDependents(
+    const std::unordered_set<std::string>& relations) const {
+  return CollectReachableRelations(relations, dependents_);
+}
+
+std::unordered_set<std::string> RuleGraph::CollectDependencies(
+    const std::unordered_set<std::string>& relations) const {
+  return CollectReachableRelations(relations, dependencies_);
+}
+
+std::unordered_set<std::string> RuleGraph::CollectReachableRelations(
+    const std::unordered_set<std::string>& relations,
+    const std::vector<std::vector<Edge>>& edges) const {
+  auto reachables = relations; // copy
+  std::vector<int> worklist;
+  for (const auto& relation : relations) {
+    const auto relation_idx = GetRelationIndex(relation);
+    if (relation_idx >= 0) {
+      worklist.push_back(relation_idx);
+    }
+  }
+  std::vector<bool> is_visited(GetRelationCount(), false);
+  for (const auto relation_idx : worklist) {
+    is_visited[relation_idx] = true;
+  }
+  while (!worklist.empty()) {
+    const auto relation_idx = worklist.back();
+    worklist.pop_back();
+    for (const auto& edge : edges[relation_idx]) {
+      if (!is_visited[edge.relation_idx]) {
+        is_visited[edge.relation_idx] = true;
+        reachables.insert(relations_[edge.relation_idx]);
+        worklist.push_back(edge.relation_idx);
+      }
+    }
+  }
+  return reachables;
+}
+
+}
@@ -0,0 +1,70 @@
+#include "gtest/gtest.h"
+#include "rule_graph.hpp"
+#include "file_utils.hpp"
+
+namespace sexpr_parser {
+
+namespace {
+
+const auto kTicTacToeKIF = file_utils::LoadStringFromFile("kif/tictactoe.kif");
+
+}
+
+TEST(RuleGraph, Edges) {
+  const RuleGraph graph(Parse("(<= a (true fact) (not (or b (c 1))) (distinct 1 2)) b"));
+  const auto a_idx = graph.GetRelationIndex("a");
+  ASSERT_GE(a_idx, 0);
+  ASSERT_EQ(graph.GetRelationIndex("distinct"), -1);
+  ASSERT_EQ(graph.GetRelationIndex("d"), -1);
+  const auto& dependencies = graph.GetDependencies(a_idx);
+  ASSERT_EQ(dependencies.size(), 3);
+  ASSERT_EQ(graph.GetRelation(dependencies[0].relation_idx), "true");
+  ASSERT_FALSE(dependencies[0].is_negative);
+  ASSERT_EQ(graph.GetRelation(dependencies[1].relation_idx), "b");
+  ASSERT_TRUE(dependencies[1].is_negative);
+  ASSERT_EQ(graph.GetRelation(dependencies[2].relation_idx), "c");
+  ASSERT_TRUE(dependencies[2].is_negative);
+  ASSERT_EQ(graph.GetDependents(graph.GetRelationIndex("b")).size(), 1);
+}
+
+TEST(RuleGraph, Components) {
+  const RuleGraph graph(Parse("(<= a b) (<= b a) (<= b c) (<= d (not a))"));
+  const auto a_idx = graph.GetRelationIndex("a");
+  const auto b_idx = graph.GetRelationIndex("b");
+  const auto c_idx = graph.GetRelationIndex("c");
+  const auto d_idx = graph.GetRelationIndex("d");
+  ASSERT_EQ(graph.GetComponents().size(), 3);
+  ASSERT_EQ(graph.GetComponentIndex(a_idx), graph.GetComponentIndex(b_idx));
+  ASSERT_LT(graph.GetComponentIndex(c_idx), graph.GetComponentIndex(a_idx));
+  ASSERT_LT(graph.GetComponentIndex(a_idx), graph.GetComponentIndex(d_idx));
+  ASSERT_TRUE(graph.IsRecursive(a_idx));
+  ASSERT_FALSE(graph.IsRecursive(d_idx));
+  ASSERT_TRUE(graph.IsStratified());
+  ASSERT_EQ(graph.GetStratum(a_idx), 0);
+  ASSERT_EQ(graph.GetStratum(d_idx), 1);
+}
+
+TEST(RuleGraph, NotStratified) {
+  const RuleGraph graph(Parse("(<= a (not b)) (<= b a)"));
+  ASSERT_FALSE(graph.IsStratified());
+}
+
+TEST(RuleGraph, CollectDependents) {
+  const RuleGraph graph(Parse(kTicTacToeKIF));
+  const auto dependents = graph.CollectDependents({"does"});
+  const std::unordered_set<std::string> answer = {"does", "next"};
+  ASSERT_EQ(dependents, answer);
+  ASSERT_TRUE(graph.CollectDependents({"true"}).count("line"));
+  ASSERT_FALSE(graph.CollectDependents({"true"}).count("index"));
+}
+
+TEST(RuleGraph, CollectDependencies) {
+  const RuleGraph graph(Parse(kTicTacToeKIF));
+  const auto dependencies = graph.CollectDependencies({"terminal"});
+  const std::unordered_set<std::string> answer = {
+    "terminal", "line", "row", "column", "diagonal", "open", "true"
+  };
+  ASSERT_EQ(dependencies, answer);
+}
+
+}
@@ -1,15 +1,21 @@
 #include "sexpr_parser.hpp"
 
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <cctype>
 #include <iostream>
 #include <locale>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <stdexcept>
 
 #include <boost/format.hpp>
 #include <boost/functional/hash.hpp>
-#include <boost/regex.hpp>
-#include <boost/tokenizer.hpp>
+
+#include "join_order.hpp"
+#include "rule_graph.hpp"
 
 namespace std
 {
@@ -23,9 +29,6 @@ struct hash<pair<T, U>> {
 
 namespace sexpr_parser {
 
-typedef boost::char_separator<char> Separator;
-typedef boost::tokenizer<Separator> Tokenizer;
-
 namespace {
 
 const std::unordered_set<std::string> kReservedRelations = {
@@ -70,7 +73,13 @@ std::string ToLowerCase(const std::string& str) {
  * @param word
  * @return
  */
-std::string LowerReservedWords(const std::string& word) {
+std::string LowerReservedWords(std::string word) {
+  const auto has_upper_case = std::any_of(word.begin(), word.end(), [](const char c) {
+    return std::isupper(static_cast<unsigned char>(c));
+  });
+  if (!has_upper_case) {
+    return word;
+  }
   const auto lowered = ToLowerCase(word);
   if (kReservedRelations.count(lowered)) {
     return lowered;
@@ -81,37 +90,123 @@ std::string LowerReservedWords(const std::string& word) {
 
 }
 
+struct TreeNode::Data {
+  bool is_leaf;
+  std::string value;
+  std::vector<TreeNode> children;
+  std::size_t hash;
+};
+
+namespace {
+
+std::size_t HashLeaf(const std::string& value) {
+  auto hash = std::hash<std::string>()(value);
+  boost::hash_combine(hash, true);
+  return hash;
+}
+
+std::size_t HashChildren(const std::vector<TreeNode>& children) {
+  std::size_t hash = 0;
+  for (const auto& child : children) {
+    boost::hash_combine(hash, child.GetHash());
+  }
+  boost::hash_combine(hash, false);
+  return hash;
+}
+
+}
+
+std::shared_ptr<const TreeNode::Data> TreeNode::Intern(Data&& data) {
+  using Entry = std::pair<const Data*, std::weak_ptr<const Data>>;
+  // The table is split by hash into shards locked separately, so that threads
+  // building nodes rarely wait for each other
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<std::size_t, std::vector<Entry>> table;
+  };
+  // Never destroyed, so that nodes with static storage duration can be
+  // released after the table
+  static auto& shards = *new std::array<Shard, 64>();
+  auto& shard = shards[data.hash % shards.size()];
+  // Locked entries can be the last owners once other threads release them,
+  // thus they are kept until the mutex is unlocked, because their deleter
+  // locks it and erases entries
+  std::vector<std::shared_ptr<const Data>> candidates;
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto& entries = shard.table[data.hash];
+  candidates.reserve(entries.size());
+  for (const auto& entry : entries) {
+    candidates.push_back(entry.second.lock());
+    const auto& interned = candidates.back();
+    // Children are already interned, thus they are compared as pointers
+    if (interned &&
+        interned->is_leaf == data.is_leaf &&
+        interned->value == data.value &&
+        interned->children == data.children) {
+      return interned;
+    }
+  }
+  const std::shared_ptr<const Data> interned(new Data(std::move(data)), [](const Data* released) {
+    {
+      auto& shard = shards[released->hash % shards.size()];
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      auto& entries = shard.table.at(released->hash);
+      entries.erase(std::find_if(entries.begin(), entries.end(), [&](const Entry& entry) {
+        return entry.first == released;
+      }));
+      if (entries.empty()) {
+        shard.table.erase(released->hash);
+      }
+    }
+    // Releasing children locks the shards of their hashes
+    delete released;
+  });
+  entries.emplace_back(interned.get(), interned);
+  return interned;
+}
+
 TreeNode::TreeNode(const std::string& value) :
-    is_leaf_(true), value_(LowerReservedWords(value)), children_() {
+    TreeNode(std::string(value)) {
 }
 
 TreeNode::TreeNode(const std::vector<TreeNode>& children) :
-    is_leaf_(false), value_(), children_(children) {
+    TreeNode(std::vector<TreeNode>(children)) {
+}
+
+TreeNode::TreeNode(std::string&& value) {
+  auto lowered = LowerReservedWords(std::move(value));
+  const auto hash = HashLeaf(lowered);
+  data_ = Intern(Data{true, std::move(lowered), std::vector<TreeNode>(), hash});
+}
+
+TreeNode::TreeNode(std::vector<TreeNode>&& children) {
+  const auto hash = HashChildren(children);
+  data_ = Intern(Data{false, std::string(), std::move(children), hash});
 }
 
 bool TreeNode::IsLeaf() const {
-  return is_leaf_;
+  return data_->is_leaf;
 }
 
 bool TreeNode::IsVariable() const {
-  return is_leaf_ && !value_.empty() && value_.front() == '?';
+  return data_->is_leaf && !data_->value.empty() && data_->value.front() == '?';
 }
 
 const std::string& TreeNode::GetValue() const {
-  return value_;
+  return data_->value;
 }
 
 const std::vector<TreeNode>& TreeNode::GetChildren() const {
-  return children_;
+  return data_->children;
 }
 
 std::string TreeNode::ToString() const {
-  if (is_leaf_) {
-    return "leaf:" + value_;
+  if (data_->is_leaf) {
+    return "leaf:" + data_->value;
   } else {
     std::ostringstream o;
-    o << "non-leaf[" << children_.size() << "](";
-    for (const auto& child : children_) {
+    o << "non-leaf[" << data_->children.size() << "](";
+    for (const auto& child : data_->children) {
       o << ' ' << child.ToString();
     }
     o << " )";
@@ -120,13 +215,13 @@ std::string TreeNode::ToString() const {
 }
 
 std::string TreeNode::ToSexpr() const {
-  if (is_leaf_) {
-    return value_;
+  if (data_->is_leaf) {
+    return data_->value;
   } else {
     std::ostringstream o;
     o << '(';
-    for (auto i = children_.begin(); i != children_.end(); ++i) {
-      if (i != children_.begin()) {
+    for (auto i = data_->children.begin(); i != data_->children.end(); ++i) {
+      if (i != data_->children.begin()) {
         o << ' ';
       }
       o << i->ToSexpr();
@@ -138,8 +233,8 @@ std::string TreeNode::ToSexpr() const {
 
 std::string TreeNode::ChildrenToSexpr() const {
   std::ostringstream o;
-  for (auto i = children_.begin(); i != children_.end(); ++i) {
-    if (i != children_.begin()) {
+  for (auto i = data_->children.begin(); i != data_->children.end(); ++i) {
+    if (i != data_->children.begin()) {
       o << ' ';
     }
     o << i->ToSexpr();
@@ -175,8 +270,8 @@ std::string ConvertToPrologAtom(const std::string& value, const bool quotes_atom
 }
 
 std::string TreeNode::ToPrologAtom(const bool quotes_atoms, const std::string& atom_prefix) const {
-  assert(is_leaf_);
-  return ConvertToPrologAtom(value_, quotes_atoms, atom_prefix);
+  assert(data_->is_leaf);
+  return ConvertToPrologAtom(data_->value, quotes_atoms, atom_prefix);
 }
 
 std::string ConvertToPrologFunctor(const std::string& value, const bool quotes_atoms, const std::string& functor_prefix) {
@@ -188,26 +283,26 @@ std::string ConvertToPrologFunctor(const std::string& value, const bool quotes_a
 }
 
 std::string TreeNode::ToPrologFunctor(const bool quotes_atoms, const std::string& functor_prefix) const {
-  assert(is_leaf_);
-  assert(value_[0] != '?');
-  return ConvertToPrologFunctor(value_, quotes_atoms, functor_prefix);
+  assert(data_->is_leaf);
+  assert(data_->value[0] != '?');
+  return ConvertToPrologFunctor(data_->value, quotes_atoms, functor_prefix);
 }
 
 std::string TreeNode::ToPrologTerm(const bool quotes_atoms, const std::string& functor_prefix, const std::string& atom_prefix) const {
-  if (is_leaf_) {
+  if (data_->is_leaf) {
     // Non-functor atom term
     return ToPrologAtom(quotes_atoms, atom_prefix);
   } else {
     // Compound term
-    assert(children_.size() >= 2  && "Compound term must have a functor and one or more arguments.");
-    assert(children_.front().IsLeaf() && "Compound term must start with functor.");
+    assert(data_->children.size() >= 2  && "Compound term must have a functor and one or more arguments.");
+    assert(data_->children.front().IsLeaf() && "Compound term must start with functor.");
     std::ostringstream o;
     // Functor
-    o << children_.front().ToPrologFunctor(quotes_atoms, functor_prefix);
+    o << data_->children.front().ToPrologFunctor(quotes_atoms, functor_prefix);
     o << '(';
     // Arguments
-    for (auto i = children_.begin() + 1; i != children_.end(); ++i) {
-      if (i != children_.begin() + 1) {
+    for (auto i = data_->children.begin() + 1; i != data_->children.end(); ++i) {
+      if (i != data_->children.begin() + 1) {
         o << ", ";
       }
       o << i->ToPrologTerm(quotes_atoms, functor_prefix, atom_prefix);
@@ -218,10 +313,10 @@ std::string TreeNode::ToPrologTerm(const bool quotes_atoms, const std::string& f
 }
 
 bool TreeNode::ContainsAnyAtomOf(const std::unordered_set<std::string>& atoms) const {
-  if (is_leaf_) {
-    return atoms.count(value_);
+  if (data_->is_leaf) {
+    return atoms.count(data_->value);
   } else {
-    return std::any_of(children_.begin(), children_.end(), [&](const TreeNode& child){
+    return std::any_of(data_->children.begin(), data_->children.end(), [&](const TreeNode& child){
       return child.ContainsAnyAtomOf(atoms);
     });
   }
@@ -234,41 +329,41 @@ std::string TreeNode::ToPrologRequirementTerm(
     const std::unordered_set<std::string>& dynamic_relations,
     const bool negated) const {
   if (GetFunctor() == "true") {
-    assert(children_.size() == 2);
+    assert(data_->children.size() == 2);
     if (negated) {
       return "true";
     } else {
       return "required_fact(" +
-          children_.at(1).ToPrologTerm(quotes_atoms, functor_prefix, atom_prefix) +
+          data_->children.at(1).ToPrologTerm(quotes_atoms, functor_prefix, atom_prefix) +
           ", Fact)";
     }
   } else if (GetFunctor() == "does") {
-    assert(children_.size() == 3);
+    assert(data_->children.size() == 3);
     if (negated) {
       return "true";
     } else {
       return "required_action([" +
-          children_.at(1).ToPrologTerm(quotes_atoms, functor_prefix, atom_prefix) +
+          data_->children.at(1).ToPrologTerm(quotes_atoms, functor_prefix, atom_prefix) +
           ", " +
-          children_.at(2).ToPrologTerm(quotes_atoms, functor_prefix, atom_prefix) +
+          data_->children.at(2).ToPrologTerm(quotes_atoms, functor_prefix, atom_prefix) +
           "], Action)";
     }
   } else if (GetFunctor() == "not") {
-    assert(children_.size() == 2);
-    if (children_.at(1).ContainsAnyAtomOf(dynamic_relations)) {
+    assert(data_->children.size() == 2);
+    if (data_->children.at(1).ContainsAnyAtomOf(dynamic_relations)) {
       return "true";
     } else {
       return functor_prefix +
           "not(" +
-          children_.at(1).ToPrologTerm(quotes_atoms, functor_prefix, atom_prefix) +
+          data_->children.at(1).ToPrologTerm(quotes_atoms, functor_prefix, atom_prefix) +
           ")";
     }
   } else if (GetFunctor() == "or") {
     std::ostringstream o;
     o << functor_prefix << "or(";
-    for (auto it = children_.begin() + 1; it != children_.end(); ++it) {
+    for (auto it = data_->children.begin() + 1; it != data_->children.end(); ++it) {
       o << it->ToPrologRequirementTerm(quotes_atoms, functor_prefix, atom_prefix, dynamic_relations, negated);
-      if (it != children_.end() - 1) {
+      if (it != data_->children.end() - 1) {
         o << ",";
       }
     }
@@ -277,18 +372,18 @@ std::string TreeNode::ToPrologRequirementTerm(
   } else if (dynamic_relations.count(GetFunctor())) {
     if (negated) {
       return "true";
-    } else if (is_leaf_) {
+    } else if (data_->is_leaf) {
       return "'requirements_" + ToPrologFunctor(false, functor_prefix) + "'(Fact, Action)";
     } else {
       // Compound term
-      assert(children_.size() >= 2  && "Compound term must have a functor and one or more arguments.");
-      assert(children_.front().IsLeaf() && "Compound term must start with functor.");
+      assert(data_->children.size() >= 2  && "Compound term must have a functor and one or more arguments.");
+      assert(data_->children.front().IsLeaf() && "Compound term must start with functor.");
       std::ostringstream o;
       // Functor
-      o << "'requirements_" << children_.front().ToPrologFunctor(false, functor_prefix);
+      o << "'requirements_" << data_->children.front().ToPrologFunctor(false, functor_prefix);
       o << "'(";
       // Arguments
-      for (auto i = children_.begin() + 1; i != children_.end(); ++i) {
+      for (auto i = data_->children.begin() + 1; i != data_->children.end(); ++i) {
         o << i->ToPrologTerm(quotes_atoms, functor_prefix, atom_prefix);
         o << ", ";
       }
@@ -304,12 +399,12 @@ std::string TreeNode::ToPrologRequirementTerm(
 void TreeNode::CollectVariables(
     const std::unordered_set<std::string>& ignored,
     std::unordered_set<std::string>& output) const {
-  if (is_leaf_) {
-    if (IsVariable() && !ignored.count(value_)) {
-      output.insert(value_);
+  if (data_->is_leaf) {
+    if (IsVariable() && !ignored.count(data_->value)) {
+      output.insert(data_->value);
     }
   } else {
-    for (const auto& child : children_) {
+    for (const auto& child : data_->children) {
       child.CollectVariables(ignored, output);
     }
   }
@@ -318,13 +413,13 @@ void TreeNode::CollectVariables(
 void TreeNode::CollectBoundAndUnboundVariables(
     std::unordered_set<std::string>& bound_variables,
     std::unordered_set<std::string>& unbound_variables) const {
-  if (is_leaf_) {
+  if (data_->is_leaf) {
     return;
   }
-  const auto& functor = children_.front();
+  const auto& functor = data_->children.front();
   assert(functor.IsLeaf());
   if (functor.GetValue() == "not" || functor.GetValue() == "distinct") {
-    for (auto it = children_.begin() + 1; it != children_.end(); ++it) {
+    for (auto it = data_->children.begin() + 1; it != data_->children.end(); ++it) {
       if (it->IsVariable() && !bound_variables.count(it->GetValue())) {
         // Found unbound variable
         unbound_variables.insert(it->GetValue());
@@ -333,7 +428,7 @@ void TreeNode::CollectBoundAndUnboundVariables(
       }
     }
   } else {
-    for (auto it = children_.begin() + 1; it != children_.end(); ++it) {
+    for (auto it = data_->children.begin() + 1; it != data_->children.end(); ++it) {
       if (it->IsVariable()) {
         bound_variables.insert(it->GetValue());
       } else {
@@ -345,27 +440,31 @@ void TreeNode::CollectBoundAndUnboundVariables(
 
 bool TreeNode::ChangeBodyOrderSoThatAllVariablesAreBound() {
   assert(IsImplication());
-  assert(children_.size() >= 2);
-  const auto& head = children_.at(1);
+  assert(data_->children.size() >= 2);
+  const auto initial_data = data_;
+  const auto& initial_children = initial_data->children;
+  const auto& head = initial_children.at(1);
   std::unordered_set<std::string> head_variables;
   head.CollectVariables(std::unordered_set<std::string>{}, head_variables);
-  auto initial_children = children_;
+  // Nodes are immutable, thus the body is rearranged in a copy
+  auto children = initial_children;
   while (true) {
     std::unordered_set<std::string> unbound_variables;
     std::unordered_set<std::string> bound_variables;
-    for (auto it = children_.begin() + 2; it != children_.end();) {
+    for (auto it = children.begin() + 2; it != children.end();) {
       it->CollectBoundAndUnboundVariables(bound_variables, unbound_variables);
-      if (!unbound_variables.empty() && it != children_.end() - 1) {
+      if (!unbound_variables.empty() && it != children.end() - 1) {
         // If unbound variables are found, move this predicate to the last
         std::cout << "Unbound variables are found in " << it->ToSexpr() << std::endl;
         auto moved_to_last = *it;
-        children_.erase(it);
-        children_.push_back(moved_to_last);
+        children.erase(it);
+        children.push_back(moved_to_last);
         break;
       } else {
         ++it;
       }
     }
+    *this = TreeNode(children);
     if (unbound_variables.empty()) {
       const auto are_head_variables_bound =
           std::all_of(
@@ -384,7 +483,7 @@ bool TreeNode::ChangeBodyOrderSoThatAllVariablesAreBound() {
         return false;
       }
     }
-    if (children_ == initial_children) {
+    if (children == initial_children) {
       // Unbound variables cannot be removed no matter how body predicates are
       // rearranged, thus this implication is unsolvable
       return false;
@@ -393,24 +492,24 @@ bool TreeNode::ChangeBodyOrderSoThatAllVariablesAreBound() {
 }
 
 std::string TreeNode::ToPrologClause(const bool quotes_atoms, const std::string& functor_prefix, const std::string& atom_prefix) const {
-  if (is_leaf_) {
+  if (data_->is_leaf) {
     // Fact clause of atom term
     return ToPrologTerm(quotes_atoms, functor_prefix, atom_prefix) + '.';
   } else {
-    assert(!children_.empty() && "Empty clause is not allowed.");
-    assert(children_.front().IsLeaf() && "Compound term must start with functor.");
-    if (children_.front().GetValue() == "<=") {
+    assert(!data_->children.empty() && "Empty clause is not allowed.");
+    assert(data_->children.front().IsLeaf() && "Compound term must start with functor.");
+    if (data_->children.front().GetValue() == "<=") {
       // Implication clause
-      assert(children_.size() >= 2 && "Rule clause must have head.");
+      assert(data_->children.size() >= 2 && "Rule clause must have head.");
       // Rule clause
       std::ostringstream o;
       // Head
-      o << children_.at(1).ToPrologTerm(quotes_atoms, functor_prefix, atom_prefix);
-      if (children_.size() >= 3) {
+      o << data_->children.at(1).ToPrologTerm(quotes_atoms, functor_prefix, atom_prefix);
+      if (data_->children.size() >= 3) {
         // Body
         o << " :- ";
-        for (auto i = children_.begin() + 2; i != children_.end(); ++i) {
-          if (i != children_.begin() + 2) {
+        for (auto i = data_->children.begin() + 2; i != data_->children.end(); ++i) {
+          if (i != data_->children.begin() + 2) {
             o << ", ";
           }
           o << i->ToPrologTerm(quotes_atoms, functor_prefix, atom_prefix);
@@ -426,43 +525,42 @@ std::string TreeNode::ToPrologClause(const bool quotes_atoms, const std::string&
 }
 
 std::unordered_set<std::string> TreeNode::CollectAtoms() const {
-  if (is_leaf_) {
-    if (value_ == "<=" || value_.front() == '?') {
-      // Not atom
-      return std::unordered_set<std::string>();
-    } else {
-      // Atom
-      return std::unordered_set<std::string>({value_});
+  std::unordered_set<std::string> values;
+  CollectAtoms(values);
+  return values;
+}
+
+void TreeNode::CollectAtoms(std::unordered_set<std::string>& output) const {
+  if (data_->is_leaf) {
+    if (data_->value != "<=" && data_->value.front() != '?') {
+      output.insert(data_->value);
     }
   } else {
     // Compound term
-    assert(children_.size() >= 2  && "Compound term must have a functor and one or more arguments.");
-    assert(children_.front().IsLeaf() && "Compound term must start with functor.");
-    std::unordered_set<std::string> values;
-    for (const auto& child : children_) {
-      const auto& child_atoms = child.CollectAtoms();
-      values.insert(child_atoms.begin(), child_atoms.end());
+    assert(data_->children.size() >= 2  && "Compound term must have a functor and one or more arguments.");
+    assert(data_->children.front().IsLeaf() && "Compound term must start with functor.");
+    for (const auto& child : data_->children) {
+      child.CollectAtoms(output);
     }
-    return values;
   }
 }
 
 std::unordered_set<std::string> TreeNode::CollectNonFunctorAtoms() const {
-  if (is_leaf_) {
-    if (value_ == "<=" || value_.front() == '?') {
+  if (data_->is_leaf) {
+    if (data_->value == "<=" || data_->value.front() == '?') {
       // Not atom
       return std::unordered_set<std::string>();
     } else {
       // Non-functor atom
-      return std::unordered_set<std::string>({value_});
+      return std::unordered_set<std::string>({data_->value});
     }
   } else {
     // Compound term
-    assert(children_.size() >= 2  && "Compound term must have a functor and one or more arguments.");
-    assert(children_.front().IsLeaf() && "Compound term must start with functor.");
+    assert(data_->children.size() >= 2  && "Compound term must have a functor and one or more arguments.");
+    assert(data_->children.front().IsLeaf() && "Compound term must start with functor.");
     std::unordered_set<std::string> values;
     // Ignore functor and search non-functor arguments
-    for (auto i = children_.begin() + 1; i != children_.end(); ++i) {
+    for (auto i = data_->children.begin() + 1; i != data_->children.end(); ++i) {
       const auto& child_atoms = i->CollectNonFunctorAtoms();
       values.insert(child_atoms.begin(), child_atoms.end());
     }
@@ -472,18 +570,18 @@ std::unordered_set<std::string> TreeNode::CollectNonFunctorAtoms() const {
 
 void TreeNode::CollectFunctorAtoms(
     std::unordered_map<std::string, int>& output) const {
-  if (is_leaf_) {
+  if (data_->is_leaf) {
     return;
   } else {
     // Compound term
-    assert(children_.size() >= 2  && "Compound term must have a functor and one or more arguments.");
-    assert(children_.front().IsLeaf() && "Compound term must start with functor.");
+    assert(data_->children.size() >= 2  && "Compound term must have a functor and one or more arguments.");
+    assert(data_->children.front().IsLeaf() && "Compound term must start with functor.");
     // Functor
-    if (children_.front().GetValue() != "<=") {
-      output.emplace(children_.front().GetValue(), children_.size() - 1);
+    if (data_->children.front().GetValue() != "<=") {
+      output.emplace(data_->children.front().GetValue(), data_->children.size() - 1);
     }
     // Search compound term arguments
-    for (auto i = children_.begin() + 1; i != children_.end(); ++i) {
+    for (auto i = data_->children.begin() + 1; i != data_->children.end(); ++i) {
       i->CollectFunctorAtoms(output);
     }
   }
@@ -496,18 +594,18 @@ std::unordered_map<std::string, int> TreeNode::CollectFunctorAtoms() const {
 }
 
 std::unordered_map<std::string, std::unordered_set<ArgPos>> TreeNode::CollectVariableArgs() const {
-  assert(!is_leaf_);
+  assert(!data_->is_leaf);
   // Compound term
-  assert(children_.size() >= 2  && "Compound term must have a functor and one or more arguments.");
-  assert(children_.front().IsLeaf() && "Compound term must start with functor.");
+  assert(data_->children.size() >= 2  && "Compound term must have a functor and one or more arguments.");
+  assert(data_->children.front().IsLeaf() && "Compound term must start with functor.");
   std::unordered_map<std::string, std::unordered_set<ArgPos>> values;
-  const auto functor = children_.front().GetValue();
+  const auto functor = data_->children.front().GetValue();
   // Ignore functor and search non-functor arguments
-  for (auto i = children_.begin() + 1; i != children_.end(); ++i) {
+  for (auto i = data_->children.begin() + 1; i != data_->children.end(); ++i) {
     if (i->IsLeaf()) {
       if (i->IsVariable()) {
         const auto variable_name = i->GetValue();
-        const auto pos = std::distance(children_.begin(), i);
+        const auto pos = std::distance(data_->children.begin(), i);
         if (values.count(i->GetValue())) {
           values.at(variable_name).emplace(functor, pos);
         } else {
@@ -575,23 +673,23 @@ std::unordered_set<ArgPosPair> VariableArgPosToArgPosPairs(const VariableArgPosM
 }
 
 std::unordered_set<ArgPosPair> TreeNode::CollectSameDomainArgsBetweenHeadAndBody() const {
-  assert(!is_leaf_);
-  assert(children_.size() >= 2  && "Compound term must have a functor and one or more arguments.");
-  assert(children_.front().IsLeaf() && "Compound term must start with functor.");
-  assert(children_.front().GetValue() == "<=");
-  if (children_.size() == 2) {
+  assert(!data_->is_leaf);
+  assert(data_->children.size() >= 2  && "Compound term must have a functor and one or more arguments.");
+  assert(data_->children.front().IsLeaf() && "Compound term must start with functor.");
+  assert(data_->children.front().GetValue() == "<=");
+  if (data_->children.size() == 2) {
     // Only head
     return std::unordered_set<ArgPosPair>();
   }
-  if (children_.at(1).IsLeaf()) {
+  if (data_->children.at(1).IsLeaf()) {
     // Head is leaf
     return std::unordered_set<ArgPosPair>();
   }
   // Head
-  const auto head_variable_args = children_.at(1).CollectVariableArgs();
+  const auto head_variable_args = data_->children.at(1).CollectVariableArgs();
   // Body
   std::unordered_map<std::string, std::unordered_set<ArgPos>> body_variable_args;
-  for (auto i = children_.begin() + 2; i != children_.end(); ++i) {
+  for (auto i = data_->children.begin() + 2; i != data_->children.end(); ++i) {
     if (!i->IsLeaf()) {
       const auto tmp = i->CollectVariableArgs();
       for (const auto t : tmp) {
@@ -607,12 +705,12 @@ std::unordered_set<ArgPosPair> TreeNode::CollectSameDomainArgsBetweenHeadAndBody
   return VariableArgPosToArgPosPairs(head_variable_args, body_variable_args);
 }
 std::unordered_set<ArgPosPair> TreeNode::CollectSameDomainArgsInBody() const {
-  assert(!is_leaf_);
-  assert(children_.size() >= 2  && "Compound term must have a functor and one or more arguments.");
-  assert(children_.front().IsLeaf() && "Compound term must start with functor.");
-  assert(children_.front().GetValue() == "<=");
+  assert(!data_->is_leaf);
+  assert(data_->children.size() >= 2  && "Compound term must have a functor and one or more arguments.");
+  assert(data_->children.front().IsLeaf() && "Compound term must start with functor.");
+  assert(data_->children.front().GetValue() == "<=");
   std::unordered_map<std::string, std::unordered_set<ArgPos>> variable_args;
-  for (auto i = children_.begin() + 2; i != children_.end(); ++i) {
+  for (auto i = data_->children.begin() + 2; i != data_->children.end(); ++i) {
     if (!i->IsLeaf()) {
       const auto tmp = i->CollectVariableArgs();
       for (const auto t : tmp) {
@@ -628,64 +726,36 @@ std::unordered_set<ArgPosPair> TreeNode::CollectSameDomainArgsInBody() const {
 }
 
 TreeNode TreeNode::ReplaceAtoms(const std::string& before, const std::string& after) const {
-  if (is_leaf_) {
-    if (value_ == before) {
+  if (data_->is_leaf) {
+    if (data_->value == before) {
       return TreeNode(after);
     } else {
-      return TreeNode(value_);
+      return *this;
     }
   } else {
     std::vector<TreeNode> new_children;
-    for (const auto& child : children_) {
+    for (const auto& child : data_->children) {
       new_children.push_back(child.ReplaceAtoms(before, after));
     }
     return TreeNode(new_children);
   }
 }
 
-bool TreeNode::CollectDynamicRelations(
-    std::unordered_set<std::string>& local_relations) const {
-  if (is_leaf_) {
-    return false;
-  }
-  assert(children_.size() >= 2);
-  assert(children_.front().IsLeaf());
-  if (children_.front().GetValue() != "<=") {
-    return false;
-  }
-  if (children_.size() == 2) {
-    // No body
-    return false;
-  }
-  const auto& functor = children_.at(1).GetFunctor();
-  if (local_relations.count(functor)) {
-    // Already proved to be local
-    return false;
-  }
-  for (auto i = children_.begin() + 2; i != children_.end(); ++i) {
-    if (i->ContainsFunctors(local_relations)) {
-      local_relations.insert(functor);
-      return true;
-    }
-  }
-  return false;
-}
-
 const std::string& TreeNode::GetFunctor() const {
-  if (is_leaf_) {
-    return value_;
+  if (data_->is_leaf) {
+    return data_->value;
   } else {
-    assert(!children_.empty());
-    assert(children_.front().IsLeaf());
-    return children_.front().GetValue();
+    assert(!data_->children.empty());
+    assert(data_->children.front().IsLeaf());
+    return data_->children.front().GetValue();
   }
 }
 
 bool TreeNode::ContainsFunctors(const std::unordered_set<std::string>& functors) const {
-  if (is_leaf_) {
-    return functors.count(value_);
+  if (data_->is_leaf) {
+    return functors.count(data_->value);
   } else {
-    for (const auto& child : children_) {
+    for (const auto& child : data_->children) {
       if (child.ContainsFunctors(functors)) {
         return true;
       }
@@ -695,31 +765,24 @@ bool TreeNode::ContainsFunctors(const std::unordered_set<std::string>& functors)
 }
 
 bool TreeNode::operator==(const TreeNode& another) const {
-  if (is_leaf_) {
-    if (another.IsLeaf()) {
-      return value_ == another.GetValue();
-    } else {
-      return false;
-    }
-  } else {
-    if (!another.IsLeaf()) {
-      return children_ == another.GetChildren();
-    } else {
-      return false;
-    }
-  }
+  // Equal nodes are always interned into the same data
+  return data_ == another.data_;
+}
+
+std::size_t TreeNode::GetHash() const {
+  return data_->hash;
 }
 
 void TreeNode::CollectNegatedFunctors(
     std::unordered_map<std::string, int>& output) const {
-  if (is_leaf_) {
+  if (data_->is_leaf) {
     return;
   } else {
     if (GetFunctor() == "not") {
-      assert(children_.size() == 2);
-      children_.back().CollectFunctorAtoms(output);
+      assert(data_->children.size() == 2);
+      data_->children.back().CollectFunctorAtoms(output);
     } else {
-      for (const auto& child : children_) {
+      for (const auto& child : data_->children) {
         child.CollectNegatedFunctors(output);
       }
     }
@@ -728,10 +791,10 @@ void TreeNode::CollectNegatedFunctors(
 
 bool TreeNode::IsImplication() const {
   return
-      !is_leaf_ &&
-      children_.size() >= 2 &&
-      children_.front().IsLeaf() &&
-      children_.front().GetValue() == "<=";
+      !data_->is_leaf &&
+      data_->children.size() >= 2 &&
+      data_->children.front().IsLeaf() &&
+      data_->children.front().GetValue() == "<=";
 }
 
 std::string TreeNode::ToPrologRequirementClause(
@@ -744,12 +807,12 @@ std::string TreeNode::ToPrologRequirementClause(
     // Implication clause
     std::ostringstream o;
     // Head
-    o << children_.at(1).ToPrologRequirementTerm(quotes_atoms, functor_prefix, atom_prefix, dynamic_relations, false);
-    if (children_.size() >= 3) {
+    o << data_->children.at(1).ToPrologRequirementTerm(quotes_atoms, functor_prefix, atom_prefix, dynamic_relations, false);
+    if (data_->children.size() >= 3) {
       // Body
       o << " :- ";
-      for (auto i = children_.begin() + 2; i != children_.end(); ++i) {
-        if (i != children_.begin() + 2) {
+      for (auto i = data_->children.begin() + 2; i != data_->children.end(); ++i) {
+        if (i != data_->children.begin() + 2) {
           o << ", ";
         }
         o << i->ToPrologRequirementTerm(quotes_atoms, functor_prefix, atom_prefix, dynamic_relations, false);
@@ -762,60 +825,143 @@ std::string TreeNode::ToPrologRequirementClause(
   }
 }
 
-//void TreeNode::CollectVariables(std::unordered_set<std::string>& output) const {
-//  if (is_leaf_) {
-//    if (IsVariable()) {
-//      output.insert(value_);
-//    }
-//  } else {
-//    for (const auto& child : children_) {
-//      child.CollectVariables(output);
-//    }
-//  }
-//}
+namespace {
 
-std::string RemoveComments(const std::string& sexpr) {
-  boost::regex comment(";.*?$");
-  return boost::regex_replace(sexpr, comment, std::string());
+/**
+ * Token which refers to a range of the source instead of copying it
+ */
+struct StringRef {
+  const char* data;
+  std::size_t size;
+
+  bool Is(const char c) const {
+    return size == 1 && *data == c;
+  }
+};
+
+bool IsSpace(const char c) {
+  return c == ' ' || c == '\n' || c == '\t' || c == '\r';
 }
 
-// Argument iterator must point to the token next to "("
-// When this function returns, iterator will point to corresponding ")"
-TreeNode ParseTillRightParen(Tokenizer::iterator& i, const bool flatten_tuple_with_one_child) {
-  std::vector<TreeNode> children;
-  for (; *i != ")"; ++i) {
-    if (*i == "(") {
-      // Skip left paren and parse inside parens
-      ++i;
-      children.push_back(ParseTillRightParen(i, flatten_tuple_with_one_child));
+bool IsDelimiter(const char c) {
+  return IsSpace(c) || c == '(' || c == ')' || c == ';';
+}
+
+/**
+ * Single-pass lexer which skips white spaces and comments while reading
+ * tokens
+ */
+class Lexer {
+public:
+  Lexer(const char* begin, const char* end) : pos_(begin), end_(end) {
+  }
+
+  /**
+   * Read the next token
+   * @return false if no token remains
+   */
+  bool Next(StringRef& token) {
+    while (pos_ != end_) {
+      if (*pos_ == ';') {
+        // A comment continues until the end of the line
+        while (pos_ != end_ && *pos_ != '\n') {
+          ++pos_;
+        }
+      } else if (IsSpace(*pos_)) {
+        ++pos_;
+      } else {
+        break;
+      }
+    }
+    if (pos_ == end_) {
+      return false;
+    }
+    token.data = pos_;
+    if (*pos_ == '(' || *pos_ == ')') {
+      ++pos_;
     } else {
-      children.push_back(TreeNode(*i));
+      while (pos_ != end_ && !IsDelimiter(*pos_)) {
+        ++pos_;
+      }
     }
+    token.size = pos_ - token.data;
+    return true;
   }
-  if (flatten_tuple_with_one_child && children.size() == 1) {
-    return children.front();
+
+private:
+  const char* pos_;
+  const char* end_;
+};
+
+}
+
+std::string RemoveComments(const std::string& sexpr) {
+  std::string result;
+  result.reserve(sexpr.size());
+  for (auto i = sexpr.begin(); i != sexpr.end(); ++i) {
+    if (*i == ';') {
+      i = std::find(i, sexpr.end(), '\n');
+      if (i == sexpr.end()) {
+        break;
+      }
+    }
+    result.push_back(*i);
   }
-  // When this function returns, the iterator is always pointing to ")"
-  return TreeNode(children);
+  return result;
 }
 
-std::vector<TreeNode> Parse(const std::string& sexpr, bool flatten_tuple_with_one_child) {
-  Separator sep(" \n\t\r", "()");
-  const auto sexpr_no_comments = RemoveComments(sexpr);
-  Tokenizer tokens(sexpr_no_comments, sep);
-  std::vector<TreeNode> results;
-  for (auto i = tokens.begin(); i != tokens.end(); ++i) {
-    if (*i == "(") {
-      // Skip left paren and parse inside parens
-      ++i;
-      results.push_back(ParseTillRightParen(i, flatten_tuple_with_one_child));
+void ParseForms(
+    const char* begin,
+    const char* end,
+    const FormVisitor& visitor,
+    const bool flatten_tuple_with_one_child) {
+  Lexer lexer(begin, end);
+  // Children of the tuples whose right parens are not read yet
+  std::vector<std::vector<TreeNode>> open_tuples;
+  StringRef token;
+  while (lexer.Next(token)) {
+    if (token.Is('(')) {
+      open_tuples.emplace_back();
+      continue;
+    }
+    if (token.Is(')') && open_tuples.empty()) {
+      throw std::runtime_error("Unbalanced right paren in S-expression");
+    }
+    auto node = [&]() -> TreeNode {
+      if (!token.Is(')')) {
+        return TreeNode(std::string(token.data, token.size));
+      }
+      auto children = std::move(open_tuples.back());
+      open_tuples.pop_back();
+      if (flatten_tuple_with_one_child && children.size() == 1) {
+        return std::move(children.front());
+      }
+      return TreeNode(std::move(children));
+    }();
+    if (open_tuples.empty()) {
+      // A top-level form is passed as soon as it is closed
+      visitor(node);
     } else {
-      results.push_back(TreeNode(*i));
+      open_tuples.back().push_back(std::move(node));
     }
   }
+  if (!open_tuples.empty()) {
+    throw std::runtime_error("Unbalanced left paren in S-expression");
+  }
+}
+
+std::vector<TreeNode> Parse(const char* begin, const char* end, const bool flatten_tuple_with_one_child) {
+  std::vector<TreeNode> results;
+  ParseForms(begin, end, [&](const TreeNode& node) {
+    results.push_back(node);
+  }, flatten_tuple_with_one_child);
   return results;
 }
 
+std::vector<TreeNode> Parse(const std::string& sexpr, const bool flatten_tuple_with_one_child) {
+  return Parse(sexpr.data(), sexpr.data() + sexpr.size(), flatten_tuple_with_one_child);
+}
+
 std::vector<TreeNode> ParseKIF(const std::string& kif) {
   return Parse(kif, true);
 }
@@ -856,10 +1002,14 @@ std::string GenerateTableClauses(
     const std::vector<TreeNode>& nodes,
     const bool quotes_atoms,
     const std::string& functor_prefix,
-    const std::unordered_set<std::string>& unsolvable_relations) {
+    const std::unordered_set<std::string>& unsolvable_relations,
+    const std::unordered_set<std::string>& tabled_relations) {
   std::ostringstream o;
   const auto static_relations = CollectStaticRelations(nodes);
   for (const auto& functor_arity_pair : static_relations) {
+    if (!tabled_relations.count(functor_arity_pair.first)) {
+      continue;
+    }
     if (unsolvable_relations.count(functor_arity_pair.first)) {
       // Unsolvable relations cannot be tabled
       continue;
@@ -970,9 +1120,9 @@ std::string ToProlog(
     const std::string& functor_prefix,
     const std::string& atom_prefix,
     const bool adds_helper_clauses,
-    const bool enables_tabling) {
+    const std::unordered_set<std::string>& tabled_relations) {
   std::ostringstream o;
-  auto tmp_nodes = nodes; // copy
+  auto tmp_nodes = ReorderBodiesBySelectivity(nodes);
   std::unordered_set<std::string> unsolvable_relations;
   for (auto& node : tmp_nodes) {
     if (node.IsImplication() &&
@@ -981,8 +1131,9 @@ std::string ToProlog(
       std::cout << "Unsolvable relation: " << node.GetChildren().at(1).GetValue() << std::endl;
     }
   }
-  if (enables_tabling) {
-    o << GenerateTableClauses(tmp_nodes, quotes_atoms, functor_prefix, unsolvable_relations);
+  if (!tabled_relations.empty()) {
+    o << GenerateTableClauses(
+        tmp_nodes, quotes_atoms, functor_prefix, unsolvable_relations, tabled_relations);
   }
   for (const auto& node : tmp_nodes) {
     o << node.ToPrologClause(quotes_atoms, functor_prefix, atom_prefix) << std::endl;
@@ -996,8 +1147,7 @@ std::string ToProlog(
 std::unordered_set<std::string> CollectAtoms(const std::vector<TreeNode>& nodes) {
   std::unordered_set<std::string> values;
   for (const auto& node : nodes) {
-    const auto& node_values = node.CollectAtoms();
-    values.insert(node_values.begin(), node_values.end());
+    node.CollectAtoms(values);
   }
   return values;
 }
@@ -1052,21 +1202,7 @@ std::unordered_map<std::string, int> CollectNegatedFunctors(
 
 std::unordered_set<std::string> CollectDynamicRelations(
     const std::vector<TreeNode>& nodes) {
-  auto dynamic_relations = kReservedDynamicRelations; // copy
-  while (true) {
-    auto found = false;
-    for (const auto& node : nodes) {
-      if (node.CollectDynamicRelations(dynamic_relations)) {
-        // If a new dynamic relation is found, restart the search again
-        // so that we can find relations depending on the newly found relation.
-        found = true;
-      }
-    }
-    if (!found) {
-      break;
-    }
-  }
-  return dynamic_relations;
+  return RuleGraph(nodes).CollectDependents(kReservedDynamicRelations);
 }
 
 std::unordered_map<std::string, int> CollectStaticRelations(
@@ -1080,19 +1216,6 @@ std::unordered_map<std::string, int> CollectStaticRelations(
     if (!kReservedRelations.count(rel) &&
         !dynamic_relations.count(rel) &&
         !negated_functors.count(rel)) {
-//      if (functor.first == "cell" || functor.first == "control" || functor.first == "mark") {
-//        continue;
-//      }
-//      if (functor.first == "index" || functor.first == "cellHolds" || functor.first == "control" || functor.first == "move") {
-//        continue;
-//      }
-      auto allowed = std::unordered_set<std::string>{{
-//        "slow_move_down"
-//        "index"
-      }};
-      if (!allowed.count(rel)) {
-        continue;
-      }
       global_relations.emplace(rel, functors.at(rel));
     }
   }
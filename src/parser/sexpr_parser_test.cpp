@@ -71,6 +71,53 @@ TEST(Parse, FlattenTupleWithOneChild) {
   ASSERT_TRUE(std::equal(nodes.begin(), nodes.end(), nodes_flattened.begin()));
 }
 
+TEST(Parse, Comments) {
+  const auto nodes = Parse("; comment\n(a b;comment (c\n d) e; comment");
+  ASSERT_EQ(nodes, Parse("(a b d) e"));
+}
+
+TEST(Parse, UnbalancedParens) {
+  ASSERT_THROW(Parse("(a (b)"), std::runtime_error);
+  ASSERT_THROW(Parse("(a b))"), std::runtime_error);
+}
+
+TEST(Parse, Range) {
+  const auto sexpr = std::string("(a b) (c d)");
+  // Only the first tuple is in the range
+  ASSERT_EQ(Parse(sexpr.data(), sexpr.data() + 5), Parse("(a b)"));
+}
+
+TEST(TreeNode, HashConsing) {
+  const auto nodes = Parse("(f (g a) b) (f (g a) b) (f (g a) c)");
+  ASSERT_EQ(nodes[0], nodes[1]);
+  ASSERT_EQ(nodes[0].GetHash(), nodes[1].GetHash());
+  ASSERT_FALSE(nodes[0] == nodes[2]);
+  // Identical subtrees share their children
+  ASSERT_EQ(&nodes[0].GetChildren(), &nodes[1].GetChildren());
+  ASSERT_EQ(&nodes[0].GetChildren()[1].GetChildren(), &nodes[2].GetChildren()[1].GetChildren());
+  ASSERT_EQ(nodes[2].ReplaceAtoms("c", "b"), nodes[0]);
+}
+
+TEST(ParseForms, TicTacToe) {
+  const file_utils::MappedFile file("kif/tictactoe.kif");
+  std::vector<TreeNode> nodes;
+  StringSet atoms;
+  ParseForms(file.begin(), file.end(), [&](const TreeNode& node) {
+    nodes.push_back(node);
+    node.CollectAtoms(atoms);
+  }, true);
+  const auto answer = ParseKIF(kTicTacToeKIF);
+  ASSERT_EQ(nodes, answer);
+  ASSERT_EQ(atoms, CollectAtoms(answer));
+}
+
+TEST(LoadStringFromFile, NonRegularFile) {
+  // Devices and pipes are read without mapping
+  ASSERT_THROW(file_utils::MappedFile("/dev/null"), std::runtime_error);
+  ASSERT_EQ(file_utils::LoadStringFromFile("/dev/null"), "");
+  ASSERT_THROW(file_utils::LoadStringFromFile("kif/missing.kif"), std::runtime_error);
+}
+
 TEST(Parse, ToPrologClause) {
   const auto nodes = Parse("(role player) fact1 (fact2 1) (<= rule1 fact1) (<= (rule2 ?x) fact1 (fact2 ?x))");
   ASSERT_TRUE(nodes.size() == 5);
@@ -99,6 +146,17 @@ TEST(Parse, ToProlog) {
   ASSERT_EQ(ToProlog(nodes, true), answer_quoted);
 }
 
+TEST(Parse, ToPrologWithTabling) {
+  const auto nodes = Parse("(index 1) (<= (a ?x) (index ?x)) (<= (b ?x) (true ?x))");
+  const std::string answer =
+      ":- table a/1.\n"
+      "index(1).\n"
+      "a(_x) :- index(_x).\n"
+      "b(_x) :- true(_x).\n";
+  // 'b' is not static, thus it is not tabled
+  ASSERT_EQ(ToProlog(nodes, false, "", "", false, {"a", "b"}), answer);
+}
+
 TEST(Parse, FilterVariableCode) {
   const auto& nodes = Parse("(<= head (body ?v+v))");
   const std::string answer = "head :- body(_v_c43_v).\n";
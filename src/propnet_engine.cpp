@@ -0,0 +1,597 @@
+#include "propnet_engine.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "sexpr_parser.hpp"
+
+namespace ggpe {
+namespace propnet {
+
+namespace {
+
+std::mt19937& GetRandomEngine() {
+  static thread_local std::mt19937 random_engine(std::random_device{}());
+  return random_engine;
+}
+
+}
+
+Propnet::Propnet(const GameDataCsp& game, const grounder::GroundProgram& program) :
+    game_(game),
+    terminal_proposition_(-1) {
+  // Proposition for each literal, where 'true' and 'does' ones are inputs
+  std::vector<bool> is_input(program.literals.size(), false);
+  for (const auto literal_id : program.true_literals) {
+    is_input[literal_id] = true;
+  }
+  for (const auto& literal_ids : program.does_literals) {
+    for (const auto literal_id : literal_ids) {
+      is_input[literal_id] = true;
+    }
+  }
+  for (auto i = 0; i < static_cast<int>(program.literals.size()); ++i) {
+    literal_to_proposition_.push_back(
+        AddComponent(is_input[i] ? ComponentType::kInput : ComponentType::kOr, {}));
+  }
+  for (const auto& literal_ids : program.does_literals) {
+    for (const auto literal_id : literal_ids) {
+      components_[literal_to_proposition_[literal_id]].depends_on_does = true;
+    }
+  }
+
+  // AND component for each rule, then OR component for each proposition
+  std::vector<std::vector<int>> proposition_rules(components_.size());
+  std::unordered_map<int, int> not_components;
+  for (const auto& rule : program.rules) {
+    std::vector<int> and_inputs;
+    for (const auto literal_id : rule.positive_body) {
+      and_inputs.push_back(literal_to_proposition_[literal_id]);
+    }
+    for (const auto literal_id : rule.negative_body) {
+      const auto proposition = literal_to_proposition_[literal_id];
+      auto it = not_components.find(proposition);
+      if (it == not_components.end()) {
+        it = not_components.emplace(proposition, AddComponent(ComponentType::kNot, {proposition})).first;
+      }
+      and_inputs.push_back(it->second);
+    }
+    const auto and_component = AddComponent(ComponentType::kAnd, and_inputs);
+    proposition_rules.at(literal_to_proposition_[rule.head]).push_back(and_component);
+  }
+  for (auto i = 0; i < static_cast<int>(proposition_rules.size()); ++i) {
+    auto& component = components_[i];
+    if (component.type != ComponentType::kOr) {
+      continue;
+    }
+    component.first_input = inputs_.size();
+    component.input_count = proposition_rules[i].size();
+    inputs_.insert(inputs_.end(), proposition_rules[i].begin(), proposition_rules[i].end());
+  }
+
+  Sort();
+
+  // Propositions of reserved relations
+  base_facts_ = program.facts;
+  for (auto i = 0; i < static_cast<int>(program.facts.size()); ++i) {
+    fact_to_base_idx_.emplace(program.facts[i], i);
+    base_propositions_.push_back(literal_to_proposition_[program.true_literals[i]]);
+    const auto next_literal = program.next_literals[i];
+    next_propositions_.push_back(next_literal >= 0 ? literal_to_proposition_[next_literal] : -1);
+  }
+  const auto role_count = program.actions.size();
+  does_propositions_.resize(role_count);
+  legal_propositions_.resize(role_count);
+  legal_does_propositions_.resize(role_count);
+  goal_propositions_.resize(role_count);
+  for (auto role_idx = 0; role_idx < static_cast<int>(role_count); ++role_idx) {
+    for (auto i = 0; i < static_cast<int>(program.actions[role_idx].size()); ++i) {
+      const auto& action = program.actions[role_idx][i];
+      const auto does_proposition = literal_to_proposition_[program.does_literals[role_idx][i]];
+      does_propositions_[role_idx].emplace(action, does_proposition);
+      does_proposition_list_.push_back(does_proposition);
+      const auto legal_literal = program.legal_literals[role_idx][i];
+      if (legal_literal >= 0) {
+        legal_propositions_[role_idx].emplace_back(literal_to_proposition_[legal_literal], action);
+        legal_does_propositions_[role_idx].push_back(does_proposition);
+      }
+    }
+    for (const auto& entry : program.goal_literals[role_idx]) {
+      goal_propositions_[role_idx].emplace_back(literal_to_proposition_[entry.first], entry.second);
+    }
+  }
+  if (program.terminal_literal < 0) {
+    // Simulations would never end
+    throw std::runtime_error("Propnet cannot be built for a game whose 'terminal' is never derived.");
+  }
+  terminal_proposition_ = literal_to_proposition_[program.terminal_literal];
+  std::cout << "Propnet: " << components_.size() << " components, " <<
+      base_facts_.size() << " base propositions." << std::endl;
+}
+
+int Propnet::AddComponent(const ComponentType type, const std::vector<int>& inputs) {
+  components_.push_back(Component{type, false, static_cast<int>(inputs_.size()), static_cast<int>(inputs.size())});
+  inputs_.insert(inputs_.end(), inputs.begin(), inputs.end());
+  return components_.size() - 1;
+}
+
+void Propnet::Sort() {
+  const auto count = static_cast<int>(components_.size());
+  // Edges from inputs to components
+  std::vector<std::vector<int>> outputs(count);
+  for (auto i = 0; i < count; ++i) {
+    const auto& component = components_[i];
+    for (auto j = 0; j < component.input_count; ++j) {
+      outputs[inputs_[component.first_input + j]].push_back(i);
+    }
+  }
+  // Strongly connected components by Tarjan's algorithm (without recursion)
+  std::vector<int> indices(count, -1);
+  std::vector<int> lowlinks(count, 0);
+  std::vector<bool> is_on_stack(count, false);
+  std::vector<int> stack;
+  std::vector<std::vector<int>> sccs;
+  auto next_index = 0;
+  for (auto root = 0; root < count; ++root) {
+    if (indices[root] >= 0) {
+      continue;
+    }
+    // (component, next output position)
+    std::vector<std::pair<int, int>> call_stack({{root, 0}});
+    indices[root] = lowlinks[root] = next_index++;
+    stack.push_back(root);
+    is_on_stack[root] = true;
+    while (!call_stack.empty()) {
+      const auto v = call_stack.back().first;
+      auto& pos = call_stack.back().second;
+      if (pos < static_cast<int>(outputs[v].size())) {
+        const auto w = outputs[v][pos++];
+        if (indices[w] < 0) {
+          indices[w] = lowlinks[w] = next_index++;
+          stack.push_back(w);
+          is_on_stack[w] = true;
+          call_stack.emplace_back(w, 0);
+        } else if (is_on_stack[w]) {
+          lowlinks[v] = std::min(lowlinks[v], indices[w]);
+        }
+        continue;
+      }
+      call_stack.pop_back();
+      if (!call_stack.empty()) {
+        const auto u = call_stack.back().first;
+        lowlinks[u] = std::min(lowlinks[u], lowlinks[v]);
+      }
+      if (lowlinks[v] == indices[v]) {
+        std::vector<int> scc;
+        int w;
+        do {
+          w = stack.back();
+          stack.pop_back();
+          is_on_stack[w] = false;
+          scc.push_back(w);
+        } while (w != v);
+        sccs.push_back(scc);
+      }
+    }
+  }
+  // Tarjan's algorithm finds SCCs in reverse topological order
+  std::reverse(sccs.begin(), sccs.end());
+
+  // Renumber components so that inputs always come first
+  std::vector<int> new_indices(count);
+  std::vector<int> old_indices;
+  old_indices.reserve(count);
+  for (const auto& scc : sccs) {
+    for (const auto old_idx : scc) {
+      new_indices[old_idx] = old_indices.size();
+      old_indices.push_back(old_idx);
+    }
+  }
+  std::vector<Component> sorted_components;
+  std::vector<int> sorted_inputs;
+  sorted_components.reserve(count);
+  sorted_inputs.reserve(inputs_.size());
+  for (const auto old_idx : old_indices) {
+    auto component = components_[old_idx];
+    const auto first_input = sorted_inputs.size();
+    for (auto j = 0; j < component.input_count; ++j) {
+      sorted_inputs.push_back(new_indices[inputs_[component.first_input + j]]);
+    }
+    component.first_input = first_input;
+    sorted_components.push_back(component);
+  }
+  components_.swap(sorted_components);
+  inputs_.swap(sorted_inputs);
+  for (auto& proposition : literal_to_proposition_) {
+    proposition = new_indices[proposition];
+  }
+
+  // Split components into those evaluated per state and per joint action
+  auto begin = 0;
+  for (const auto& scc : sccs) {
+    const auto end = begin + static_cast<int>(scc.size());
+    auto is_recursive = scc.size() > 1;
+    auto depends_on_does = false;
+    for (auto i = begin; i < end; ++i) {
+      const auto& component = components_[i];
+      depends_on_does = depends_on_does || component.depends_on_does;
+      for (auto j = 0; j < component.input_count; ++j) {
+        const auto input = inputs_[component.first_input + j];
+        if (input == i) {
+          is_recursive = true;
+        }
+        if (input < begin) {
+          depends_on_does = depends_on_does || components_[input].depends_on_does;
+        }
+      }
+    }
+    for (auto i = begin; i < end; ++i) {
+      components_[i].depends_on_does = depends_on_does;
+    }
+    if (components_[begin].type != ComponentType::kInput) {
+      auto& blocks = depends_on_does ? joint_action_blocks_ : state_blocks_;
+      blocks.push_back(Block{begin, end, is_recursive});
+    }
+    begin = end;
+  }
+}
+
+template <class T>
+bool Propnet::EvaluateComponent(const int component_idx, std::vector<T>& values) const {
+  const auto& component = components_[component_idx];
+  const auto first = inputs_.begin() + component.first_input;
+  const auto last = first + component.input_count;
+  T value = 0;
+  switch (component.type) {
+  case ComponentType::kAnd:
+    value = ~T(0);
+    for (auto it = first; it != last; ++it) {
+      value &= values[*it];
+    }
+    break;
+  case ComponentType::kOr:
+    for (auto it = first; it != last; ++it) {
+      value |= values[*it];
+    }
+    break;
+  case ComponentType::kNot:
+    value = ~values[*first];
+    break;
+  case ComponentType::kInput:
+    return false;
+  }
+  const auto changed = values[component_idx] != value;
+  values[component_idx] = value;
+  return changed;
+}
+
+template <class T>
+void Propnet::Evaluate(const std::vector<Block>& blocks, std::vector<T>& values) const {
+  for (const auto& block : blocks) {
+    if (!block.is_recursive) {
+      EvaluateComponent(block.begin, values);
+      continue;
+    }
+    // Least fixpoint of recursive relations
+    std::fill(values.begin() + block.begin, values.begin() + block.end, 0);
+    auto changed = true;
+    while (changed) {
+      changed = false;
+      for (auto i = block.begin; i < block.end; ++i) {
+        changed = EvaluateComponent(i, values) || changed;
+      }
+    }
+  }
+}
+
+const GameDataCsp& Propnet::GetGame() const {
+  return game_;
+}
+
+int Propnet::GetComponentCount() const {
+  return components_.size();
+}
+
+void Propnet::SetFacts(const FactSet& facts, Values& values) const {
+  values.resize(components_.size());
+  for (const auto proposition : base_propositions_) {
+    values[proposition] = 0;
+  }
+  for (const auto& fact : facts) {
+    const auto it = fact_to_base_idx_.find(fact);
+    if (it != fact_to_base_idx_.end()) {
+      values[base_propositions_[it->second]] = kTrue;
+    }
+  }
+  Evaluate(state_blocks_, values);
+}
+
+void Propnet::SetJointAction(const JointAction& joint_action, Values& values) const {
+  assert(joint_action.size() == does_propositions_.size());
+  for (auto role_idx = 0; role_idx < static_cast<int>(does_propositions_.size()); ++role_idx) {
+    for (const auto& entry : does_propositions_[role_idx]) {
+      values[entry.second] = 0;
+    }
+    const auto it = does_propositions_[role_idx].find(joint_action[role_idx]);
+    if (it != does_propositions_[role_idx].end()) {
+      values[it->second] = kTrue;
+    }
+  }
+  Evaluate(joint_action_blocks_, values);
+}
+
+void Propnet::Transit(Values& values) const {
+  for (auto i = 0; i < static_cast<int>(base_propositions_.size()); ++i) {
+    const auto next_proposition = next_propositions_[i];
+    values[base_propositions_[i]] = next_proposition >= 0 ? values[next_proposition] : 0;
+  }
+  Evaluate(state_blocks_, values);
+}
+
+FactSet Propnet::GetFacts(const Values& values) const {
+  FactSet facts;
+  for (auto i = 0; i < static_cast<int>(base_propositions_.size()); ++i) {
+    if (values[base_propositions_[i]]) {
+      facts.push_back(base_facts_[i]);
+    }
+  }
+  return facts;
+}
+
+FactSet Propnet::GetNextFacts(const Values& values) const {
+  FactSet facts;
+  for (auto i = 0; i < static_cast<int>(next_propositions_.size()); ++i) {
+    if (next_propositions_[i] >= 0 && values[next_propositions_[i]]) {
+      facts.push_back(base_facts_[i]);
+    }
+  }
+  return facts;
+}
+
+std::vector<ActionSet> Propnet::GetLegalActions(const Values& values) const {
+  std::vector<ActionSet> legal_actions(legal_propositions_.size());
+  for (auto role_idx = 0; role_idx < static_cast<int>(legal_propositions_.size()); ++role_idx) {
+    for (const auto& entry : legal_propositions_[role_idx]) {
+      if (values[entry.first]) {
+        legal_actions[role_idx].push_back(entry.second);
+      }
+    }
+  }
+  return legal_actions;
+}
+
+bool Propnet::IsTerminal(const Values& values) const {
+  return values[terminal_proposition_];
+}
+
+std::vector<int> Propnet::GetGoals(const Values& values) const {
+  std::vector<int> goals(goal_propositions_.size(), 0);
+  for (auto role_idx = 0; role_idx < static_cast<int>(goal_propositions_.size()); ++role_idx) {
+    for (const auto& entry : goal_propositions_[role_idx]) {
+      if (values[entry.first]) {
+        goals[role_idx] = entry.second;
+        break;
+      }
+    }
+  }
+  return goals;
+}
+
+std::vector<int> Propnet::Simulate(Values& values, std::mt19937& random_engine) const {
+  const auto role_count = static_cast<int>(legal_propositions_.size());
+  std::vector<int> legal_indices;
+  JointAction joint_action(role_count);
+  while (!IsTerminal(values)) {
+    for (auto role_idx = 0; role_idx < role_count; ++role_idx) {
+      const auto& propositions = legal_propositions_[role_idx];
+      legal_indices.clear();
+      for (auto i = 0; i < static_cast<int>(propositions.size()); ++i) {
+        if (values[propositions[i].first]) {
+          legal_indices.push_back(i);
+        }
+      }
+      if (legal_indices.empty()) {
+        throw std::runtime_error("Every role must always have at least one legal action.");
+      }
+      std::uniform_int_distribution<int> dist(0, legal_indices.size() - 1);
+      joint_action[role_idx] = propositions[legal_indices[dist(random_engine)]].second;
+    }
+    SetJointAction(joint_action, values);
+    Transit(values);
+  }
+  return GetGoals(values);
+}
+
+std::vector<std::vector<int>> Propnet::Simulate(
+    const std::vector<FactSet>& initial_facts_list,
+    std::mt19937& random_engine) const {
+  const auto role_count = static_cast<int>(legal_propositions_.size());
+  const auto playout_count = static_cast<int>(initial_facts_list.size());
+  std::vector<std::vector<int>> goals_list(playout_count);
+  Words words(components_.size(), 0);
+  // Index of the playout in each lane, or -1 if the lane is idle
+  std::array<int, kLaneCount> lane_playouts;
+  lane_playouts.fill(-1);
+  Word active = 0;
+  auto next_playout = 0;
+  // Indices of legal propositions for each lane
+  std::array<std::vector<int>, kLaneCount> legal_indices;
+  while (true) {
+    // Refill idle lanes with new playouts
+    for (auto lane = 0; lane < kLaneCount && next_playout < playout_count; ++lane) {
+      if (lane_playouts[lane] >= 0) {
+        continue;
+      }
+      const auto lane_bit = Word(1) << lane;
+      for (const auto proposition : base_propositions_) {
+        words[proposition] &= ~lane_bit;
+      }
+      for (const auto& fact : initial_facts_list[next_playout]) {
+        const auto it = fact_to_base_idx_.find(fact);
+        if (it != fact_to_base_idx_.end()) {
+          words[base_propositions_[it->second]] |= lane_bit;
+        }
+      }
+      lane_playouts[lane] = next_playout++;
+      active |= lane_bit;
+    }
+    if (!active) {
+      break;
+    }
+    Evaluate(state_blocks_, words);
+    // Collect goals of finished lanes
+    const auto terminal = words[terminal_proposition_] & active;
+    for (auto lane = 0; lane < kLaneCount; ++lane) {
+      const auto lane_bit = Word(1) << lane;
+      if (!(terminal & lane_bit)) {
+        continue;
+      }
+      auto& goals = goals_list[lane_playouts[lane]];
+      goals.assign(role_count, 0);
+      for (auto role_idx = 0; role_idx < role_count; ++role_idx) {
+        for (const auto& entry : goal_propositions_[role_idx]) {
+          if (words[entry.first] & lane_bit) {
+            goals[role_idx] = entry.second;
+            break;
+          }
+        }
+      }
+      lane_playouts[lane] = -1;
+      active &= ~lane_bit;
+    }
+    if (terminal) {
+      // Finished lanes are refilled before going on
+      continue;
+    }
+    // Choose a random legal action in each active lane
+    for (const auto proposition : does_proposition_list_) {
+      words[proposition] = 0;
+    }
+    for (auto role_idx = 0; role_idx < role_count; ++role_idx) {
+      const auto& propositions = legal_propositions_[role_idx];
+      for (auto& indices : legal_indices) {
+        indices.clear();
+      }
+      for (auto i = 0; i < static_cast<int>(propositions.size()); ++i) {
+        auto lanes = words[propositions[i].first] & active;
+        while (lanes) {
+          const auto lane = __builtin_ctzll(lanes);
+          legal_indices[lane].push_back(i);
+          lanes &= lanes - 1;
+        }
+      }
+      for (auto lane = 0; lane < kLaneCount; ++lane) {
+        if (!(active & (Word(1) << lane))) {
+          continue;
+        }
+        const auto& indices = legal_indices[lane];
+        if (indices.empty()) {
+          throw std::runtime_error("Every role must always have at least one legal action.");
+        }
+        std::uniform_int_distribution<int> dist(0, indices.size() - 1);
+        const auto does_proposition = legal_does_propositions_[role_idx][indices[dist(random_engine)]];
+        if (does_proposition >= 0) {
+          words[does_proposition] |= Word(1) << lane;
+        }
+      }
+    }
+    Evaluate(joint_action_blocks_, words);
+    for (auto i = 0; i < static_cast<int>(base_propositions_.size()); ++i) {
+      const auto next_proposition = next_propositions_[i];
+      words[base_propositions_[i]] = next_proposition >= 0 ? words[next_proposition] : 0;
+    }
+  }
+  return goals_list;
+}
+
+PropnetState::PropnetState(
+    const PropnetSp& propnet,
+    const FactSet& facts,
+    const std::vector<JointAction>& joint_action_history) :
+        propnet_(propnet),
+        facts_(facts),
+        values_(),
+        legal_actions_(),
+        is_terminal_(false),
+        goals_(),
+        joint_action_history_(joint_action_history) {
+  propnet_->SetFacts(facts_, values_);
+  is_terminal_ = propnet_->IsTerminal(values_);
+  if (is_terminal_) {
+    goals_ = propnet_->GetGoals(values_);
+  } else {
+    legal_actions_ = propnet_->GetLegalActions(values_);
+  }
+}
+
+const FactSet& PropnetState::GetFacts() const {
+  return facts_;
+}
+
+const std::vector<ActionSet>& PropnetState::GetLegalActions() const {
+  return legal_actions_;
+}
+
+StateSp PropnetState::GetNextState(const JointAction& joint_action) const {
+  auto values = values_;
+  propnet_->SetJointAction(joint_action, values);
+  auto next_joint_action_history = joint_action_history_;
+  next_joint_action_history.push_back(joint_action);
+  return std::make_shared<PropnetState>(
+      propnet_,
+      propnet_->GetNextFacts(values),
+      next_joint_action_history);
+}
+
+bool PropnetState::IsTerminal() const {
+  return is_terminal_;
+}
+
+const std::vector<int>& PropnetState::GetGoals() const {
+  assert(is_terminal_);
+  return goals_;
+}
+
+std::vector<int> PropnetState::Simulate() const {
+  auto values = values_;
+  return propnet_->Simulate(values, GetRandomEngine());
+}
+
+std::vector<std::vector<int>> PropnetState::SimulateBatch(const int count) const {
+  return propnet_->Simulate(std::vector<FactSet>(count, facts_), GetRandomEngine());
+}
+
+const std::vector<JointAction>& PropnetState::GetJointActionHistory() const {
+  return joint_action_history_;
+}
+
+std::string PropnetState::ToString() const {
+  std::ostringstream o;
+  for (const auto& fact : facts_) {
+    o << propnet_->GetGame()->TupleToString(fact) << std::endl;
+  }
+  return o.str();
+}
+
+PropnetSp CreatePropnet(const GameDataCsp& game) {
+  const auto program = grounder::Ground(game->nodes, *game);
+  return std::make_shared<Propnet>(game, program);
+}
+
+StateSp CreateInitialState(const PropnetSp& propnet) {
+  return std::make_shared<PropnetState>(
+      propnet,
+      propnet->GetGame()->initial_facts,
+      std::vector<JointAction>());
+}
+
+StateSp CreateState(const PropnetSp& propnet, const FactSet& facts) {
+  return std::make_shared<PropnetState>(propnet, facts, std::vector<JointAction>());
+}
+
+}
+}
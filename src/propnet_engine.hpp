@@ -0,0 +1,174 @@
+#ifndef PROPNET_ENGINE_HPP_
+#define PROPNET_ENGINE_HPP_
+
+#include <cstdint>
+#include <random>
+
+#include "ggpe.hpp"
+#include "state.hpp"
+#include "game_data.hpp"
+#include "grounder.hpp"
+
+namespace ggpe {
+namespace propnet {
+
+/**
+ * Propositional network of a game.
+ *
+ * Ground rules are turned into AND/OR/NOT components over propositions, one
+ * for each ground literal. Propositions of 'true' and 'does' are inputs, and each proposition of
+ * 'next' is latched into the 'true' proposition of the same fact. Components
+ * are stored in a flat array sorted topologically, thus a state is evaluated
+ * by a single forward pass (recursive relations are iterated until they
+ * converge).
+ */
+class Propnet {
+public:
+  /**
+   * Value of a proposition for a single state (true is all ones)
+   */
+  using Value = std::uint8_t;
+  using Values = std::vector<Value>;
+  /**
+   * Values of a proposition for 64 states, one bit for each lane
+   */
+  using Word = std::uint64_t;
+  using Words = std::vector<Word>;
+  static constexpr Value kTrue = 0xff;
+  static constexpr int kLaneCount = 64;
+
+  Propnet(const GameDataCsp& game, const grounder::GroundProgram& program);
+  Propnet(const Propnet&) = delete;
+  Propnet& operator=(const Propnet&) = delete;
+
+  const GameDataCsp& GetGame() const;
+  int GetComponentCount() const;
+
+  /**
+   * Set 'true' propositions and evaluate the components which do not depend
+   * on 'does'
+   */
+  void SetFacts(const FactSet& facts, Values& values) const;
+  /**
+   * Set 'does' propositions and evaluate the components which depend on them
+   */
+  void SetJointAction(const JointAction& joint_action, Values& values) const;
+  /**
+   * Latch 'next' propositions into 'true' propositions and evaluate the
+   * components which do not depend on 'does'
+   */
+  void Transit(Values& values) const;
+
+  FactSet GetFacts(const Values& values) const;
+  FactSet GetNextFacts(const Values& values) const;
+  std::vector<ActionSet> GetLegalActions(const Values& values) const;
+  bool IsTerminal(const Values& values) const;
+  std::vector<int> GetGoals(const Values& values) const;
+  /**
+   * Play random legal actions from evaluated values until terminal
+   * @return goals of the terminal state
+   */
+  std::vector<int> Simulate(Values& values, std::mt19937& random_engine) const;
+  /**
+   * Play random playouts from given states, 64 of them at once in the lanes
+   * of words. A lane is refilled with the next state when its playout ends.
+   * @return goals for each given state
+   */
+  std::vector<std::vector<int>> Simulate(
+      const std::vector<FactSet>& initial_facts_list,
+      std::mt19937& random_engine) const;
+
+private:
+  enum class ComponentType : std::uint8_t {
+    kInput, kAnd, kOr, kNot
+  };
+  struct Component {
+    ComponentType type;
+    bool depends_on_does;
+    int first_input;
+    int input_count;
+  };
+  /**
+   * Range of the sorted components, which must be iterated until it
+   * converges if it is recursive
+   */
+  struct Block {
+    int begin;
+    int end;
+    bool is_recursive;
+  };
+  int AddComponent(const ComponentType type, const std::vector<int>& inputs);
+  void Sort();
+  template <class T>
+  void Evaluate(const std::vector<Block>& blocks, std::vector<T>& values) const;
+  template <class T>
+  bool EvaluateComponent(const int component_idx, std::vector<T>& values) const;
+
+  GameDataCsp game_;
+  std::vector<Component> components_;
+  std::vector<int> inputs_;
+  std::vector<Block> state_blocks_;
+  std::vector<Block> joint_action_blocks_;
+  // Proposition of each literal of the ground program
+  std::vector<int> literal_to_proposition_;
+  // 'true' propositions
+  std::vector<Fact> base_facts_;
+  std::vector<int> base_propositions_;
+  std::unordered_map<Fact, int, boost::hash<Fact>> fact_to_base_idx_;
+  // 'next' proposition for each 'true' proposition, or -1
+  std::vector<int> next_propositions_;
+  // 'does' propositions for each role
+  std::vector<std::unordered_map<Action, int, boost::hash<Action>>> does_propositions_;
+  // 'legal' propositions for each role
+  std::vector<std::vector<std::pair<int, Action>>> legal_propositions_;
+  // 'does' proposition of each 'legal' proposition, or -1
+  std::vector<std::vector<int>> legal_does_propositions_;
+  std::vector<int> does_proposition_list_;
+  // 'goal' propositions for each role
+  std::vector<std::vector<std::pair<int, int>>> goal_propositions_;
+  // 'terminal' proposition, or -1
+  int terminal_proposition_;
+};
+
+using PropnetSp = std::shared_ptr<const Propnet>;
+
+class PropnetState : public State {
+public:
+  PropnetState(
+      const PropnetSp& propnet,
+      const FactSet& facts,
+      const std::vector<JointAction>& joint_action_history);
+  const FactSet& GetFacts() const override;
+  const std::vector<ActionSet>& GetLegalActions() const override;
+  StateSp GetNextState(const JointAction& joint_action) const override;
+  bool IsTerminal() const override;
+  const std::vector<int>& GetGoals() const override;
+  std::vector<int> Simulate() const override;
+  std::vector<std::vector<int>> SimulateBatch(const int count) const override;
+  const std::vector<JointAction>& GetJointActionHistory() const override;
+  std::string ToString() const override;
+private:
+  PropnetSp propnet_;
+  FactSet facts_;
+  Propnet::Values values_;
+  std::vector<ActionSet> legal_actions_;
+  bool is_terminal_;
+  std::vector<int> goals_;
+  std::vector<JointAction> joint_action_history_;
+};
+
+/**
+ * Ground the rules of a given game and build its propnet.
+ * Throws std::runtime_error if 'terminal' is never derived by the ground
+ * rules.
+ */
+PropnetSp CreatePropnet(const GameDataCsp& game);
+
+StateSp CreateInitialState(const PropnetSp& propnet);
+
+StateSp CreateState(const PropnetSp& propnet, const FactSet& facts);
+
+}
+}
+
+#endif /* PROPNET_ENGINE_HPP_ */
@@ -0,0 +1,104 @@
+#include "ggpe.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <stdexcept>
+
+#include <boost/format.hpp>
+
+namespace ggpe {
+
+namespace {
+
+/**
+ * @return the number of arguments of the outermost functor of a tuple
+ */
+int CountArgs(const Tuple& tuple) {
+  auto depth = 0;
+  auto count = 0;
+  for (auto it = tuple.begin() + 1; it != tuple.end(); ++it) {
+    if (*it == atoms::kLeftParen) {
+      if (depth == 0) {
+        ++count;
+      }
+      ++depth;
+    } else if (*it == atoms::kRightParen) {
+      --depth;
+    } else if (depth == 0) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+int GetMaxArity() {
+  auto max_arity = 0;
+  for (const auto& fact : GetPossibleFacts()) {
+    max_arity = std::max(max_arity, CountArgs(fact));
+  }
+  for (const auto& actions : GetPossibleActions()) {
+    for (const auto& action : actions) {
+      max_arity = std::max(max_arity, CountArgs(action));
+    }
+  }
+  return max_arity;
+}
+
+}
+
+void GenerateStaticGameHeader(
+    const std::string& header_filename,
+    const std::string& struct_name) {
+  assert(GetDefaultGame());
+  const auto& kif = GetDefaultGame()->GetKif();
+  const auto& name = GetGameName();
+  // Symbols of the static library are prefixed with the game name
+  const auto create_initial_state = name + "_CreateInitialState";
+  const auto get_abi_version = name + "_GetABIVersion";
+  const auto set_atom_table = name + "_SetAtomTable";
+  const auto create_state = name + "_CreateState";
+  const auto guard = struct_name + "_HPP_";
+  std::ofstream ofs(header_filename);
+  if (!ofs) {
+    throw std::runtime_error("Cannot write '" + header_filename + "'.");
+  }
+  ofs << "// Generated by \"make static_game\". Do not edit.\n";
+  ofs << "#ifndef " << guard << "\n";
+  ofs << "#define " << guard << "\n\n";
+  ofs << "#include <ggpe/static_game.hpp>\n\n";
+  ofs << "extern \"C\" ggpe::StateSp " << create_initial_state << "();\n";
+  // Those of the binary interface are weak, i.e. null if not exported
+  ofs << "extern \"C\" __attribute__((weak)) int " << get_abi_version << "();\n";
+  ofs << "extern \"C\" __attribute__((weak)) bool " << set_atom_table <<
+      "(const ggpe::gdlcc_abi::AtomTable& atom_table);\n";
+  ofs << "extern \"C\" __attribute__((weak)) ggpe::StateSp " << create_state <<
+      "(const ggpe::FactSet& facts);\n\n";
+  ofs << "struct " << struct_name << " {\n";
+  ofs << "  static constexpr const char* kName = \"" << name << "\";\n";
+  ofs << "  static constexpr int kRoleCount = " << GetRoleCount() << ";\n";
+  ofs << "  static constexpr int kFactCount = " << GetPossibleFacts().size() << ";\n";
+  ofs << "  static constexpr int kMaxArity = " << GetMaxArity() << ";\n";
+  // std::array is not usable in constant expressions of C++11
+  ofs << "  static constexpr int ActionCount(const int role_idx) {\n";
+  ofs << "    return ";
+  for (auto i = 0; i < static_cast<int>(GetPossibleActions().size()); ++i) {
+    ofs << "role_idx == " << i << " ? " << GetPossibleActions()[i].size() << " : ";
+  }
+  ofs << "0;\n";
+  ofs << "  }\n";
+  ofs << "  static const char* Kif() {\n";
+  ofs << "    return R\"ggpe_kif(" << kif << ")ggpe_kif\";\n";
+  ofs << "  }\n";
+  ofs << "  static ggpe::StateSp CreateInitialState() {\n";
+  ofs << "    return " << create_initial_state << "();\n";
+  ofs << "  }\n";
+  ofs << "  static ggpe::gdlcc_abi::StaticSymbols Symbols() {\n";
+  ofs << "    return {&" << create_initial_state << ", &" << get_abi_version <<
+      ", &" << set_atom_table << ", &" << create_state << "};\n";
+  ofs << "  }\n";
+  ofs << "};\n\n";
+  ofs << "#endif /* " << guard << " */\n";
+}
+
+}
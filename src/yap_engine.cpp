@@ -1,58 +1,46 @@
 #include "yap_engine.hpp"
 
 #include <algorithm>
+#include <chrono>
 #include <cassert>
 #include <cstdlib>
+#include <ctime>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <iterator>
 #include <sstream>
 #include <thread>
 #include <mutex>
 #include <unordered_map>
 #include <unordered_set>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <boost/format.hpp>
 #include <boost/filesystem.hpp>
-#include <boost/timer.hpp>
 #include <boost/functional/hash.hpp>
 #include <boost/bimap/bimap.hpp>
 #include <boost/bimap/unordered_set_of.hpp>
 #include <Yap/YapInterface.h>
 #include <glog/logging.h>
 
+#include "analysis_bundle.hpp"
+#include "datalog_engine.hpp"
+#include "optimizer.hpp"
 #include "sexpr_parser.hpp"
 #include "file_utils.hpp"
+#include "initialization_report.hpp"
 
 namespace ggpe {
 
 // Types
-template <class K, class V>
-using UnorderedBimap = boost::bimaps::bimap<boost::bimaps::unordered_set_of<K>, boost::bimaps::unordered_set_of<V>>;
 using AtomAndYapAtom = UnorderedBimap<Atom, YAP_Atom>::value_type;
-using AtomAndString = UnorderedBimap<Atom, std::string>::value_type;
 
 // Constants
 const auto kAtomOffset = 512;
 
-// Global variables
-extern UnorderedBimap<Atom, std::string> atom_to_string;
-extern std::string game_name;
-extern std::vector<Atom> roles;
-extern std::vector<int> role_indices;
-extern std::unordered_map<Atom, int> atom_to_role_index;
-extern std::unordered_map<Atom, int> atom_to_goal_values;
-extern std::vector<Tuple> initial_facts;
-extern std::vector<Tuple> possible_facts;
-extern std::vector<std::vector<Tuple>> possible_actions;
-extern std::unordered_map<Atom, std::unordered_map<Atom, int>> atom_to_ordered_domain;
-extern std::unordered_set<Atom> step_counter_atoms;
-extern std::unordered_map<AtomPair, std::vector<std::pair<Atom, std::pair<int, int>>>, boost::hash<AtomPair>> fact_action_connections;
-extern std::unordered_map<Atom, std::unordered_map<int, Atom>> fact_ordered_args;
-extern std::unordered_map<Atom, std::unordered_map<int, Atom>> action_ordered_args;
-extern std::string game_kif;
-extern bool game_enables_tabling;
-extern std::vector<std::vector<FactSet>> win_conditions;
-
 namespace yap {
 
 namespace {
@@ -62,10 +50,26 @@ using Mutex = std::mutex;
 
 // Constants
 const auto kPrefix = std::string("gdl_");
+// Playouts run to profile relations for tabling
+const auto kProfilingPlayoutCount = 20;
+// Relations are tabling candidates if they take this share of calls or more
+const auto kTablingShareThreshold = 0.05;
+// Relations are tabled only if playouts get faster than this ratio
+const auto kTablingSpeedupThreshold = 0.9;
 
 // Global variables
 Mutex mutex;
+// Guards which lazy analyses have completed, so that getters of completed
+// analyses do not wait for YAP running another one
+Mutex analysis_mutex;
+// The game whose rules YAP holds
+GameDataSp bound_game;
 UnorderedBimap<Atom, YAP_Atom> atom_to_yap_atom;
+// YAP atoms looked up so far, which stay valid until YAP is initialized again
+// because atom garbage collection is disabled
+std::unordered_map<std::string, YAP_Atom> string_to_yap_atom;
+// The game program compiled into YAP, which is unloaded to switch games
+std::string loaded_game_prolog_path;
 // []
 YAP_Term empty_list_term;
 // role/1
@@ -103,6 +107,10 @@ YAP_Functor state_partial_goal_functor;
 YAP_Functor state_win_conditions_functor;
 // next_conditions/2
 YAP_Functor next_conditions_functor;
+// time_out/3
+YAP_Functor time_out_functor;
+// success
+YAP_Atom success_atom;
 
 // Utility functions
 template <class SuccessHandler, class FailureHandler>
@@ -125,6 +133,15 @@ void RunWithSlot(
 #endif
 }
 
+/**
+ * YAP holds the rules of only one game, thus queries for others must fail
+ */
+void CheckBound(const GameDataCsp& game) {
+  if (game != bound_game) {
+    throw std::runtime_error("YAP Prolog holds the rules of another game.");
+  }
+}
+
 template <class SuccessHandler>
 void RunWithSlotOrError(
     const YAP_Term& goal,
@@ -135,6 +152,39 @@ void RunWithSlotOrError(
   });
 }
 
+/**
+ * Run a goal with time_out/3 of YAP if a deadline is given
+ * @return false if the deadline passed before the goal completed, in which
+ * case neither handler is called
+ */
+template <class SuccessHandler, class FailureHandler>
+bool RunWithSlotUntil(
+    const YAP_Term& goal,
+    const boost::optional<Deadline>& deadline,
+    SuccessHandler success_handler,
+    FailureHandler failure_handler) {
+  if (!deadline) {
+    RunWithSlot(goal, success_handler, failure_handler);
+    return true;
+  }
+  const auto time_limit_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+      *deadline - std::chrono::steady_clock::now()).count();
+  if (time_limit_ms <= 0) {
+    return false;
+  }
+  std::array<YAP_Term, 3> args = {{ goal, YAP_MkIntTerm(time_limit_ms), YAP_MkVarTerm() }};
+  auto time_out_goal = YAP_MkApplTerm(time_out_functor, 3, args.data());
+  auto is_completed = true;
+  RunWithSlot(time_out_goal, [&](const YAP_Term& result){
+    if (YAP_AtomOfTerm(YAP_ArgOfTerm(3, result)) == success_atom) {
+      success_handler(YAP_ArgOfTerm(1, result));
+    } else {
+      is_completed = false;
+    }
+  }, failure_handler);
+  return is_completed;
+}
+
 std::string AtomsToString(const std::vector<Atom>& atoms) {
   std::ostringstream o;
   o << '[';
@@ -142,7 +192,7 @@ std::string AtomsToString(const std::vector<Atom>& atoms) {
     if (i != atoms.begin()) {
       o << ", ";
     }
-    o << AtomToString(*i);
+    o << bound_game->AtomToString(*i);
   }
   o << ']';
   return o.str();
@@ -167,12 +217,12 @@ Atom YapAtomToAtom(const YAP_Atom yap_atom) {
 }
 
 YAP_Atom StringToYapAtom(const std::string& atom_str) {
-  assert(atom_to_yap_atom.left.count(StringToAtom(atom_str)));
-  return AtomToYapAtom(StringToAtom(atom_str));
+  assert(atom_to_yap_atom.left.count(bound_game->StringToAtom(atom_str)));
+  return AtomToYapAtom(bound_game->StringToAtom(atom_str));
 }
 
 const std::string& YapAtomToString(const YAP_Atom yap_atom) {
-  return AtomToString(YapAtomToAtom(yap_atom));
+  return bound_game->AtomToString(YapAtomToAtom(yap_atom));
 }
 
 Atom YapTermToAtom(const YAP_Term term) {
@@ -186,7 +236,7 @@ YAP_Term AtomToYapTerm(const Atom atom) {
 
 std::string YapAtomTermToString(const YAP_Term& term) {
   assert(YAP_IsAtomTerm(term));
-  return AtomToString(YapTermToAtom(term));
+  return bound_game->AtomToString(YapTermToAtom(term));
 }
 
 std::string YapTermToString(const YAP_Term& term);
@@ -279,9 +329,9 @@ YAP_Term TupleToYapTerm(const Tuple& tuple) {
 //  std::cout << "TupleToYapTerm" << std::endl;
 //  std::cout << "size=" << tuple.size() << std::endl;
 //  for (const auto& atom : tuple) {
-//    std::cout << atom << ' ' << AtomToString(atom) << std::endl;
+//    std::cout << atom << ' ' << bound_game->AtomToString(atom) << std::endl;
 //  }
-//  std::cout << TupleToString(tuple) << std::endl;
+//  std::cout << bound_game->TupleToString(tuple) << std::endl;
   assert(!tuple.empty());
   if (tuple.size() == 1) {
 //    std::cout << "size=1 atom=" << tuple.front() << std::endl;
@@ -316,7 +366,7 @@ std::vector<Tuple> YapPairTermToTuples(const YAP_Term pair_term) {
 
 std::vector<std::vector<Tuple>> YapPairTermToActions(const YAP_Term pair_term) {
   assert(YAP_IsPairTerm(pair_term));
-  std::vector<std::vector<Tuple>> actions(GetRoleCount());
+  std::vector<std::vector<Tuple>> actions(bound_game->roles.size());
   auto temp_term = pair_term;
   auto pair_count = 0;
   while (YAP_IsPairTerm(temp_term)) {
@@ -327,20 +377,20 @@ std::vector<std::vector<Tuple>> YapPairTermToActions(const YAP_Term pair_term) {
     const auto role_atom = YapTermToAtom(role_term);
     const auto action_term = YAP_HeadOfTerm(YAP_TailOfTerm(pair));
     assert(YAP_IsPairTerm(action_term));
-    assert(atom_to_role_index.count(role_atom));
-    const auto role_index = atom_to_role_index[role_atom];
+    assert(bound_game->atom_to_role_index.count(role_atom));
+    const auto role_index = bound_game->atom_to_role_index[role_atom];
     actions[role_index] = YapPairTermToTuples(action_term);
     temp_term = YAP_TailOfTerm(temp_term);
     ++pair_count;
   }
   assert(temp_term == empty_list_term);
-  assert(pair_count == static_cast<int>(GetRoleCount()));
+  assert(pair_count == static_cast<int>(bound_game->roles.size()));
   return actions;
 }
 
 std::vector<int> YapPairTermToGoals(const YAP_Term pair_term) {
   assert(YAP_IsPairTerm(pair_term) || pair_term == empty_list_term);
-  std::vector<int> goals(GetRoleCount());
+  std::vector<int> goals(bound_game->roles.size());
   auto temp_term = pair_term;
   auto goal_count = 0;
   while (YAP_IsPairTerm(temp_term)) {
@@ -350,24 +400,24 @@ std::vector<int> YapPairTermToGoals(const YAP_Term pair_term) {
     assert(YAP_IsAtomTerm(role_term));
     const auto role_atom = YapTermToAtom(role_term);
     const auto goal_term = YAP_HeadOfTerm(YAP_TailOfTerm(pair));
-    assert(atom_to_role_index.count(role_atom));
+    assert(bound_game->atom_to_role_index.count(role_atom));
     if (YAP_IsAtomTerm(goal_term)) {
       const auto goal_atom = YapTermToAtom(goal_term);
-      assert(atom_to_goal_values.count(goal_atom));
-      goals[atom_to_role_index[role_atom]] = atom_to_goal_values[goal_atom];
+      assert(bound_game->atom_to_goal_values.count(goal_atom));
+      goals[bound_game->atom_to_role_index[role_atom]] = bound_game->atom_to_goal_values[goal_atom];
     } else {
       assert(YAP_IsIntTerm(goal_term));
       const auto goal_value = YAP_IntOfTerm(goal_term);
       assert(goal_value >= 0);
       assert(goal_value <= 100);
-      goals[atom_to_role_index[role_atom]] = goal_value;
+      goals[bound_game->atom_to_role_index[role_atom]] = goal_value;
     }
     temp_term = YAP_TailOfTerm(temp_term);
     ++goal_count;
   }
   assert(temp_term == empty_list_term);
-  assert(goal_count <= static_cast<int>(GetRoleCount()));
-  if (goal_count < static_cast<int>(GetRoleCount())) {
+  assert(goal_count <= static_cast<int>(bound_game->roles.size()));
+  if (goal_count < static_cast<int>(bound_game->roles.size())) {
     return std::vector<int>();
   }
   return goals;
@@ -415,10 +465,10 @@ YAP_Term YapTermsToYapPairTerm(const YAP_Term& x, const YAP_Term& y) {
 YAP_Term JointActionToYapPairTerm(const std::vector<Tuple>& joint_action) {
   assert(!joint_action.empty());
   auto temp = empty_list_term;
-  for (const auto role_idx : GetRoleIndices()) {
+  for (const auto role_idx : bound_game->role_indices) {
     const auto role_action_pair =
         YapTermsToYapPairTerm(
-            AtomToYapTerm(roles[role_idx]),
+            AtomToYapTerm(bound_game->roles[role_idx]),
             TupleToYapTerm(joint_action[role_idx]));
     temp = YAP_MkPairTerm(role_action_pair, temp);
   }
@@ -445,12 +495,14 @@ void CacheConstantYapObjects() {
   state_partial_goal_functor = YAP_MkFunctor(YAP_LookupAtom("state_partial_goal"), 2);
   state_win_conditions_functor = YAP_MkFunctor(YAP_LookupAtom("state_win_conditions"), 1);
   next_conditions_functor = YAP_MkFunctor(YAP_LookupAtom("next_conditions"), 2);
+  time_out_functor = YAP_MkFunctor(YAP_LookupAtom("time_out"), 3);
+  success_atom = YAP_LookupAtom("success");
 }
 
 void CacheRoles() {
-  roles.clear();
-  role_indices.clear();
-  atom_to_role_index.clear();
+  bound_game->roles.clear();
+  bound_game->role_indices.clear();
+  bound_game->atom_to_role_index.clear();
   std::array<YAP_Term, 1> args = {{ YAP_MkVarTerm() }};
   auto goal = YAP_MkApplTerm(state_role_functor, 1, args.data());
   RunWithSlotOrError(goal, [&](const YAP_Term& result){
@@ -459,28 +511,28 @@ void CacheRoles() {
     assert(!role_terms.empty() && "There must be at least one role.");
     for (const auto role_term : role_terms) {
       const auto role_atom = YapTermToAtom(role_term);
-      roles.push_back(role_atom);
-      role_indices.push_back(role_indices.size());
-      atom_to_role_index.emplace(role_atom, atom_to_role_index.size());
+      bound_game->roles.push_back(role_atom);
+      bound_game->role_indices.push_back(bound_game->role_indices.size());
+      bound_game->atom_to_role_index.emplace(role_atom, bound_game->atom_to_role_index.size());
     }
   }, "There must be at least one role.");
 }
 
 void CacheGoalValues(const std::unordered_set<std::string>& non_functor_atom_strs) {
-  atom_to_goal_values.clear();
+  bound_game->atom_to_goal_values.clear();
   for (const auto& atom_str : non_functor_atom_strs) {
     if (std::all_of(atom_str.begin(), atom_str.end(), ::isdigit)) {
       const auto value = std::stoi(atom_str);
       if (value >= 0 && value <= 100) {
-        atom_to_goal_values.emplace(StringToAtom(atom_str), value);
+        bound_game->atom_to_goal_values.emplace(bound_game->StringToAtom(atom_str), value);
       }
     }
   }
-  assert(!atom_to_goal_values.empty() && "No goal is defined.");
+  assert(!bound_game->atom_to_goal_values.empty() && "No goal is defined.");
 }
 
 void CacheInitialFacts() {
-  initial_facts.clear();
+  bound_game->initial_facts.clear();
   std::array<YAP_Term, 1> args = {{ YAP_MkVarTerm() }};
   auto goal = YAP_MkApplTerm(state_init_functor, 1, args.data());
   RunWithSlot(goal, [&](const YAP_Term& result){
@@ -488,7 +540,7 @@ void CacheInitialFacts() {
     const auto terms = YapPairTermToYapTerms(pair_term);
     for (const auto& term : terms) {
       const auto tuple = YapTermToTuple(term);
-      initial_facts.push_back(tuple);
+      bound_game->initial_facts.push_back(tuple);
     }
   }, []{
     // It is possible that there is no initial fact.
@@ -497,7 +549,7 @@ void CacheInitialFacts() {
 }
 
 void CachePossibleFacts() {
-  possible_facts.clear();
+  bound_game->possible_facts.clear();
   std::array<YAP_Term, 1> args = {{ YAP_MkVarTerm() }};
   auto goal = YAP_MkApplTerm(state_base_functor, 1, args.data());
   RunWithSlot(goal, [&](const YAP_Term& result){
@@ -505,7 +557,7 @@ void CachePossibleFacts() {
     const auto terms = YapPairTermToYapTerms(pair_term);
     for (const auto& term : terms) {
       const auto tuple = YapTermToTuple(term);
-      possible_facts.push_back(tuple);
+      bound_game->possible_facts.push_back(tuple);
     }
   }, []{
     // 'base' relation was not found.
@@ -514,40 +566,44 @@ void CachePossibleFacts() {
 }
 
 void CachePossibleActions() {
-  possible_actions.clear();
+  bound_game->possible_actions.clear();
   std::array<YAP_Term, 1> args = {{ YAP_MkVarTerm() }};
   auto goal = YAP_MkApplTerm(state_input_functor, 1, args.data());
   RunWithSlot(goal, [&](const YAP_Term& result){
     const auto role_actions_pairs_term = YAP_ArgOfTerm(1, result);
-    possible_actions = YapPairTermToActions(role_actions_pairs_term);
+    bound_game->possible_actions = YapPairTermToActions(role_actions_pairs_term);
   }, []{
     // 'input' relation was not found.
     std::cout << "Note: 'input' relation was not found." << std::endl;
   });
 }
 
-void DetectStepCounters() {
-  step_counter_atoms.clear();
-  std::cout << "Detecting step counters..." << std::endl;
+bool DetectStepCounters(const boost::optional<Deadline>& deadline) {
+  VLOG(1) << "Detecting step counters...";
+  std::unordered_set<Atom> step_counter_atoms;
   std::array<YAP_Term, 1> args = {{ YAP_MkVarTerm() }};
   auto goal = YAP_MkApplTerm(state_step_counter_functor, 1, args.data());
-  RunWithSlot(goal, [&](const YAP_Term& result){
+  const auto is_completed = RunWithSlotUntil(goal, deadline, [&](const YAP_Term& result){
     const auto step_counter_atoms_term = YAP_ArgOfTerm(1, result);
     assert(YAP_IsPairTerm(step_counter_atoms_term));
     const auto atoms = YapPairTermToAtoms(step_counter_atoms_term);
-    std::cout << "Step counters: " << AtomsToString(atoms) << std::endl;
+    VLOG(1) << "Step counters: " << AtomsToString(atoms);
     step_counter_atoms.insert(atoms.begin(), atoms.end());
   }, []{
     std::cout << "Note: no step counter was found." << std::endl;
   });
+  if (is_completed) {
+    bound_game->step_counter_atoms.swap(step_counter_atoms);
+  }
+  return is_completed;
 }
 
-void DetectOrderedDomains() {
-  std::cout << "Detecting ordered domains..." << std::endl;
-  atom_to_ordered_domain.clear();
+bool DetectOrderedDomains(const boost::optional<Deadline>& deadline) {
+  VLOG(1) << "Detecting ordered domains...";
+  std::unordered_map<Atom, std::unordered_map<Atom, int>> atom_to_ordered_domain;
   std::array<YAP_Term, 1> args = {{ YAP_MkVarTerm() }};
   auto goal = YAP_MkApplTerm(state_ordered_domain_functor, 1, args.data());
-  RunWithSlot(goal, [&](const YAP_Term& result){
+  const auto is_completed = RunWithSlotUntil(goal, deadline, [&](const YAP_Term& result){
     const auto relation_domain_pairs_term = YAP_ArgOfTerm(1, result);
     const auto relation_domain_pair_terms = YapPairTermToYapTerms(relation_domain_pairs_term);
     for (const auto& relation_domain_pair_term : relation_domain_pair_terms) {
@@ -561,7 +617,7 @@ void DetectOrderedDomains() {
       const auto domain_term = terms.back();
       assert(YAP_IsPairTerm(domain_term));
       const auto domain_atoms = YapPairTermToAtoms(domain_term);
-      std::cout << "Domain by " << AtomToString(relation_atom) << ": " << AtomsToString(domain_atoms) << std::endl;
+      VLOG(1) << "Domain by " << bound_game->AtomToString(relation_atom) << ": " << AtomsToString(domain_atoms);
       std::unordered_map<Atom, int> domain_map;
       for (const auto atom : domain_atoms) {
         domain_map.emplace(atom, domain_map.size());
@@ -571,6 +627,10 @@ void DetectOrderedDomains() {
   }, []{
     std::cout << "Note: no ordered domain was found." << std::endl;
   });
+  if (is_completed) {
+    bound_game->atom_to_ordered_domain.swap(atom_to_ordered_domain);
+  }
+  return is_completed;
 }
 
 std::pair<int, int> YapPairTermToIntPair(const YAP_Term& term) {
@@ -583,12 +643,12 @@ std::pair<int, int> YapPairTermToIntPair(const YAP_Term& term) {
   return std::make_pair(first_arg, second_arg);
 }
 
-void DetectFactActionConnections() {
-  std::cout << "Detecting fact-action connections..." << std::endl;
-  fact_action_connections.clear();
+bool DetectFactActionConnections(const boost::optional<Deadline>& deadline) {
+  VLOG(1) << "Detecting fact-action connections...";
+  decltype(bound_game->fact_action_connections) fact_action_connections;
   std::array<YAP_Term, 1> args = {{ YAP_MkVarTerm() }};
   auto goal = YAP_MkApplTerm(state_fact_action_connections_functor, 1, args.data());
-  RunWithSlot(goal, [&](const YAP_Term& result){
+  const auto is_completed = RunWithSlotUntil(goal, deadline, [&](const YAP_Term& result){
     const auto connections_term = YAP_ArgOfTerm(1, result);
     assert(YAP_IsPairTerm(connections_term));
     const auto connection_terms = YapPairTermToYapTerms(connections_term);
@@ -628,20 +688,28 @@ void DetectFactActionConnections() {
     std::cout << "Note: no fact-action connection was found." << std::endl;
   });
   for (const auto& entry : fact_action_connections) {
+    if (!VLOG_IS_ON(1)) {
+      break;
+    }
     const auto fact_atom = entry.first.first;
     const auto action_atom = entry.first.second;
-    std::cout << "Fact-Action connection: (" << AtomToString(fact_atom) << ' ' << AtomToString(action_atom) << ')';
+    std::ostringstream o;
+    o << "Fact-Action connection: (" << bound_game->AtomToString(fact_atom) << ' ' << bound_game->AtomToString(action_atom) << ')';
     for (const auto& rel_args_pair : entry.second) {
       const auto order_rel = rel_args_pair.first;
       const auto& arg_pair = rel_args_pair.second;
-      std::cout << ' ' << AtomToString(order_rel) << '(' << arg_pair.first << ' ' << arg_pair.second << ')';
+      o << ' ' << bound_game->AtomToString(order_rel) << '(' << arg_pair.first << ' ' << arg_pair.second << ')';
     }
-    std::cout << std::endl;
+    VLOG(1) << o.str();
   }
+  if (is_completed) {
+    bound_game->fact_action_connections.swap(fact_action_connections);
+  }
+  return is_completed;
 }
 
 void DetectFactOrderedArgs() {
-  fact_ordered_args.clear();
+  bound_game->fact_ordered_args.clear();
   std::array<YAP_Term, 1> args = {{ YAP_MkVarTerm() }};
   auto goal = YAP_MkApplTerm(state_fact_ordered_args_functor, 1, args.data());
   RunWithSlot(goal, [&](const YAP_Term& result){
@@ -667,22 +735,26 @@ void DetectFactOrderedArgs() {
         const auto order_rel_atom = YapTermToAtom(order_rel_term);
         arg_order_rel_map.emplace(arg, order_rel_atom);
       }
-      fact_ordered_args.emplace(fact_rel_atom, arg_order_rel_map);
+      bound_game->fact_ordered_args.emplace(fact_rel_atom, arg_order_rel_map);
     }
   }, []{
     std::cout << "Note: no ordered arguments of facts were found." << std::endl;
   });
-  for (const auto& fact_ordered_args_pair : fact_ordered_args) {
-    std::cout << "Ordered args of fact " << AtomToString(fact_ordered_args_pair.first) << ':';
+  for (const auto& fact_ordered_args_pair : bound_game->fact_ordered_args) {
+    if (!VLOG_IS_ON(1)) {
+      break;
+    }
+    std::ostringstream o;
+    o << "Ordered args of fact " << bound_game->AtomToString(fact_ordered_args_pair.first) << ':';
     for (const auto& arg_order_rel_pair : fact_ordered_args_pair.second) {
-      std::cout << " [" << arg_order_rel_pair.first << ", " << AtomToString(arg_order_rel_pair.second) << ']';
+      o << " [" << arg_order_rel_pair.first << ", " << bound_game->AtomToString(arg_order_rel_pair.second) << ']';
     }
-    std::cout << std::endl;
+    VLOG(1) << o.str();
   }
 }
 
 void DetectActionOrderedArgs() {
-  action_ordered_args.clear();
+  bound_game->action_ordered_args.clear();
   std::array<YAP_Term, 1> args = {{ YAP_MkVarTerm() }};
   auto goal = YAP_MkApplTerm(state_action_ordered_args_functor, 1, args.data());
   RunWithSlot(goal, [&](const YAP_Term& result){
@@ -708,84 +780,117 @@ void DetectActionOrderedArgs() {
         const auto order_rel_atom = YapTermToAtom(order_rel_term);
         arg_order_rel_map.emplace(arg, order_rel_atom);
       }
-      action_ordered_args.emplace(action_rel_atom, arg_order_rel_map);
+      bound_game->action_ordered_args.emplace(action_rel_atom, arg_order_rel_map);
     }
   }, []{
     std::cout << "Note: no ordered arguments of actions were found." << std::endl;
   });
-  for (const auto& action_ordered_args_pair : action_ordered_args) {
-    std::cout << "Ordered args of action " << AtomToString(action_ordered_args_pair.first) << ':';
+  for (const auto& action_ordered_args_pair : bound_game->action_ordered_args) {
+    if (!VLOG_IS_ON(1)) {
+      break;
+    }
+    std::ostringstream o;
+    o << "Ordered args of action " << bound_game->AtomToString(action_ordered_args_pair.first) << ':';
     for (const auto& arg_order_rel_pair : action_ordered_args_pair.second) {
-      std::cout << " [" << arg_order_rel_pair.first << ", " << AtomToString(arg_order_rel_pair.second) << ']';
+      o << " [" << arg_order_rel_pair.first << ", " << bound_game->AtomToString(arg_order_rel_pair.second) << ']';
     }
-    std::cout << std::endl;
+    VLOG(1) << o.str();
   }
 }
 
+std::vector<AtomAndString> CreateOtherAtoms() {
+  std::vector<AtomAndString> other_atoms;
+  other_atoms.emplace_back(atoms::kFree, "?");
+  // Atoms relative to free atom: ?-255, ?-254, ..., ?+255
+  for (auto atom = atoms::kFree - 255; atom <= atoms::kFree + 255; ++atom) {
+    if (atom == atoms::kFree) {
+      continue;
+    }
+    other_atoms.emplace_back(atom, (boost::format("?%1$+d") % atom).str());
+  }
+  other_atoms.emplace_back(atoms::kLeftParen, "(");
+  other_atoms.emplace_back(atoms::kRightParen, ")");
+  return other_atoms;
+}
+
 /**
  * Construct atom dictionary:
- *   atom_to_string, atom_to_yap_atom
- * @param functor_atom_strs
- * @param non_functor_atom_strs
+ *   atom_to_string of a game, which need not be bound yet
+ * @param game
+ * @param atom_strs
  */
 void ConstructAtomDictionary(
+    GameData& game,
     const std::unordered_set<std::string>& atom_strs) {
-  atom_to_string.clear();
-  atom_to_yap_atom.clear();
+  game.atom_to_string.clear();
   // GDL atoms
   std::set<std::string> sorted_atom_strs(atom_strs.begin(), atom_strs.end());
   for (const auto& atom_str : sorted_atom_strs) {
     // Assign atom id for each atom string
-    const auto atom = atom_to_string.size() + kAtomOffset;
-    std::cout << atom_str << " -> " << atom << std::endl;
-    atom_to_string.insert(AtomAndString(atom, atom_str));
-    // Paring atom id and YAP_Atom
-    const auto atom_str_with_prefix = kPrefix + atom_str;
-    const auto yap_atom = YAP_LookupAtom(atom_str_with_prefix.c_str());
-    atom_to_yap_atom.insert(AtomAndYapAtom(atom, yap_atom));
+    const auto atom = game.atom_to_string.size() + kAtomOffset;
+    VLOG(2) << atom_str << " -> " << atom;
+    game.atom_to_string.insert(AtomAndString(atom, atom_str));
   }
-  // Other atoms
-  atom_to_string.insert(AtomAndString(atoms::kFree, "?"));
-  // Atoms relative to free atom: ?-255, ?-254, ..., ?+255
-  for (auto atom = atoms::kFree - 255; atom <= atoms::kFree + 255; ++atom) {
-    if (atom == atoms::kFree) {
+  // Other atoms, which are the same in every game
+  static const auto other_atoms = CreateOtherAtoms();
+  game.atom_to_string.insert(other_atoms.begin(), other_atoms.end());
+}
+
+/**
+ * Pair GDL atoms of the bound game with YAP_Atom
+ */
+void BindYapAtoms() {
+  atom_to_yap_atom.clear();
+  for (const auto& entry : bound_game->atom_to_string.left) {
+    if (entry.first < kAtomOffset) {
       continue;
     }
-    const auto str = (boost::format("?%1$+d") % atom).str();
-    atom_to_string.insert(AtomAndString(atom, str));
+    // Atoms shared with games loaded before are not looked up again
+    auto& yap_atom = string_to_yap_atom[entry.second];
+    if (!yap_atom) {
+      const auto atom_str_with_prefix = kPrefix + entry.second;
+      yap_atom = YAP_LookupAtom(atom_str_with_prefix.c_str());
+    }
+    atom_to_yap_atom.insert(AtomAndYapAtom(entry.first, yap_atom));
   }
-  atom_to_string.insert(AtomAndString(atoms::kLeftParen, "("));
-  atom_to_string.insert(AtomAndString(atoms::kRightParen, ")"));
 }
 
 
-void DetectWinConditions() {
-  win_conditions.clear();
-  win_conditions.resize(GetRoleCount());
+bool DetectWinConditions(const boost::optional<Deadline>& deadline) {
+  std::vector<std::vector<FactSet>> win_conditions(bound_game->roles.size());
   std::array<YAP_Term, 1> args = {{ YAP_MkVarTerm() }};
   auto goal = YAP_MkApplTerm(state_win_conditions_functor, 1, args.data());
-  RunWithSlotOrError(goal, [&](const YAP_Term& result){
+  const auto is_completed = RunWithSlotUntil(goal, deadline, [&](const YAP_Term& result){
     const auto role_win_conditions_pair_terms =
         YapPairTermToYapTerms(YAP_ArgOfTerm(1, result));
-    assert(role_win_conditions_pair_terms.size() == GetRoleCount());
+    assert(role_win_conditions_pair_terms.size() == bound_game->roles.size());
     for (const auto& role_win_conditions_pair_term : role_win_conditions_pair_terms) {
       const auto role_win_conditions_pair = YapPairTermToYapTerms(role_win_conditions_pair_term);
       assert(role_win_conditions_pair.size() == 2);
       const auto& role_term = role_win_conditions_pair.front();
-      const auto role_idx = atom_to_role_index.at(YapTermToAtom(role_term));
+      const auto role_idx = bound_game->atom_to_role_index.at(YapTermToAtom(role_term));
       const auto& conditions_term = role_win_conditions_pair.back();
       const auto condition_terms = YapPairTermToYapTerms(conditions_term);
       for (const auto& condition_term : condition_terms) {
         const auto condition = YapPairTermToTuples(condition_term);
-        std::cout << "Win condition for " << role_idx << ":";
-        for (const auto& fact : condition) {
-          std::cout << TupleToString(fact) << ",";
+        if (VLOG_IS_ON(1)) {
+          std::ostringstream o;
+          o << "Win condition for " << role_idx << ":";
+          for (const auto& fact : condition) {
+            o << bound_game->TupleToString(fact) << ",";
+          }
+          VLOG(1) << o.str();
         }
-        std::cout << std::endl;
         win_conditions.at(role_idx).push_back(condition);
       }
     }
+  }, []{
+    throw std::runtime_error("Failed to detect win conditions.");
   });
+  if (is_completed) {
+    bound_game->win_conditions.swap(win_conditions);
+  }
+  return is_completed;
 }
 
 //void LoadPrologFile(const std::string& filename) {
@@ -817,14 +922,24 @@ void CompilePrologFile(const std::string& prolog_filename) {
   RunGoalOnce((boost::format("compile('%1%')") % prolog_filename).str());
 }
 
+void FastInitPrologEngine(const boost::filesystem::path& binary_path) {
+  YAP_FastInit(binary_path.c_str());
+  string_to_yap_atom.clear();
+  // Disable atom garbage collection
+  YAP_SetYAPFlag(YAPC_ENABLE_AGC, 0);
+}
+
 void InitializePrologEngineWithInterface() {
   const auto interface_binary_path =
       boost::filesystem::absolute(
           boost::filesystem::path("tmp/interface.yap"));
-  if (!boost::filesystem::exists(interface_binary_path)) {
-    const auto interface_prolog_path =
-        boost::filesystem::absolute(
-            boost::filesystem::path(GetGGPEPath() + "/interface.pl"));
+  const auto interface_prolog_path =
+      boost::filesystem::absolute(
+          boost::filesystem::path(GetGGPEPath() + "/interface.pl"));
+  // The saved state is rebuilt if interface.pl is modified after it
+  if (!boost::filesystem::exists(interface_binary_path) ||
+      boost::filesystem::last_write_time(interface_binary_path) <
+          boost::filesystem::last_write_time(interface_prolog_path)) {
     const auto compile_command =
         (boost::format("yap -z \"compile('%1%'), save_program('%2%'), halt\"") %
             interface_prolog_path.string() %
@@ -833,60 +948,413 @@ void InitializePrologEngineWithInterface() {
     std::system(compile_command.c_str());
   }
   assert(boost::filesystem::exists(interface_binary_path));
-  YAP_FastInit(interface_binary_path.c_str());
-  // Disable atom garbage collection
-  YAP_SetYAPFlag(YAPC_ENABLE_AGC, 0);
+  FastInitPrologEngine(interface_binary_path);
+}
+
+/**
+ * Write a file under a temporary name and rename it, so that other processes
+ * never read it half-written
+ */
+void WriteFileAtomically(const std::string& filename, const std::string& content) {
+  const auto tmp_filename = filename + "." + std::to_string(getpid());
+  {
+    std::ofstream ofs(tmp_filename);
+    ofs << content << std::flush;
+  }
+  boost::filesystem::rename(tmp_filename, filename);
+}
+
+/**
+ * Load the saved state of the interface and the game program from
+ * tmp/<name>.yap, which is created by a separate YAP process if it is missing
+ * or was saved for another program (its hash is kept in tmp/<name>.yap.hash)
+ * @return false if the saved state cannot be created
+ */
+bool InitializePrologEngineWithSavedState(
+    const std::string& name,
+    const boost::filesystem::path& game_prolog_path,
+    const std::string& program) {
+  const auto state_path = game_prolog_path.parent_path() / (name + ".yap");
+  const auto hash_path = state_path.string() + ".hash";
+  const auto interface_prolog_path =
+      boost::filesystem::absolute(
+          boost::filesystem::path(GetGGPEPath() + "/interface.pl"));
+  // interface.pl and the modules it uses are also saved, thus their
+  // modification invalidates the state
+  auto hash = std::hash<std::string>()(program);
+  for (const auto& filename : {"interface.pl", "find_unique_n.pl", "subseq.pl", "list_to_conj.pl"}) {
+    boost::hash_combine(hash, file_utils::LoadStringFromFile(GetGGPEPath() + "/" + filename));
+  }
+  const auto program_hash = std::to_string(hash);
+  {
+    std::ifstream ifs(hash_path);
+    std::string line;
+    if (std::getline(ifs, line) && line == program_hash &&
+        boost::filesystem::exists(state_path)) {
+      std::cout << "Reuse YAP saved state: " << state_path.string() << std::endl;
+      FastInitPrologEngine(state_path);
+      return true;
+    }
+  }
+  // Other processes can be saving or loading the state at the same time, thus
+  // it is saved under a name of this process and renamed, and the hash is
+  // renamed only after the state
+  boost::filesystem::remove(hash_path);
+  const auto tmp_state_path = state_path.string() + "." + std::to_string(getpid());
+  const auto save_command =
+      (boost::format("yap -z \"compile('%1%'), compile('%2%'), save_program('%3%'), halt\"") %
+          interface_prolog_path.string() %
+          game_prolog_path.string() %
+          tmp_state_path).str();
+  std::cout << save_command << std::endl;
+  std::system(save_command.c_str());
+  if (!boost::filesystem::exists(tmp_state_path)) {
+    std::cout << "Note: YAP saved state cannot be created: " << state_path.string() << std::endl;
+    return false;
+  }
+  boost::filesystem::rename(tmp_state_path, state_path);
+  WriteFileAtomically(hash_path, program_hash + "\n");
+  FastInitPrologEngine(state_path);
+  return true;
 }
 
+/**
+ * Compile the program of a game into YAP, which is bound to the game by the
+ * caller. Once a game is loaded, YAP and the interface are kept and only the
+ * game is replaced.
+ * @param uses_saved_state whether the compiled program is saved and reused
+ * across processes, which is not worth it for throwaway engines
+ */
 void InitializePrologEngine(
+    const std::string& name,
     const std::vector<sexpr_parser::TreeNode>& kif_nodes,
-    const bool enables_tabling) {
+    const std::unordered_set<std::string>& tabled_relations,
+    const bool uses_saved_state = false) {
   assert(!kif_nodes.empty());
-  assert(!game_name.empty());
-  InitializePrologEngineWithInterface();
+  assert(!name.empty());
   const auto tmp_dir = boost::filesystem::path("tmp");
   const auto game_prolog_path =
       boost::filesystem::absolute(
-          tmp_dir / boost::filesystem::path(game_name + ".pl"));
-  std::ofstream ofs(game_prolog_path.string());
-  ofs << sexpr_parser::ToProlog(
+          tmp_dir / boost::filesystem::path(name + ".pl"));
+  const auto program = sexpr_parser::ToProlog(
       kif_nodes,
       true,
       kPrefix,
       kPrefix,
       true,
-      enables_tabling);
-  ofs.close();
-  CompilePrologFile(game_prolog_path.string());
+      tabled_relations);
+  // Other processes of the same game can be compiling the file
+  WriteFileAtomically(game_prolog_path.string(), program);
+  if (!loaded_game_prolog_path.empty()) {
+    // YAP and the interface are kept, and only the game loaded before is
+    // replaced, which takes much less time than initializing YAP again
+    RunGoalOnce((boost::format("unload_game('%1%')") % loaded_game_prolog_path).str());
+    // A partly compiled game is unloaded by the next one if compiling fails
+    loaded_game_prolog_path = game_prolog_path.string();
+    CompilePrologFile(game_prolog_path.string());
+  } else if (!uses_saved_state ||
+      !InitializePrologEngineWithSavedState(name, game_prolog_path, program)) {
+    InitializePrologEngineWithInterface();
+    CompilePrologFile(game_prolog_path.string());
+  }
+  loaded_game_prolog_path = game_prolog_path.string();
 }
 
+/**
+ * @return CPU time of the calling thread, which YAP runs on, excluding other
+ * threads, e.g. the one building the atom dictionary
+ */
+double GetThreadCPUTime() {
+  timespec time;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+  return time.tv_sec + time.tv_nsec * 1e-9;
 }
 
-void InitializeYapEngine(
-    const std::string& kif,
+/**
+ * Compile the rules with the count profiler of YAP, which counts the calls of
+ * predicates compiled while it is on
+ */
+void InitializePrologEngineWithProfiling(
     const std::string& name,
-    const bool enables_tabling) {
-  assert(!kif.empty());
-  assert(!name.empty());
-  const auto nodes = sexpr_parser::ParseKIF(kif);
-  InitializePrologEngine(nodes, enables_tabling);
-  // Now YAP Prolog is available
-  const auto atom_strs = sexpr_parser::CollectAtoms(nodes);
-  ConstructAtomDictionary(atom_strs);
-  CacheGoalValues(atom_strs);
-  CacheConstantYapObjects();
-  CacheRoles();
-  CacheInitialFacts();
-  CachePossibleFacts();
-  CachePossibleActions();
-  DetectOrderedDomains();
-  DetectStepCounters();
-  DetectFactActionConnections();
-  DetectWinConditions();
-//  DetectFactOrderedArgs();
-//  DetectActionOrderedArgs();
-  if (enables_tabling) {
-    RunGoalOnce("tabling_statistics");
+    const std::vector<sexpr_parser::TreeNode>& kif_nodes,
+    const std::unordered_set<std::string>& tabled_relations) {
+  if (loaded_game_prolog_path.empty()) {
+    // YAP is started by compiling the rules once
+    InitializePrologEngine(name, kif_nodes, tabled_relations);
+  }
+  RunGoalOnce("yap_flag(profiling, on)");
+  InitializePrologEngine(name, kif_nodes, tabled_relations);
+  RunGoalOnce("yap_flag(profiling, off)");
+}
+
+/**
+ * Run playouts with the rules compiled by InitializePrologEngineWithProfiling
+ * @param relations relations whose calls are counted
+ * @param counts the counts of calls and retries of the relations
+ * @param total_count the count of calls and retries of all predicates
+ * @return CPU time of the playouts
+ */
+double ProfilePlayouts(
+    const std::vector<std::string>& relations,
+    const std::vector<sexpr_parser::TreeNode>& kif_nodes,
+    std::vector<long long>& counts,
+    long long& total_count) {
+  std::unordered_map<std::string, int> arities;
+  for (const auto& node : kif_nodes) {
+    const auto& head = node.IsImplication() ? node.GetChildren().at(1) : node;
+    arities.emplace(head.GetFunctor(), head.IsLeaf() ? 0 : head.GetChildren().size() - 1);
+  }
+  std::ostringstream indicators;
+  for (auto i = relations.begin(); i != relations.end(); ++i) {
+    indicators << (i == relations.begin() ? "" : ", ") <<
+        '\'' << kPrefix << *i << "'/" << arities.at(*i);
+  }
+  const auto query = (boost::format("profile_playouts(%1%, [%2%], _counts, _total_count)") %
+      kProfilingPlayoutCount %
+      indicators.str()).str();
+  YAP_Term err;
+  const auto goal = YAP_ReadBuffer(query.c_str(), &err);
+  const auto start_time = GetThreadCPUTime();
+  RunWithSlotOrError(goal, [&](const YAP_Term& result) {
+    counts.clear();
+    for (const auto& count_term : YapPairTermToYapTerms(YAP_ArgOfTerm(3, result))) {
+      counts.push_back(YAP_IntOfTerm(count_term));
+    }
+    total_count = YAP_IntOfTerm(YAP_ArgOfTerm(4, result));
+  }, "Failed to profile playouts.");
+  assert(counts.size() == relations.size());
+  return GetThreadCPUTime() - start_time;
+}
+
+/**
+ * @return static relations still defined by rules, since tabling a relation
+ * of facts, e.g. one materialized, cannot make it faster
+ */
+std::unordered_set<std::string> CollectTablingCandidates(
+    const std::vector<sexpr_parser::TreeNode>& kif_nodes) {
+  const auto static_relations = sexpr_parser::CollectStaticRelations(kif_nodes);
+  std::unordered_set<std::string> candidates;
+  for (const auto& node : kif_nodes) {
+    if (node.GetFunctor() == "<=" && node.GetChildren().size() > 2) {
+      const auto& relation = node.GetChildren()[1].GetFunctor();
+      if (static_relations.count(relation)) {
+        candidates.insert(relation);
+      }
+    }
+  }
+  return candidates;
+}
+
+/**
+ * Choose static relations to be tabled by profiling playouts once: the calls
+ * of each relation are counted, and its time is estimated by its share of all
+ * calls. Relations taking a large enough share are tabled together, which is
+ * kept only if playouts get faster. The choice is saved in tmp/<name>.tabling
+ * with the hash of the given rules so that it is reused.
+ */
+std::unordered_set<std::string> SelectTabledRelations(
+    const std::string& name,
+    const std::vector<sexpr_parser::TreeNode>& kif_nodes) {
+  const auto tabling_path = "tmp/" + name + ".tabling";
+  // The rules are those compiled, which differ from the KIF by rewrites
+  const auto kif_hash = std::to_string(std::hash<std::string>()(sexpr_parser::ToKIF(kif_nodes)));
+  std::unordered_set<std::string> tabled_relations;
+  {
+    std::ifstream ifs(tabling_path);
+    std::string line;
+    if (std::getline(ifs, line) && line == kif_hash) {
+      while (std::getline(ifs, line)) {
+        tabled_relations.insert(line);
+      }
+      std::cout << "Reuse tabled relations: " << tabling_path << std::endl;
+      return tabled_relations;
+    }
+  }
+  const auto candidates = CollectTablingCandidates(kif_nodes);
+  if (!candidates.empty()) {
+    const std::vector<std::string> relations(candidates.begin(), candidates.end());
+    std::vector<long long> counts;
+    long long total_count = 0;
+    InitializePrologEngineWithProfiling(name, kif_nodes, {});
+    const auto time_without_tabling = ProfilePlayouts(relations, kif_nodes, counts, total_count);
+    std::unordered_set<std::string> selected_relations;
+    for (auto i = 0u; i < relations.size(); ++i) {
+      const auto share = total_count > 0 ? static_cast<double>(counts[i]) / total_count : 0.0;
+      VLOG(1) << "Profile of " << relations[i] << ": " << counts[i] << " calls, " <<
+          share * time_without_tabling << "s";
+      if (share >= kTablingShareThreshold) {
+        selected_relations.insert(relations[i]);
+      }
+    }
+    if (!selected_relations.empty()) {
+      InitializePrologEngineWithProfiling(name, kif_nodes, selected_relations);
+      const auto time_with_tabling = ProfilePlayouts(relations, kif_nodes, counts, total_count);
+      std::cout << "Tabling " << selected_relations.size() << " relations: " <<
+          time_without_tabling << "s -> " << time_with_tabling << "s" << std::endl;
+      if (time_with_tabling < time_without_tabling * kTablingSpeedupThreshold) {
+        tabled_relations.swap(selected_relations);
+      }
+    }
+  }
+  std::ostringstream o;
+  o << kif_hash << std::endl;
+  for (const auto& relation : tabled_relations) {
+    o << relation << std::endl;
+  }
+  // Other processes of the same game can be reading the choice
+  WriteFileAtomically(tabling_path, o.str());
+  return tabled_relations;
+}
+
+const char* AnalysisToString(const Analysis analysis) {
+  static const std::array<const char*, static_cast<std::size_t>(Analysis::COUNT)> analysis_names = {{
+      "ordered domains", "step counters", "fact-action connections", "win conditions" }};
+  return analysis_names[static_cast<std::size_t>(analysis)];
+}
+
+/**
+ * Run a given analysis of the bound game. Its results are stored only when
+ * it completes, since getters of the game return references to them.
+ * @return false if the deadline passed before the analysis completed
+ */
+bool RunAnalysis(const Analysis analysis, const boost::optional<Deadline>& deadline) {
+  switch (analysis) {
+  case Analysis::ORDERED_DOMAINS:
+    return DetectOrderedDomains(deadline);
+  case Analysis::STEP_COUNTERS:
+    return DetectStepCounters(deadline);
+  case Analysis::FACT_ACTION_CONNECTIONS:
+    return DetectFactActionConnections(deadline);
+  case Analysis::WIN_CONDITIONS:
+    return DetectWinConditions(deadline);
+  default:
+    assert(false);
+    return false;
+  }
+}
+
+bool WriteAll(const int fd, const std::string& buffer) {
+  auto pos = buffer.data();
+  const auto end = buffer.data() + buffer.size();
+  while (pos != end) {
+    const auto size = write(fd, pos, end - pos);
+    if (size < 0) {
+      return false;
+    }
+    pos += size;
+  }
+  return true;
+}
+
+/**
+ * @return true iif this process runs only the calling thread, which is
+ * required to fork safely, since a forked child only has the calling thread
+ * and locks held by the others are never released in it
+ */
+bool IsSingleThreaded() {
+#ifdef __linux__
+  // Each thread has an entry in /proc/self/task
+  boost::system::error_code error;
+  const auto begin = boost::filesystem::directory_iterator("/proc/self/task", error);
+  if (error) {
+    return false;
+  }
+  return std::distance(begin, boost::filesystem::directory_iterator()) == 1;
+#else
+  return false;
+#endif
+}
+
+std::string ReadAll(const int fd) {
+  std::string buffer;
+  std::array<char, 65536> chunk;
+  ssize_t size;
+  while ((size = read(fd, chunk.data(), chunk.size())) > 0) {
+    buffer.append(chunk.data(), size);
+  }
+  return buffer;
+}
+
+}
+
+void InitializeYapEngine(const GameDataSp& game) {
+  assert(game);
+  assert(!game->kif.empty());
+  assert(!game->name.empty());
+#ifndef GGPE_SINGLE_THREAD
+  std::lock_guard<Mutex> lk(mutex);
+#endif
+  auto& report = game->initialization_report;
+  report.clear();
+  std::vector<sexpr_parser::TreeNode> nodes;
+  std::unordered_set<std::string> atom_strs;
+  report.push_back(MeasurePhase("parse", [&]{
+    nodes = sexpr_parser::ParseKIF(game->kif);
+  }));
+  report.push_back(MeasurePhase("optimize", [&]{
+    auto materialized_nodes = datalog::MaterializeStaticRelations(nodes);
+    // Forms of the KIF are released before optimizing, so that at most two
+    // versions of the rules are kept at once
+    std::vector<sexpr_parser::TreeNode>().swap(nodes);
+    game->nodes = sexpr_parser::Optimize(materialized_nodes);
+    // Atoms are collected from the rules every backend compiles, since the
+    // optimizer drops some atoms of the KIF and GDLCC numbers the rest
+    for (const auto& node : game->nodes) {
+      node.CollectAtoms(atom_strs);
+    }
+  }));
+  // Until now YAP is untouched, thus a failure keeps the game bound before.
+  // From now on YAP is bound to the game only once it holds the rules, and a
+  // failure leaves no game bound, since the rules of the game bound before
+  // can be unloaded.
+  try {
+    // The atom dictionary does not depend on YAP, thus it is built while YAP
+    // compiles the rules
+    const auto bundle_path = "tmp/" + game->name + ".bundle";
+    auto is_bundle_loaded = false;
+    auto atom_dictionary_future = std::async(std::launch::async, [&]{
+      return MeasurePhase("construct atom dictionary", [&]{
+        is_bundle_loaded = bundle::Load(bundle_path, *game);
+        if (is_bundle_loaded) {
+          std::cout << "Reuse analyses: " << bundle_path << std::endl;
+        } else {
+          ConstructAtomDictionary(*game, atom_strs);
+        }
+      }, true);
+    });
+    if (game->enables_tabling) {
+      report.push_back(MeasurePhase("select tabled relations", [&]{
+        game->tabled_relations = SelectTabledRelations(game->name, game->nodes);
+      }, true));
+    }
+    report.push_back(MeasurePhase("compile prolog", [&]{
+      InitializePrologEngine(game->name, game->nodes, game->tabled_relations, true);
+    }, true));
+    // Now YAP Prolog is available, and states of the game bound before can
+    // no longer query it
+    report.push_back(atom_dictionary_future.get());
+    bound_game = game;
+    report.push_back(MeasurePhase("bind yap atoms", [&]{
+      BindYapAtoms();
+      CacheConstantYapObjects();
+    }));
+    if (!is_bundle_loaded) {
+      report.push_back(MeasurePhase("cache goal values", [&]{ CacheGoalValues(atom_strs); }));
+      report.push_back(MeasurePhase("cache roles", CacheRoles));
+      report.push_back(MeasurePhase("cache initial facts", CacheInitialFacts));
+      report.push_back(MeasurePhase("cache possible facts", CachePossibleFacts));
+      report.push_back(MeasurePhase("cache possible actions", CachePossibleActions));
+//      DetectFactOrderedArgs();
+//      DetectActionOrderedArgs();
+      // The other analyses are run lazily by Analyze
+      report.push_back(MeasurePhase("save analysis bundle", [&]{ bundle::Save(*game, bundle_path); }));
+    }
+    if (!game->tabled_relations.empty()) {
+      RunGoalOnce("tabling_statistics");
+    }
+  } catch (...) {
+    bound_game.reset();
+    throw;
   }
 }
 
@@ -906,13 +1374,168 @@ std::vector<int> GetPartialGoalsByYap(const StateSp& state) {
   return goals;
 }
 
-std::vector<int> GetPartialGoals(const StateSp& state) {
+namespace {
+
+bool IsAnalyzedLocked(const GameData& game, const Analysis analysis) {
+#ifndef GGPE_SINGLE_THREAD
+  std::lock_guard<Mutex> lk(analysis_mutex);
+#endif
+  return game.IsAnalyzed(analysis);
+}
+
+/**
+ * Mark an analysis completed after its results are written, which are not
+ * changed after that
+ */
+void SetAnalyzed(GameData& game, const Analysis analysis) {
+#ifndef GGPE_SINGLE_THREAD
+  std::lock_guard<Mutex> lk(analysis_mutex);
+#endif
+  game.completed_analyses.set(static_cast<std::size_t>(analysis));
+}
+
+}
+
+bool Analyze(const GameDataSp& game, const Analysis analysis, const boost::optional<Deadline>& deadline) {
+  if (IsAnalyzedLocked(*game, analysis)) {
+    return true;
+  }
+#ifndef GGPE_SINGLE_THREAD
+  std::lock_guard<Mutex> lk(mutex);
+#endif
+  // Analyses are completed only under the lock of YAP
+  if (game->IsAnalyzed(analysis)) {
+    return true;
+  }
+  if (!IsBound(game)) {
+    std::cout << "Note: detecting " << AnalysisToString(analysis) <<
+        " needs YAP Prolog to hold the rules of the game." << std::endl;
+    return false;
+  }
+  auto is_completed = false;
+  game->initialization_report.push_back(MeasurePhase(
+      std::string("detect ") + AnalysisToString(analysis), [&]{
+        is_completed = RunAnalysis(analysis, deadline);
+      }));
+  if (!is_completed) {
+    std::cout << "Note: detecting " << AnalysisToString(analysis) << " ran out of time." << std::endl;
+    return false;
+  }
+  SetAnalyzed(*game, analysis);
+  // Completed analyses are reused by later processes
+  bundle::Save(*game, "tmp/" + game->name + ".bundle");
+  return true;
+}
+
+namespace {
+
+/**
+ * Run the analyses of the bound game which have not completed in forked
+ * processes. They are run in this process instead if it has other threads.
+ */
+void ForkAnalyses(const GameDataSp& game, const boost::optional<Deadline>& deadline) {
+  struct Child {
+    Analysis analysis;
+    pid_t pid;
+    int fd;
+  };
+  std::vector<Child> children;
+  std::vector<Analysis> sequential_analyses;
+  const auto can_fork = IsSingleThreaded();
+  // Otherwise buffered output would be written by each child again
+  std::cout.flush();
+  for (auto i = 0; i < static_cast<int>(Analysis::COUNT); ++i) {
+    const auto analysis = static_cast<Analysis>(i);
+    if (game->IsAnalyzed(analysis)) {
+      continue;
+    }
+    int fds[2];
+    if (!can_fork || pipe(fds) != 0) {
+      sequential_analyses.push_back(analysis);
+      continue;
+    }
+    const auto pid = fork();
+    if (pid == 0) {
+      // The child has a copy of YAP, and sends back the result if completed
+      close(fds[0]);
+      auto status = EXIT_FAILURE;
+      try {
+        if (RunAnalysis(analysis, deadline)) {
+          const auto buffer = bundle::SaveAnalysis(*game, analysis);
+          if (WriteAll(fds[1], buffer)) {
+            status = EXIT_SUCCESS;
+          }
+        } else {
+          status = EXIT_SUCCESS;
+        }
+      } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+      }
+      std::cout.flush();
+      _exit(status);
+    }
+    close(fds[1]);
+    if (pid < 0) {
+      close(fds[0]);
+      sequential_analyses.push_back(analysis);
+      continue;
+    }
+    children.push_back({analysis, pid, fds[0]});
+  }
+  auto has_completed = false;
+  for (const auto& child : children) {
+    const auto buffer = ReadAll(child.fd);
+    close(child.fd);
+    int status;
+    waitpid(child.pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+      std::cout << "Note: detecting " << AnalysisToString(child.analysis) <<
+          " failed in a child process." << std::endl;
+    } else if (buffer.empty()) {
+      std::cout << "Note: detecting " << AnalysisToString(child.analysis) << " ran out of time." << std::endl;
+    } else {
+      bundle::LoadAnalysis(buffer.data(), buffer.data() + buffer.size(), child.analysis, *game);
+      SetAnalyzed(*game, child.analysis);
+      has_completed = true;
+    }
+  }
+  // Analyses are run in this process if they cannot be forked
+  for (const auto analysis : sequential_analyses) {
+    if (RunAnalysis(analysis, deadline)) {
+      SetAnalyzed(*game, analysis);
+      has_completed = true;
+    } else {
+      std::cout << "Note: detecting " << AnalysisToString(analysis) << " ran out of time." << std::endl;
+    }
+  }
+  if (has_completed) {
+    bundle::Save(*game, "tmp/" + game->name + ".bundle");
+  }
+}
+
+}
+
+void RunAnalyses(const GameDataSp& game, const boost::optional<Deadline>& deadline) {
+#ifndef GGPE_SINGLE_THREAD
+  std::lock_guard<Mutex> lk(mutex);
+#endif
+  CheckBound(game);
+  game->initialization_report.push_back(MeasurePhase("run analyses", [&]{
+    ForkAnalyses(game, deadline);
+  }));
+}
+
+bool IsBound(const GameDataCsp& game) {
+  return game == bound_game;
+}
+
+std::vector<int> GetPartialGoals(const GameDataCsp& game, const StateSp& state) {
   constexpr auto max_partial_goal = 50;
   const auto& facts = state->GetFacts();
   const std::unordered_set<Fact, boost::hash<Fact>> fact_set(facts.begin(), facts.end());
-  Goals goals(GetRoleCount(), 0);
-  for (const auto role_idx : GetRoleIndices()) {
-    for (const auto& cond_facts : win_conditions[role_idx]) {
+  Goals goals(game->roles.size(), 0);
+  for (const auto role_idx : game->role_indices) {
+    for (const auto& cond_facts : game->win_conditions[role_idx]) {
       if (cond_facts.empty()) {
         // Sometimes empty conditions are detected, just ignore them.
         continue;
@@ -929,7 +1552,8 @@ std::vector<int> GetPartialGoals(const StateSp& state) {
   return goals;
 }
 
-std::vector<NextCondition> DetectNextConditions(const Fact& fact) {
+std::vector<NextCondition> DetectNextConditions(const GameDataCsp& game, const Fact& fact) {
+  CheckBound(game);
   std::vector<NextCondition> next_conditions;
   std::array<YAP_Term, 2> args = {{ TupleToYapTerm(fact), YAP_MkVarTerm() }};
   auto goal = YAP_MkApplTerm(next_conditions_functor, 2, args.data());
@@ -942,12 +1566,12 @@ std::vector<NextCondition> DetectNextConditions(const Fact& fact) {
       // Action condition
       const auto& action_condition_term = action_condition_fact_condition.front();
       const auto role_action_pair_terms = YapPairTermToYapTerms(action_condition_term);
-      ActionCondition action_condition(GetRoleCount(), boost::none);
+      ActionCondition action_condition(bound_game->roles.size(), boost::none);
       for (const auto& role_action_pair_term : role_action_pair_terms) {
         const auto role_action_pair = YapPairTermToYapTerms(role_action_pair_term);
         assert(role_action_pair.size() == 2);
         const auto& role_term = role_action_pair.front();
-        const auto role_idx = atom_to_role_index.at(YapTermToAtom(role_term));
+        const auto role_idx = bound_game->atom_to_role_index.at(YapTermToAtom(role_term));
         const auto& action_term = role_action_pair.back();
         const auto action = YapTermToTuple(action_term);
         action_condition[role_idx] = action;
@@ -961,11 +1585,39 @@ std::vector<NextCondition> DetectNextConditions(const Fact& fact) {
   return next_conditions;
 }
 
-StateSp CreateInitialState() {
-  return std::make_shared<YapState>(initial_facts, std::vector<JointAction>());
+StateSp CreateInitialState(const GameDataCsp& game) {
+  return std::make_shared<YapState>(game, game->initial_facts, std::vector<JointAction>());
 }
 
-YapState::YapState(const std::vector<Tuple>& facts, const std::vector<JointAction>& joint_action_history) :
+StateSp CreateState(const GameDataCsp& game, const FactSet& facts) {
+#ifndef GGPE_SINGLE_THREAD
+  std::unique_lock<Mutex> lk(mutex);
+#endif
+  CheckBound(game);
+  const auto fact_term = TuplesToYapPairTerm(facts);
+  std::array<YAP_Term, 1> args = {{ fact_term }};
+  auto goal = YAP_MkApplTerm(state_terminal_functor, 1, args.data());
+  auto is_terminal = false;
+  RunWithSlot(goal, [&](const YAP_Term&){
+    is_terminal = true;
+  }, []{});
+#ifndef GGPE_SINGLE_THREAD
+  lk.unlock();
+#endif
+  if (!is_terminal) {
+    return std::make_shared<YapState>(game, facts, std::vector<JointAction>());
+  }
+  // Goals of terminal states are computed in advance as in GetNextState
+  const auto state = std::make_shared<YapState>(game, facts, std::vector<JointAction>());
+  const auto goals = state->ComputeGoals();
+  return std::make_shared<YapState>(game, facts, goals, std::vector<JointAction>());
+}
+
+YapState::YapState(
+    const GameDataCsp& game,
+    const std::vector<Tuple>& facts,
+    const std::vector<JointAction>& joint_action_history) :
+    game_(game),
     facts_(facts),
     legal_actions_(0),
     is_terminal_(false),
@@ -974,9 +1626,11 @@ YapState::YapState(const std::vector<Tuple>& facts, const std::vector<JointActio
 }
 
 YapState::YapState(
+    const GameDataCsp& game,
     const std::vector<Tuple>& facts,
     const std::vector<int>& goals,
     const std::vector<JointAction>& joint_action_history) :
+        game_(game),
         facts_(facts),
         legal_actions_(0),
         is_terminal_(!goals.empty()),
@@ -985,6 +1639,7 @@ YapState::YapState(
 }
 
 YapState::YapState(const YapState& another) :
+    game_(another.game_),
     facts_(another.facts_),
     legal_actions_(another.legal_actions_),
     is_terminal_(another.is_terminal_),
@@ -999,7 +1654,7 @@ const FactSet& YapState::GetFacts() const {
 std::string YapState::ToString() const {
   std::ostringstream o;
   for (const auto& fact : facts_) {
-    o << TupleToString(fact) << std::endl;
+    o << game_->TupleToString(fact) << std::endl;
   }
   return o.str();
 }
@@ -1011,6 +1666,7 @@ const std::vector<std::vector<Tuple>>& YapState::GetLegalActions() const {
 #ifndef GGPE_SINGLE_THREAD
   std::lock_guard<Mutex> lk(mutex);
 #endif
+  CheckBound(game_);
   const auto fact_term = TuplesToYapPairTerm(facts_);
   std::array<YAP_Term, 2> args = {{ fact_term, YAP_MkVarTerm() }};
   auto goal = YAP_MkApplTerm(state_legal_functor, 2, args.data());
@@ -1025,6 +1681,7 @@ StateSp YapState::GetNextState(const JointAction& joint_action) const {
 #ifndef GGPE_SINGLE_THREAD
   std::lock_guard<Mutex> lk(mutex);
 #endif
+  CheckBound(game_);
   StateSp next_state;
   std::array<YAP_Term, 4> args = {{ TuplesToYapPairTerm(facts_), JointActionToYapPairTerm(joint_action), YAP_MkVarTerm(), YAP_MkVarTerm() }};
   auto goal = YAP_MkApplTerm(state_next_and_goal_functor, 4, args.data());
@@ -1033,7 +1690,7 @@ StateSp YapState::GetNextState(const JointAction& joint_action) const {
     const auto goal_term = YAP_ArgOfTerm(4, result);
     auto next_joint_action_history = joint_action_history_;
     next_joint_action_history.push_back(joint_action);
-    next_state = std::make_shared<YapState>(YapPairTermToTuples(facts_term), YapPairTermToGoals(goal_term), next_joint_action_history);
+    next_state = std::make_shared<YapState>(game_, YapPairTermToTuples(facts_term), YapPairTermToGoals(goal_term), next_joint_action_history);
   });
   return next_state;
 }
@@ -1047,24 +1704,32 @@ const std::vector<int>& YapState::GetGoals() const {
   if (!goals_.empty()) {
     return goals_;
   }
+  goals_ = ComputeGoals();
+  return goals_;
+}
+
+std::vector<int> YapState::ComputeGoals() const {
 #ifndef GGPE_SINGLE_THREAD
   std::lock_guard<Mutex> lk(mutex);
 #endif
+  CheckBound(game_);
   const auto fact_term = TuplesToYapPairTerm(facts_);
   std::array<YAP_Term, 2> args = {{ fact_term, YAP_MkVarTerm() }};
   auto goal = YAP_MkApplTerm(state_goal_functor, 2, args.data());
+  std::vector<int> goals;
   RunWithSlotOrError(goal, [&](const YAP_Term& result){
     const auto role_goal_pairs_term = YAP_ArgOfTerm(2, result);
-    goals_ = YapPairTermToGoals(role_goal_pairs_term);
-    assert(!goals_.empty());
+    goals = YapPairTermToGoals(role_goal_pairs_term);
+    assert(!goals.empty());
   });
-  return goals_;
+  return goals;
 }
 
 std::vector<int> YapState::Simulate() const {
 #ifndef GGPE_SINGLE_THREAD
   std::lock_guard<Mutex> lk(mutex);
 #endif
+  CheckBound(game_);
   const auto fact_term = TuplesToYapPairTerm(facts_);
   std::array<YAP_Term, 2> args = {{ fact_term, YAP_MkVarTerm() }};
   auto goal = YAP_MkApplTerm(state_simulate_functor, 2, args.data());
@@ -3,6 +3,7 @@
 
 #include "ggpe.hpp"
 #include "state.hpp"
+#include "game_data.hpp"
 
 namespace ggpe {
 namespace yap {
@@ -11,13 +12,14 @@ class YapState : public State {
 public:
   YapState() = delete;
   /**
-   * Construct a state with a given set of facts
+   * Construct a state of a given game with a given set of facts
    */
-  YapState(const FactSet& facts, const std::vector<JointAction>& joint_action_history);
+  YapState(const GameDataCsp& game, const FactSet& facts, const std::vector<JointAction>& joint_action_history);
   /**
-   * Construct a state with a given set of facts, caching pre-computed goals
+   * Construct a state of a given game with a given set of facts, caching
+   * pre-computed goals
    */
-  YapState(const FactSet& facts, const std::vector<int>& goals, const std::vector<JointAction>& joint_action_history);
+  YapState(const GameDataCsp& game, const FactSet& facts, const std::vector<int>& goals, const std::vector<JointAction>& joint_action_history);
   /**
    * Copy constructor
    */
@@ -53,7 +55,13 @@ public:
 
   std::string ToString() const override;
 
+  /**
+   * @return goal values computed by YAP Prolog, regardless of cached ones
+   */
+  std::vector<int> ComputeGoals() const;
+
 private:
+  GameDataCsp game_;
   FactSet facts_;
   mutable std::vector<ActionSet> legal_actions_;
   bool is_terminal_;
@@ -61,16 +69,45 @@ private:
   mutable std::vector<JointAction> joint_action_history_;
 };
 
-void InitializeYapEngine(
-    const std::string& kif,
-    const std::string& name,
-    const bool enables_tabling);
+/**
+ * Load the rules of a given game into YAP Prolog and fill its data.
+ * YAP holds the rules of one game at a time, thus the game bound before can
+ * no longer be queried. The game is bound only after YAP compiles its rules;
+ * if an exception is thrown before that, the game bound before is kept
+ * unless its rules have been unloaded, and otherwise no game is bound.
+ */
+void InitializeYapEngine(const GameDataSp& game);
+
+/**
+ * Run a given analysis of a game unless it has completed. YAP is locked while
+ * it runs, but not to check if it has completed.
+ * @return true iif the analysis has completed, after which its results are
+ * not changed. It is false if the deadline passes first or if YAP holds the
+ * rules of another game.
+ */
+bool Analyze(const GameDataSp& game, const Analysis analysis, const boost::optional<Deadline>& deadline);
+
+/**
+ * Run the analyses of a game which have not completed concurrently, each in a
+ * forked copy of YAP, and join their results. Analyses which cannot be forked
+ * are run in this process, e.g. all of them while other threads are running,
+ * since a forked child could block on locks held by them.
+ * Throws std::runtime_error if YAP holds the rules of another game.
+ */
+void RunAnalyses(const GameDataSp& game, const boost::optional<Deadline>& deadline);
+
+/**
+ * @return true iif YAP Prolog holds the rules of a given game
+ */
+bool IsBound(const GameDataCsp& game);
+
+StateSp CreateInitialState(const GameDataCsp& game);
 
-StateSp CreateInitialState();
+StateSp CreateState(const GameDataCsp& game, const FactSet& facts);
 
-std::vector<int> GetPartialGoals(const StateSp& state);
+std::vector<int> GetPartialGoals(const GameDataCsp& game, const StateSp& state);
 
-std::vector<NextCondition> DetectNextConditions(const Fact& fact);
+std::vector<NextCondition> DetectNextConditions(const GameDataCsp& game, const Fact& fact);
 
 }
 
@@ -0,0 +1,81 @@
+// A minimal game library of the GDLCC binary interface (version 1), which
+// gdlcc_engine_test compiles and loads. Its only fact is (cell x).
+#include "ggpe.hpp"
+#include "gdlcc_abi.hpp"
+
+namespace {
+
+using namespace ggpe;
+
+Atom cell_atom = -1;
+Atom x_atom = -1;
+
+class FixtureState : public State {
+public:
+  explicit FixtureState(const FactSet& facts) :
+      facts_(facts),
+      legal_actions_(1),
+      goals_({100}) {
+  }
+  const FactSet& GetFacts() const override {
+    return facts_;
+  }
+  const std::vector<ActionSet>& GetLegalActions() const override {
+    return legal_actions_;
+  }
+  StateSp GetNextState(const JointAction&) const override {
+    return std::make_shared<FixtureState>(facts_);
+  }
+  bool IsTerminal() const override {
+    return true;
+  }
+  const std::vector<int>& GetGoals() const override {
+    return goals_;
+  }
+  std::vector<int> Simulate() const override {
+    return goals_;
+  }
+  const std::vector<JointAction>& GetJointActionHistory() const override {
+    return history_;
+  }
+  std::string ToString() const override {
+    return "fixture";
+  }
+private:
+  FactSet facts_;
+  std::vector<ActionSet> legal_actions_;
+  std::vector<int> goals_;
+  std::vector<JointAction> history_;
+};
+
+}
+
+extern "C" {
+
+int GetABIVersion() {
+  return ggpe::gdlcc_abi::kVersion;
+}
+
+bool SetAtomTable(const ggpe::gdlcc_abi::AtomTable& atom_table) {
+  // dlopen shares a library loaded twice, thus atoms are set again
+  cell_atom = -1;
+  x_atom = -1;
+  for (const auto& atom_and_str : atom_table) {
+    if (atom_and_str.second == "cell") {
+      cell_atom = atom_and_str.first;
+    } else if (atom_and_str.second == "x") {
+      x_atom = atom_and_str.first;
+    }
+  }
+  return cell_atom >= 0 && x_atom >= 0;
+}
+
+ggpe::StateSp CreateInitialState() {
+  return std::make_shared<FixtureState>(ggpe::FactSet({{cell_atom, x_atom}}));
+}
+
+ggpe::StateSp CreateState(const ggpe::FactSet& facts) {
+  return std::make_shared<FixtureState>(facts);
+}
+
+}
@@ -0,0 +1,49 @@
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <boost/filesystem.hpp>
+#include <glog/logging.h>
+#include "ggpe.hpp"
+
+/**
+ * tictactoe -> TictactoeGame, chinese_checkers -> ChineseCheckersGame
+ */
+std::string ToStructName(const std::string& game_name) {
+  std::string struct_name;
+  auto capitalizes = true;
+  for (const auto c : game_name) {
+    if (!std::isalnum(c)) {
+      capitalizes = true;
+      continue;
+    }
+    struct_name += capitalizes ? std::toupper(c) : c;
+    capitalizes = false;
+  }
+  return struct_name + "Game";
+}
+
+int main(int argc, char** argv) {
+  if (argc != 4) {
+    std::cerr << "Usage: ./static_game <kif filename> <header directory> <compiled kif filename>" << std::endl;
+    std::cerr << "Sample: ./static_game kif/tictactoe.kif lib tmp/tictactoe.kif" << std::endl;
+    return 1;
+  }
+  google::InstallFailureSignalHandler();
+  const auto kif_filename = std::string(argv[1]);
+  const auto output_dir = boost::filesystem::path(argv[2]);
+  ggpe::InitializeFromFile(kif_filename, ggpe::EngineBackend::YAP, false);
+  const auto& name = ggpe::GetGameName();
+  const auto header_path = output_dir / (name + "_game.hpp");
+  ggpe::GenerateStaticGameHeader(header_path.string(), ToStructName(name));
+  std::cout << "Generated " << header_path.string() << std::endl;
+  // The library is built from the rules YAP numbers atoms of, as GDLCC
+  // libraries loaded at runtime are
+  std::ofstream kif_ofs(argv[3]);
+  kif_ofs << ggpe::GetDefaultGame()->GetCompiledKif() << std::flush;
+  if (!kif_ofs) {
+    std::cerr << "Cannot write '" << argv[3] << "'." << std::endl;
+    return 1;
+  }
+  return 0;
+}